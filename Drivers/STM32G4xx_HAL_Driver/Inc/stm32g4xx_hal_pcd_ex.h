@@ -54,6 +54,16 @@ HAL_StatusTypeDef  HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
                                        uint16_t ep_kind,
                                        uint32_t pmaadress);
 
+HAL_StatusTypeDef  HAL_PCDEx_PMAExchange(PCD_HandleTypeDef *hpcd,
+                                         uint8_t out_ep_addr,
+                                         uint8_t in_ep_addr);
+
+#ifdef HAL_DMA_MODULE_ENABLED
+HAL_StatusTypeDef  HAL_PCDEx_PMADMAConfig(PCD_HandleTypeDef *hpcd,
+                                          uint16_t ep_addr,
+                                          uint16_t min_size);
+#endif /* HAL_DMA_MODULE_ENABLED */
+
 
 HAL_StatusTypeDef HAL_PCDEx_ActivateLPM(PCD_HandleTypeDef *hpcd);
 HAL_StatusTypeDef HAL_PCDEx_DeActivateLPM(PCD_HandleTypeDef *hpcd);
@@ -74,6 +74,9 @@ typedef struct
   uint32_t lpm_enable;              /*!< Enable or disable Battery charging.                                    */
 
   uint32_t battery_charging_enable; /*!< Enable or disable Battery charging.                                    */
+
+  uint32_t hp_irq_enable;           /*!< Enable or disable servicing the double buffered bulk and isochronous
+                                         endpoints from the high priority interrupt only.                       */
 } USB_CfgTypeDef;
 
 typedef struct
@@ -118,6 +121,13 @@ typedef struct
 
   uint32_t  xfer_count;      /*!< Partial transfer length in case of multi packet transfer                  */
 
+  uint8_t   xfer_fill_db;    /*!< Double buffer bulk IN: number of buffers handed to the USB peripheral
+                                  Double buffer bulk OUT: 1 when a received packet is parked in PMA        */
+
+  uint8_t   xfer_armed_db;   /*!< Double buffer bulk OUT: 1 while a receive transfer is armed              */
+
+  uint16_t  dma_min_size;    /*!< Smallest packet whose PMA copy is moved by DMA, 0 for CPU copies only    */
+
 } USB_EPTypeDef;
 
 
@@ -78,6 +78,15 @@
   */
 #define PCD_MIN(a, b)  (((a) < (b)) ? (a) : (b))
 #define PCD_MAX(a, b)  (((a) > (b)) ? (a) : (b))
+
+/* ISTR flags serviced by HAL_PCD_IRQHandler besides USB_ISTR_CTR */
+#define PCD_ISTR_EVENTS  (USB_ISTR_RESET | USB_ISTR_PMAOVR | USB_ISTR_ERR | USB_ISTR_WKUP | \
+                          USB_ISTR_SUSP | USB_ISTR_L1REQ | USB_ISTR_SOF | USB_ISTR_ESOF)
+
+/* Endpoint register value of an endpoint whose correct transfers also raise
+   the high priority interrupt: isochronous, or double buffered bulk */
+#define PCD_EP_HP_LINE(wEPVal)  ((((wEPVal) & USB_EP_T_FIELD) == USB_EP_ISOCHRONOUS) || \
+                                 (((wEPVal) & (USB_EP_T_FIELD | USB_EP_KIND)) == (USB_EP_BULK | USB_EP_KIND)))
 /**
   * @}
   */
@@ -87,7 +96,21 @@
   * @{
   */
 
-static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd);
+static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t hp);
+static void PCD_EP_DB_Transmit(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_DB_Receive(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static void PCD_EP_RxPacket(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count);
+static void PCD_EP_DB_RxPacket(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count);
+static void PCD_EP_StartXfer(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+static HAL_StatusTypeDef PCD_EP_ReadPMA(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep,
+                                        uint16_t pmabuffer, uint16_t count);
+static uint8_t PCD_EP_DMABusy(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep);
+#ifdef HAL_DMA_MODULE_ENABLED
+static HAL_StatusTypeDef PCD_PMA_DMAStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep,
+                                          uint16_t pmabuffer, uint16_t count);
+static void PCD_PMA_DMACplt(DMA_HandleTypeDef *hdma);
+static void PCD_PMA_DMAError(DMA_HandleTypeDef *hdma);
+#endif /* HAL_DMA_MODULE_ENABLED */
 
 /**
   * @}
@@ -997,7 +1020,13 @@ void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
   {
     /* servicing of the endpoint correct transfer interrupt */
     /* clear of the CTR flag into the sub */
-    (void)PCD_EP_ISR_Handler(hpcd);
+    (void)PCD_EP_ISR_Handler(hpcd, 0U);
+  }
+
+  /* Data traffic only: skip the bus event checks below */
+  if ((hpcd->Instance->ISTR & PCD_ISTR_EVENTS) == 0U)
+  {
+    return;
   }
 
   if (__HAL_PCD_GET_FLAG(hpcd, USB_ISTR_RESET))
@@ -1110,6 +1139,22 @@ void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd)
   }
 }
 
+/**
+  * @brief  This function handles PCD high priority interrupt request: the
+  *         correct transfers of the isochronous and double buffered bulk
+  *         endpoints, when Init.hp_irq_enable is set. Everything else stays
+  *         with HAL_PCD_IRQHandler on the low priority interrupt.
+  * @param  hpcd PCD handle
+  * @retval None
+  */
+void HAL_PCD_HP_IRQHandler(PCD_HandleTypeDef *hpcd)
+{
+  if (__HAL_PCD_GET_FLAG(hpcd, USB_ISTR_CTR))
+  {
+    (void)PCD_EP_ISR_Handler(hpcd, 1U);
+  }
+}
+
 
 /**
   * @brief  Data OUT stage callback.
@@ -1410,6 +1455,15 @@ HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
   }
   ep->num   = ep_addr & EP_ADDR_MSK;
 
+#ifdef HAL_DMA_MODULE_ENABLED
+  if (hpcd->dma_ep == ep)
+  {
+    /* Drop the copy in flight, its completion finds no endpoint */
+    (void)HAL_DMA_Abort(hpcd->hdmapma);
+    hpcd->dma_ep = NULL;
+  }
+#endif /* HAL_DMA_MODULE_ENABLED */
+
   __HAL_LOCK(hpcd);
   (void)USB_DeactivateEndpoint(hpcd->Instance, ep);
   __HAL_UNLOCK(hpcd);
@@ -1445,6 +1499,64 @@ HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr, u
   else
   {
     (void)USB_EPStartXfer(hpcd->Instance, ep);
+
+    /* A packet already parked in a double buffered endpoint is consumed now */
+    if ((ep->doublebuffer != 0U) && (ep->xfer_fill_db != 0U))
+    {
+      ep->xfer_fill_db = 0U;
+      PCD_EP_DB_Receive(hpcd, ep);
+    }
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  End a multi-packet OUT transfer early, keeping the data received
+  *         so far (xfer_count). The endpoint is left NAKing until the next
+  *         HAL_PCD_EP_Receive. Call with the USB interrupt masked.
+  * @param  hpcd PCD handle
+  * @param  ep_addr endpoint address
+  * @retval HAL_OK if the transfer was ended, HAL_BUSY if a received packet is
+  *         still pending in PMA, HAL_ERROR if nothing was received yet
+  */
+HAL_StatusTypeDef HAL_PCD_EP_EndReceive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr)
+{
+  PCD_EPTypeDef *ep;
+
+  ep = &hpcd->OUT_ep[ep_addr & EP_ADDR_MSK];
+
+  if (((ep_addr & EP_ADDR_MSK) == 0U) || (ep->xfer_count == 0U))
+  {
+    return HAL_ERROR;
+  }
+
+  if (PCD_EP_DMABusy(hpcd, ep) != 0U)
+  {
+    /* The DMA completion accounts the packet being copied */
+    return HAL_BUSY;
+  }
+
+  if (ep->doublebuffer == 0U)
+  {
+    /* Stop the peripheral first, then look for a packet that landed */
+    PCD_SET_EP_RX_STATUS(hpcd->Instance, ep->num, USB_EP_RX_NAK);
+  }
+
+  if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_CTR_RX) != 0U)
+  {
+    /* The interrupt handler completes or continues the transfer */
+    return HAL_BUSY;
+  }
+
+  if (ep->doublebuffer == 0U)
+  {
+    ep->xfer_len = 0U;
+  }
+  else
+  {
+    /* Further packets are parked in PMA until the next receive */
+    ep->xfer_armed_db = 0U;
   }
 
   return HAL_OK;
@@ -1487,7 +1599,7 @@ HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
   }
   else
   {
-    (void)USB_EPStartXfer(hpcd->Instance, ep);
+    PCD_EP_StartXfer(hpcd, ep);
   }
 
   return HAL_OK;
@@ -1651,23 +1763,38 @@ PCD_StateTypeDef HAL_PCD_GetState(PCD_HandleTypeDef *hpcd)
 /**
   * @brief  This function handles PCD Endpoint interrupt request.
   * @param  hpcd PCD handle
+  * @param  hp 1 when called from the high priority interrupt
   * @retval HAL status
   */
-static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
+static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd, uint8_t hp)
 {
   PCD_EPTypeDef *ep;
   uint16_t count;
   uint16_t wIstr;
   uint16_t wEPVal;
   uint8_t epindex;
+  uint8_t hp_line;
 
   /* stay in loop while pending interrupts */
-  while ((hpcd->Instance->ISTR & USB_ISTR_CTR) != 0U)
+  for (wIstr = hpcd->Instance->ISTR; (wIstr & USB_ISTR_CTR) != 0U; wIstr = hpcd->Instance->ISTR)
   {
-    wIstr = hpcd->Instance->ISTR;
     /* extract highest priority endpoint number */
     epindex = (uint8_t)(wIstr & USB_ISTR_EP_ID);
 
+    if (hpcd->Init.hp_irq_enable == 1U)
+    {
+      /* The peripheral reports the isochronous and double buffered bulk
+         endpoints first: the high priority interrupt stops at the first
+         other one, the low priority interrupt leaves them to the high
+         priority one, pending as well */
+      hp_line = ((epindex != 0U) && PCD_EP_HP_LINE(PCD_GET_ENDPOINT(hpcd->Instance, epindex))) ? 1U : 0U;
+
+      if (hp_line != hp)
+      {
+        break;
+      }
+    }
+
     if (epindex == 0U)
     {
       /* Decode and service control endpoint interrupt */
@@ -1769,86 +1896,477 @@ static HAL_StatusTypeDef PCD_EP_ISR_Handler(PCD_HandleTypeDef *hpcd)
         if (ep->doublebuffer == 0U)
         {
           count = (uint16_t)PCD_GET_EP_RX_CNT(hpcd->Instance, ep->num);
-          if (count != 0U)
+
+          /* A NULL transfer buffer leaves the packet in PMA, for the class
+             to forward with HAL_PCDEx_PMAExchange. The endpoint NAKs until
+             re-armed, so a DMA copy ends the packet on its completion */
+          if ((count == 0U) || (ep->xfer_buff == NULL) ||
+              (PCD_EP_ReadPMA(hpcd, ep, ep->pmaadress, count) == HAL_OK))
           {
-            USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaadress, count);
+            PCD_EP_RxPacket(hpcd, ep, count);
           }
         }
+        else if ((ep->xfer_armed_db != 0U) && (PCD_EP_DMABusy(hpcd, ep) == 0U))
+        {
+          PCD_EP_DB_Receive(hpcd, ep);
+        }
         else
         {
-          /* free EP OUT Buffer */
-          PCD_FreeUserBuffer(hpcd->Instance, ep->num, 0U);
+          /* No transfer armed, or the previous packet still being copied by
+             DMA: leave the packet in PMA. SW_BUF is not released, so the
+             peripheral NAKs until HAL_PCD_EP_Receive or the DMA completion */
+          ep->xfer_fill_db = 1U;
+        }
+
+      } /* if((wEPVal & EP_CTR_RX) */
+
+      if ((wEPVal & USB_EP_CTR_TX) != 0U)
+      {
+        ep = &hpcd->IN_ep[epindex];
+
+        /* clear int flag */
+        PCD_CLEAR_TX_EP_CTR(hpcd->Instance, epindex);
 
-          if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_RX) != 0U)
+        if (ep->doublebuffer != 0U)
+        {
+          PCD_EP_DB_Transmit(hpcd, ep);
+        }
+        else
+        {
+          /* multi-packet on the NON control IN endpoint */
+          ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
+          ep->xfer_buff += ep->xfer_count;
+
+          /* Zero Length Packet? */
+          if (ep->xfer_len == 0U)
           {
-            /* read from endpoint BUF0Addr buffer */
-            count = (uint16_t)PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
-            if (count != 0U)
-            {
-              USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr0, count);
-            }
+            /* TX COMPLETE */
+#if (USE_HAL_PCD_REGISTER_CALLBACKS == 1U)
+            hpcd->DataInStageCallback(hpcd, ep->num);
+#else
+            HAL_PCD_DataInStageCallback(hpcd, ep->num);
+#endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
           }
           else
           {
-            /* read from endpoint BUF1Addr buffer */
-            count = (uint16_t)PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
-            if (count != 0U)
-            {
-              USB_ReadPMA(hpcd->Instance, ep->xfer_buff, ep->pmaaddr1, count);
-            }
+            /* Next packet of the transfer, the endpoint state carries over */
+            PCD_EP_StartXfer(hpcd, ep);
           }
         }
-        /* multi-packet on the NON control OUT endpoint */
-        ep->xfer_count += count;
-        ep->xfer_buff += count;
+      }
+    }
+  }
+  return HAL_OK;
+}
 
-        if ((ep->xfer_len == 0U) || (count < ep->maxpacket))
-        {
-          /* RX COMPLETE */
+/**
+  * @brief  Handle a CTR_TX event on a double buffered bulk IN endpoint.
+  *         More than one buffer may have been sent since the last event, so
+  *         the number still owned by the peripheral is taken from the
+  *         DTOG_TX/SW_BUF pair rather than counted.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_DB_Transmit(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint16_t wEPVal = PCD_GET_ENDPOINT(hpcd->Instance, ep->num);
+
+  /* DTOG_TX != SW_BUF: one loaded buffer is still waiting for the host */
+  if (((wEPVal & USB_EP_DTOG_TX) != 0U) != ((wEPVal & USB_EP_DTOG_RX) != 0U))
+  {
+    ep->xfer_fill_db = 1U;
+  }
+  else
+  {
+    ep->xfer_fill_db = 0U;
+  }
+
+  if (PCD_EP_DMABusy(hpcd, ep) != 0U)
+  {
+    /* The DMA completion hands over the buffer being filled and refills */
+  }
+  else if (ep->xfer_len != 0U)
+  {
+    /* Refill the released buffer(s) */
+    PCD_EP_StartXfer(hpcd, ep);
+  }
+  else if (ep->xfer_fill_db == 0U)
+  {
+    /* TX COMPLETE */
 #if (USE_HAL_PCD_REGISTER_CALLBACKS == 1U)
-          hpcd->DataOutStageCallback(hpcd, ep->num);
+    hpcd->DataInStageCallback(hpcd, ep->num);
 #else
-          HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+    HAL_PCD_DataInStageCallback(hpcd, ep->num);
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
-        }
-        else
-        {
-          (void)HAL_PCD_EP_Receive(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
-        }
+  }
+  else
+  {
+    /* Last buffer still in flight */
+  }
+}
 
-      } /* if((wEPVal & EP_CTR_RX) */
+/**
+  * @brief  Consume the packet received on a double buffered bulk OUT endpoint.
+  *         SW_BUF is released first so the peripheral can receive into the
+  *         other buffer while this one is copied out.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_DB_Receive(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+  uint16_t count;
+  uint16_t pmabuffer;
 
-      if ((wEPVal & USB_EP_CTR_TX) != 0U)
-      {
-        ep = &hpcd->IN_ep[epindex];
+  /* DTOG_RX has already moved past the filled buffer */
+  if ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_RX) != 0U)
+  {
+    count = (uint16_t)PCD_GET_EP_DBUF0_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr0;
+  }
+  else
+  {
+    count = (uint16_t)PCD_GET_EP_DBUF1_CNT(hpcd->Instance, ep->num);
+    pmabuffer = ep->pmaaddr1;
+  }
 
-        /* clear int flag */
-        PCD_CLEAR_TX_EP_CTR(hpcd->Instance, epindex);
+  /* free EP OUT Buffer */
+  PCD_FreeUserBuffer(hpcd->Instance, ep->num, 0U);
 
-        /* multi-packet on the NON control IN endpoint */
-        ep->xfer_count = PCD_GET_EP_TX_CNT(hpcd->Instance, ep->num);
-        ep->xfer_buff += ep->xfer_count;
+  /* never write past the armed buffer */
+  if (count > ep->xfer_len)
+  {
+    count = (uint16_t)ep->xfer_len;
+  }
 
-        /* Zero Length Packet? */
-        if (ep->xfer_len == 0U)
-        {
-          /* TX COMPLETE */
+  if ((count == 0U) || (PCD_EP_ReadPMA(hpcd, ep, pmabuffer, count) == HAL_OK))
+  {
+    PCD_EP_DB_RxPacket(hpcd, ep, count);
+  }
+}
+
+/**
+  * @brief  Account a packet copied out of a single buffered OUT endpoint and
+  *         complete the transfer or arm its next packet.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  count packet length
+  * @retval None
+  */
+static void PCD_EP_RxPacket(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count)
+{
+  if (ep->xfer_buff != NULL)
+  {
+    ep->xfer_buff += count;
+  }
+
+  /* multi-packet on the NON control OUT endpoint */
+  ep->xfer_count += count;
+
+  if ((ep->xfer_len == 0U) || (count < ep->maxpacket))
+  {
+    /* RX COMPLETE */
 #if (USE_HAL_PCD_REGISTER_CALLBACKS == 1U)
-          hpcd->DataInStageCallback(hpcd, ep->num);
+    hpcd->DataOutStageCallback(hpcd, ep->num);
 #else
-          HAL_PCD_DataInStageCallback(hpcd, ep->num);
+    HAL_PCD_DataOutStageCallback(hpcd, ep->num);
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
+  }
+  else
+  {
+    /* Arm the next packet of the same transfer: xfer_buff, xfer_len
+       and the accumulated xfer_count carry over */
+    (void)USB_EPStartXfer(hpcd->Instance, ep);
+  }
+}
+
+/**
+  * @brief  Account a packet copied out of a double buffered OUT endpoint and
+  *         complete the transfer when it is full or ends short.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  count packet length
+  * @retval None
+  */
+static void PCD_EP_DB_RxPacket(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep, uint16_t count)
+{
+  /* multi-packet on the NON control OUT endpoint */
+  ep->xfer_count += count;
+  ep->xfer_buff += count;
+  ep->xfer_len -= count;
+
+  if ((ep->xfer_len == 0U) || (count < ep->maxpacket))
+  {
+    ep->xfer_armed_db = 0U;
+
+    /* RX COMPLETE */
+#if (USE_HAL_PCD_REGISTER_CALLBACKS == 1U)
+    hpcd->DataOutStageCallback(hpcd, ep->num);
+#else
+    HAL_PCD_DataOutStageCallback(hpcd, ep->num);
+#endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
+  }
+}
+
+/**
+  * @brief  Start or continue a transfer on a non control endpoint. The next
+  *         IN packet is loaded by DMA when the endpoint allows it, otherwise
+  *         by USB_EPStartXfer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval None
+  */
+static void PCD_EP_StartXfer(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+#ifdef HAL_DMA_MODULE_ENABLED
+  uint32_t len;
+  uint16_t pmabuffer;
+  uint8_t sw_buf;
+
+  if ((ep->is_in != 0U) && (ep->xfer_buff != NULL) && (ep->dma_min_size != 0U))
+  {
+    len = (ep->xfer_len > ep->maxpacket) ? ep->maxpacket : ep->xfer_len;
+    sw_buf = ((PCD_GET_ENDPOINT(hpcd->Instance, ep->num) & USB_EP_DTOG_RX) != 0U) ? 1U : 0U;
+
+    if (ep->doublebuffer == 0U)
+    {
+      pmabuffer = ep->pmaadress;
+    }
+    else
+    {
+      pmabuffer = (sw_buf != 0U) ? ep->pmaaddr1 : ep->pmaaddr0;
+    }
+
+    if (PCD_PMA_DMAStart(hpcd, ep, pmabuffer, (uint16_t)len) == HAL_OK)
+    {
+      ep->xfer_len -= len;
+
+      if (ep->doublebuffer != 0U)
+      {
+        if (sw_buf != 0U)
+        {
+          PCD_SET_EP_DBUF1_CNT(hpcd->Instance, ep->num, ep->is_in, len);
         }
         else
         {
-          (void)HAL_PCD_EP_Transmit(hpcd, ep->num, ep->xfer_buff, ep->xfer_len);
+          PCD_SET_EP_DBUF0_CNT(hpcd->Instance, ep->num, ep->is_in, len);
         }
       }
+
+      /* PCD_PMA_DMACplt validates the packet */
+      return;
     }
   }
+#endif /* HAL_DMA_MODULE_ENABLED */
+
+  (void)USB_EPStartXfer(hpcd->Instance, ep);
+}
+
+/**
+  * @brief  Copy a received packet from PMA to the transfer buffer.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  pmabuffer PMA address of the packet
+  * @param  count packet length
+  * @retval HAL_OK when copied, HAL_BUSY when left to the DMA, in which case
+  *         PCD_PMA_DMACplt accounts the packet
+  */
+static HAL_StatusTypeDef PCD_EP_ReadPMA(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep,
+                                        uint16_t pmabuffer, uint16_t count)
+{
+#ifdef HAL_DMA_MODULE_ENABLED
+  if (PCD_PMA_DMAStart(hpcd, ep, pmabuffer, count) == HAL_OK)
+  {
+    return HAL_BUSY;
+  }
+#endif /* HAL_DMA_MODULE_ENABLED */
+
+  USB_ReadPMA(hpcd->Instance, ep->xfer_buff, pmabuffer, count);
+
   return HAL_OK;
 }
 
+/**
+  * @brief  Tell whether a DMA copy of an endpoint is in flight.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @retval 1 while the copy is in flight, 0 otherwise
+  */
+static uint8_t PCD_EP_DMABusy(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep)
+{
+#ifdef HAL_DMA_MODULE_ENABLED
+  return (hpcd->dma_ep == ep) ? 1U : 0U;
+#else
+  UNUSED(hpcd);
+  UNUSED(ep);
+
+  return 0U;
+#endif /* HAL_DMA_MODULE_ENABLED */
+}
+
+#ifdef HAL_DMA_MODULE_ENABLED
+/**
+  * @brief  Start the DMA copy of a packet between the transfer buffer and
+  *         PMA. The channel moves halfwords; an odd last byte is copied by
+  *         the CPU before the start.
+  * @param  hpcd PCD handle
+  * @param  ep endpoint
+  * @param  pmabuffer PMA address of the packet
+  * @param  count packet length
+  * @retval HAL_OK when started, otherwise the caller copies with the CPU
+  */
+static HAL_StatusTypeDef PCD_PMA_DMAStart(PCD_HandleTypeDef *hpcd, PCD_EPTypeDef *ep,
+                                          uint16_t pmabuffer, uint16_t count)
+{
+  __IO uint16_t *pma;
+  uint32_t primask;
+  HAL_StatusTypeDef status = HAL_BUSY;
+
+  if ((hpcd->hdmapma == NULL) || (ep->dma_min_size == 0U) || (count < ep->dma_min_size) ||
+      (((uint32_t)ep->xfer_buff & 1U) != 0U))
+  {
+    return HAL_BUSY;
+  }
+
+  pma = (__IO uint16_t *)((uint32_t)hpcd->Instance + 0x400U + ((uint32_t)pmabuffer * PMA_ACCESS));
+
+  /* A transmit from thread mode may race the interrupt handlers for the
+     channel */
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (hpcd->dma_ep == NULL)
+  {
+    if ((count & 1U) != 0U)
+    {
+      if (ep->is_in != 0U)
+      {
+        pma[count >> 1] = ep->xfer_buff[count - 1U];
+      }
+      else
+      {
+        ep->xfer_buff[count - 1U] = (uint8_t)pma[count >> 1];
+      }
+    }
+
+    hpcd->dma_ep = ep;
+    hpcd->dma_pmabuffer = pmabuffer;
+    hpcd->dma_count = count;
+
+    hpcd->hdmapma->XferCpltCallback = PCD_PMA_DMACplt;
+    hpcd->hdmapma->XferHalfCpltCallback = NULL;
+    hpcd->hdmapma->XferErrorCallback = PCD_PMA_DMAError;
+    hpcd->hdmapma->XferAbortCallback = NULL;
+
+    if (ep->is_in != 0U)
+    {
+      status = HAL_DMA_Start_IT(hpcd->hdmapma, (uint32_t)ep->xfer_buff, (uint32_t)pma, (uint32_t)count >> 1);
+    }
+    else
+    {
+      status = HAL_DMA_Start_IT(hpcd->hdmapma, (uint32_t)pma, (uint32_t)ep->xfer_buff, (uint32_t)count >> 1);
+    }
+
+    if (status != HAL_OK)
+    {
+      hpcd->dma_ep = NULL;
+    }
+  }
+
+  __set_PRIMASK(primask);
+
+  return status;
+}
+
+/**
+  * @brief  Finish the packet whose PMA copy the DMA completed: validate an IN
+  *         packet, account an OUT one. The channel must complete at the
+  *         priority of the USB interrupt, as this runs the PCD callbacks.
+  * @param  hdma DMA handle
+  * @retval None
+  */
+static void PCD_PMA_DMACplt(DMA_HandleTypeDef *hdma)
+{
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)hdma->Parent;
+  PCD_EPTypeDef *ep = hpcd->dma_ep;
+  uint16_t count = hpcd->dma_count;
+
+  /* Free the channel first, the callbacks may start the next copy */
+  hpcd->dma_ep = NULL;
+
+  if (ep == NULL)
+  {
+    /* Aborted by HAL_PCD_EP_Close */
+    return;
+  }
+
+  if (ep->is_in != 0U)
+  {
+    if (ep->doublebuffer == 0U)
+    {
+      PCD_SET_EP_TX_CNT(hpcd->Instance, ep->num, count);
+    }
+    else
+    {
+      PCD_FreeUserBuffer(hpcd->Instance, ep->num, 1U);
+
+      ep->xfer_buff += count;
+      ep->xfer_count += count;
+      ep->xfer_fill_db++;
+    }
+
+    PCD_SET_EP_TX_STATUS(hpcd->Instance, ep->num, USB_EP_TX_VALID);
+
+    /* Load the other buffer, or one the host released meanwhile */
+    if ((ep->doublebuffer != 0U) && (ep->xfer_len != 0U) && (ep->xfer_fill_db < 2U))
+    {
+      PCD_EP_StartXfer(hpcd, ep);
+    }
+  }
+  else if (ep->doublebuffer == 0U)
+  {
+    PCD_EP_RxPacket(hpcd, ep, count);
+  }
+  else
+  {
+    PCD_EP_DB_RxPacket(hpcd, ep, count);
+
+    /* A packet parked while copying continues the transfer */
+    if ((ep->xfer_armed_db != 0U) && (ep->xfer_fill_db != 0U) && (hpcd->dma_ep != ep))
+    {
+      ep->xfer_fill_db = 0U;
+      PCD_EP_DB_Receive(hpcd, ep);
+    }
+  }
+}
+
+/**
+  * @brief  Redo a failed DMA copy with the CPU and finish the packet.
+  * @param  hdma DMA handle
+  * @retval None
+  */
+static void PCD_PMA_DMAError(DMA_HandleTypeDef *hdma)
+{
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)hdma->Parent;
+  PCD_EPTypeDef *ep = hpcd->dma_ep;
+
+  if (ep != NULL)
+  {
+    if (ep->is_in != 0U)
+    {
+      USB_WritePMA(hpcd->Instance, ep->xfer_buff, hpcd->dma_pmabuffer, hpcd->dma_count);
+    }
+    else
+    {
+      USB_ReadPMA(hpcd->Instance, ep->xfer_buff, hpcd->dma_pmabuffer, hpcd->dma_count);
+    }
+  }
+
+  PCD_PMA_DMACplt(hdma);
+}
+#endif /* HAL_DMA_MODULE_ENABLED */
+
 
 /**
   * @}
@@ -115,6 +115,86 @@ HAL_StatusTypeDef  HAL_PCDEx_PMAConfig(PCD_HandleTypeDef *hpcd,
   return HAL_OK;
 }
 
+/**
+  * @brief  Exchange the PMA buffers of a single buffer OUT endpoint and a
+  *         single buffer IN endpoint, for forwarding a received packet
+  *         without copying it. Both buffers must be maxpacket long and both
+  *         endpoints idle (OUT NAKing after its CTR_RX, IN not valid).
+  * @param  hpcd  Device instance
+  * @param  out_ep_addr OUT endpoint address
+  * @param  in_ep_addr IN endpoint address
+  * @retval HAL status
+  */
+HAL_StatusTypeDef  HAL_PCDEx_PMAExchange(PCD_HandleTypeDef *hpcd,
+                                         uint8_t out_ep_addr,
+                                         uint8_t in_ep_addr)
+{
+  PCD_EPTypeDef *out_ep = &hpcd->OUT_ep[out_ep_addr & EP_ADDR_MSK];
+  PCD_EPTypeDef *in_ep = &hpcd->IN_ep[in_ep_addr & EP_ADDR_MSK];
+  uint16_t pmaadress;
+
+  if ((out_ep->doublebuffer != 0U) || (in_ep->doublebuffer != 0U) ||
+      (out_ep->maxpacket != in_ep->maxpacket))
+  {
+    return HAL_ERROR;
+  }
+
+#ifdef HAL_DMA_MODULE_ENABLED
+  if ((hpcd->dma_ep == out_ep) || (hpcd->dma_ep == in_ep))
+  {
+    return HAL_BUSY;
+  }
+#endif /* HAL_DMA_MODULE_ENABLED */
+
+  pmaadress = out_ep->pmaadress;
+  out_ep->pmaadress = in_ep->pmaadress;
+  in_ep->pmaadress = pmaadress;
+
+  PCD_SET_EP_RX_ADDRESS(hpcd->Instance, out_ep->num, out_ep->pmaadress);
+  PCD_SET_EP_TX_ADDRESS(hpcd->Instance, in_ep->num, in_ep->pmaadress);
+
+  return HAL_OK;
+}
+
+#ifdef HAL_DMA_MODULE_ENABLED
+/**
+  * @brief  Let the memory-to-memory DMA channel linked to hdmapma move the
+  *         PMA copies of a bulk endpoint. Packets shorter than min_size,
+  *         odd aligned transfer buffers and packets arriving while the
+  *         channel is busy are still copied by the CPU.
+  * @param  hpcd  Device instance
+  * @param  ep_addr endpoint address
+  * @param  min_size smallest packet copied by DMA, 0 for CPU copies only
+  * @retval HAL status
+  */
+HAL_StatusTypeDef  HAL_PCDEx_PMADMAConfig(PCD_HandleTypeDef *hpcd,
+                                          uint16_t ep_addr,
+                                          uint16_t min_size)
+{
+  PCD_EPTypeDef *ep;
+
+  /* The control endpoint always copies with the CPU; a DMA copy moves at
+     least one halfword */
+  if (((ep_addr & EP_ADDR_MSK) == 0U) || (min_size == 1U))
+  {
+    return HAL_ERROR;
+  }
+
+  if ((0x80U & ep_addr) == 0x80U)
+  {
+    ep = &hpcd->IN_ep[ep_addr & EP_ADDR_MSK];
+  }
+  else
+  {
+    ep = &hpcd->OUT_ep[ep_addr];
+  }
+
+  ep->dma_min_size = min_size;
+
+  return HAL_OK;
+}
+#endif /* HAL_DMA_MODULE_ENABLED */
+
 /**
   * @brief  Activate BatteryCharging feature.
   * @param  hpcd PCD handle
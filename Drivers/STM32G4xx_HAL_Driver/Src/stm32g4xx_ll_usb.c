@@ -312,8 +312,15 @@ HAL_StatusTypeDef USB_ActivateEndpoint(USB_TypeDef *USBx, USB_EPTypeDef *ep)
     /* Set buffer address for double buffered mode */
     PCD_SET_EP_DBUF_ADDR(USBx, ep->num, ep->pmaaddr0, ep->pmaaddr1);
 
+    ep->xfer_fill_db = 0U;
+    ep->xfer_armed_db = 0U;
+
     if (ep->is_in == 0U)
     {
+      /* Both buffers always accept a full packet, the transfer length is
+         enforced in software */
+      PCD_SET_EP_DBUF_CNT(USBx, ep->num, ep->is_in, ep->maxpacket);
+
       /* Clear the data toggle bits for the endpoint IN/OUT */
       PCD_CLEAR_RX_DTOG(USBx, ep->num);
       PCD_CLEAR_TX_DTOG(USBx, ep->num);
@@ -326,10 +333,10 @@ HAL_StatusTypeDef USB_ActivateEndpoint(USB_TypeDef *USBx, USB_EPTypeDef *ep)
     }
     else
     {
-      /* Clear the data toggle bits for the endpoint IN/OUT */
+      /* Clear the data toggle bits for the endpoint IN/OUT: DTOG_TX == SW_BUF,
+         both buffers belong to the application */
       PCD_CLEAR_RX_DTOG(USBx, ep->num);
       PCD_CLEAR_TX_DTOG(USBx, ep->num);
-      PCD_RX_DTOG(USBx, ep->num);
 
       if (ep->type != EP_TYPE_ISOC)
       {
@@ -416,72 +423,96 @@ HAL_StatusTypeDef USB_EPStartXfer(USB_TypeDef *USBx, USB_EPTypeDef *ep)
   /* IN endpoint */
   if (ep->is_in == 1U)
   {
-    /*Multi packet transfer*/
-    if (ep->xfer_len > ep->maxpacket)
-    {
-      len = ep->maxpacket;
-      ep->xfer_len -= len;
-    }
-    else
-    {
-      len = ep->xfer_len;
-      ep->xfer_len = 0U;
-    }
-
     /* configure and validate Tx endpoint */
     if (ep->doublebuffer == 0U)
     {
-      USB_WritePMA(USBx, ep->xfer_buff, ep->pmaadress, (uint16_t)len);
-      PCD_SET_EP_TX_CNT(USBx, ep->num, len);
-    }
-    else
-    {
-      /* Write the data to the USB endpoint */
-      if ((PCD_GET_ENDPOINT(USBx, ep->num) & USB_EP_DTOG_TX) != 0U)
+      /*Multi packet transfer*/
+      if (ep->xfer_len > ep->maxpacket)
       {
-        /* Set the Double buffer counter for pmabuffer1 */
-        PCD_SET_EP_DBUF1_CNT(USBx, ep->num, ep->is_in, len);
-        pmabuffer = ep->pmaaddr1;
+        len = ep->maxpacket;
+        ep->xfer_len -= len;
       }
       else
       {
-        /* Set the Double buffer counter for pmabuffer0 */
-        PCD_SET_EP_DBUF0_CNT(USBx, ep->num, ep->is_in, len);
-        pmabuffer = ep->pmaaddr0;
+        len = ep->xfer_len;
+        ep->xfer_len = 0U;
       }
-      USB_WritePMA(USBx, ep->xfer_buff, pmabuffer, (uint16_t)len);
-      PCD_FreeUserBuffer(USBx, ep->num, ep->is_in);
-    }
 
-    PCD_SET_EP_TX_STATUS(USBx, ep->num, USB_EP_TX_VALID);
-  }
-  else /* OUT endpoint */
-  {
-    /* Multi packet transfer*/
-    if (ep->xfer_len > ep->maxpacket)
-    {
-      len = ep->maxpacket;
-      ep->xfer_len -= len;
+      /* A NULL buffer sends what is already in the PMA buffer */
+      if (ep->xfer_buff != NULL)
+      {
+        USB_WritePMA(USBx, ep->xfer_buff, ep->pmaadress, (uint16_t)len);
+      }
+      PCD_SET_EP_TX_CNT(USBx, ep->num, len);
     }
     else
     {
-      len = ep->xfer_len;
-      ep->xfer_len = 0U;
+      /* Fill the application buffer (SW_BUF) and hand it over, up to two
+         packets ahead; the rest is refilled from the CTR_TX interrupt */
+      do
+      {
+        if (ep->xfer_len > ep->maxpacket)
+        {
+          len = ep->maxpacket;
+          ep->xfer_len -= len;
+        }
+        else
+        {
+          len = ep->xfer_len;
+          ep->xfer_len = 0U;
+        }
+
+        if ((PCD_GET_ENDPOINT(USBx, ep->num) & USB_EP_DTOG_RX) != 0U)
+        {
+          /* Set the Double buffer counter for pmabuffer1 */
+          PCD_SET_EP_DBUF1_CNT(USBx, ep->num, ep->is_in, len);
+          pmabuffer = ep->pmaaddr1;
+        }
+        else
+        {
+          /* Set the Double buffer counter for pmabuffer0 */
+          PCD_SET_EP_DBUF0_CNT(USBx, ep->num, ep->is_in, len);
+          pmabuffer = ep->pmaaddr0;
+        }
+        USB_WritePMA(USBx, ep->xfer_buff, pmabuffer, (uint16_t)len);
+        PCD_FreeUserBuffer(USBx, ep->num, ep->is_in);
+
+        ep->xfer_buff += len;
+        ep->xfer_count += len;
+        ep->xfer_fill_db++;
+      } while ((ep->xfer_len != 0U) && (ep->xfer_fill_db < 2U));
     }
 
+    PCD_SET_EP_TX_STATUS(USBx, ep->num, USB_EP_TX_VALID);
+  }
+  else /* OUT endpoint */
+  {
     /* configure and validate Rx endpoint */
     if (ep->doublebuffer == 0U)
     {
+      /* Multi packet transfer*/
+      if (ep->xfer_len > ep->maxpacket)
+      {
+        len = ep->maxpacket;
+        ep->xfer_len -= len;
+      }
+      else
+      {
+        len = ep->xfer_len;
+        ep->xfer_len = 0U;
+      }
+
       /*Set RX buffer count*/
       PCD_SET_EP_RX_CNT(USBx, ep->num, len);
+      PCD_SET_EP_RX_STATUS(USBx, ep->num, USB_EP_RX_VALID);
     }
     else
     {
-      /*Set the Double buffer counter*/
-      PCD_SET_EP_DBUF_CNT(USBx, ep->num, ep->is_in, len);
+      /* Double buffered OUT stays VALID and xfer_len keeps the whole remaining
+         length: buffer counts were set at activation and must not be
+         rewritten while a packet may be parked in PMA */
+      ep->xfer_armed_db = 1U;
     }
-
-    PCD_SET_EP_RX_STATUS(USBx, ep->num, USB_EP_RX_VALID);
   }
 
   return HAL_OK;
@@ -789,6 +820,9 @@ HAL_StatusTypeDef USB_DeActivateRemoteWakeup(USB_TypeDef *USBx)
 
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @note  A halfword aligned buffer is read a word at a time, 16 bytes per
+  *        loop, each word feeding two PMA halfword stores; an odd aligned
+  *        buffer takes the byte loop.
   * @param   USBx USB peripheral instance register address.
   * @param   pbUsrBuf pointer to user memory area.
   * @param   wPMABufAddr address into PMA.
@@ -800,11 +834,69 @@ void USB_WritePMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, ui
   uint32_t n = ((uint32_t)wNBytes + 1U) >> 1;
   uint32_t BaseAddr = (uint32_t)USBx;
   uint32_t i, temp1, temp2;
+  uint32_t w0, w1, w2, w3;
+  uint32_t len = wNBytes;
   __IO uint16_t *pdwVal;
   uint8_t *pBuf = pbUsrBuf;
+  const uint32_t *pWord;
 
   pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
 
+  if ((((uint32_t)pBuf & 1U) == 0U) && (len >= 4U))
+  {
+    /* Halfword aligned: one halfword brings it to a word boundary */
+    if (((uint32_t)pBuf & 2U) != 0U)
+    {
+      *pdwVal = *(const uint16_t *)(const void *)pBuf;
+      pdwVal += PMA_ACCESS;
+      pBuf += 2U;
+      len -= 2U;
+    }
+
+    pWord = (const uint32_t *)(const void *)pBuf;
+
+    for (i = len >> 4; i != 0U; i--)
+    {
+      w0 = pWord[0];
+      w1 = pWord[1];
+      w2 = pWord[2];
+      w3 = pWord[3];
+      pWord += 4;
+
+      *pdwVal = (uint16_t)w0;
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)(w0 >> 16);
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)w1;
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)(w1 >> 16);
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)w2;
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)(w2 >> 16);
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)w3;
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)(w3 >> 16);
+      pdwVal += PMA_ACCESS;
+    }
+
+    for (i = (len >> 2) & 3U; i != 0U; i--)
+    {
+      w0 = *pWord;
+      pWord++;
+
+      *pdwVal = (uint16_t)w0;
+      pdwVal += PMA_ACCESS;
+      *pdwVal = (uint16_t)(w0 >> 16);
+      pdwVal += PMA_ACCESS;
+    }
+
+    /* Up to 3 bytes left for the halfword loop */
+    pBuf = (uint8_t *)pWord;
+    n = ((len & 3U) + 1U) >> 1;
+  }
+
   for (i = n; i != 0U; i--)
   {
     temp1 = *pBuf;
@@ -823,6 +915,9 @@ void USB_WritePMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, ui
 
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA)
+  * @note  A halfword aligned buffer is written a word at a time, 16 bytes
+  *        per loop, each word built from two PMA halfword loads; an odd
+  *        aligned buffer takes the byte loop.
   * @param   USBx: USB peripheral instance register address.
   * @param   pbUsrBuf pointer to user memory area.
   * @param   wPMABufAddr address into PMA.
@@ -834,11 +929,69 @@ void USB_ReadPMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uin
   uint32_t n = (uint32_t)wNBytes >> 1;
   uint32_t BaseAddr = (uint32_t)USBx;
   uint32_t i, temp;
+  uint32_t h0, h1, h2, h3, h4, h5, h6, h7;
+  uint32_t len = wNBytes;
   __IO uint16_t *pdwVal;
   uint8_t *pBuf = pbUsrBuf;
+  uint32_t *pWord;
 
   pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
 
+  if ((((uint32_t)pBuf & 1U) == 0U) && (len >= 4U))
+  {
+    /* Halfword aligned: one halfword brings it to a word boundary */
+    if (((uint32_t)pBuf & 2U) != 0U)
+    {
+      *(uint16_t *)(void *)pBuf = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      pBuf += 2U;
+      len -= 2U;
+    }
+
+    pWord = (uint32_t *)(void *)pBuf;
+
+    for (i = len >> 4; i != 0U; i--)
+    {
+      h0 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h1 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h2 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h3 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h4 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h5 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h6 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h7 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+
+      pWord[0] = h0 | (h1 << 16);
+      pWord[1] = h2 | (h3 << 16);
+      pWord[2] = h4 | (h5 << 16);
+      pWord[3] = h6 | (h7 << 16);
+      pWord += 4;
+    }
+
+    for (i = (len >> 2) & 3U; i != 0U; i--)
+    {
+      h0 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+      h1 = *pdwVal;
+      pdwVal += PMA_ACCESS;
+
+      *pWord = h0 | (h1 << 16);
+      pWord++;
+    }
+
+    /* Up to 3 bytes left for the halfword loop */
+    pBuf = (uint8_t *)pWord;
+    n = (len & 3U) >> 1;
+  }
+
   for (i = n; i != 0U; i--)
   {
     temp = *(__IO uint16_t *)pdwVal;
@@ -860,7 +1013,6 @@ void USB_ReadPMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uin
   }
 }
 
-
 /**
   * @}
   */
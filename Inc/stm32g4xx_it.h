@@ -56,6 +56,8 @@ void DebugMon_Handler(void);
 void USB_LP_IRQHandler(void);
 void TIM1_UP_TIM16_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void USB_HP_IRQHandler(void);
+void DMA1_Channel1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -104,6 +104,7 @@ extern USBD_DCDC_ItfTypeDef USBD_Interface_fops_FS;
   */
 
 uint8_t CDC_Transmit_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t* Buf, uint16_t Len);
+uint32_t CDC_Write_FS(USBD_CDC_HandleTypeDef *cdc, const uint8_t* Buf, uint32_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
 
@@ -66,7 +66,25 @@
   */
 
 /*---------- -----------*/
-#define USBD_MAX_NUM_INTERFACES     4U
+#define DCDC_NUM_PORTS     2U
+/*---------- -----------*/
+#define DCDC_DBLBUF_PORTS     0x03U
+/*---------- -----------*/
+#define DCDC_VENDOR_ENABLE     1U
+/*---------- -----------*/
+#define DCDC_NCM_ENABLE     0U
+/*---------- -----------*/
+#define DCDC_PMA_DMA_MIN_SIZE     0U
+/*---------- -----------*/
+#define DCDC_USB_HP_IRQ     0U
+/*---------- -----------*/
+#define DCDC_DEFERRED     0U
+/*---------- -----------*/
+#define DCDC_ISR_PROFILE     0U
+/*---------- -----------*/
+#define DCDC_PMA_BENCH     0U
+/*---------- -----------*/
+#define USBD_MAX_NUM_INTERFACES     ((2U * DCDC_NUM_PORTS) + DCDC_VENDOR_ENABLE + (2U * DCDC_NCM_ENABLE))
 /*---------- -----------*/
 #define USBD_MAX_NUM_CONFIGURATION     1U
 /*---------- -----------*/
@@ -77,6 +95,8 @@
 #define USBD_LPM_ENABLED     1U
 /*---------- -----------*/
 #define USBD_SELF_POWERED     1U
+/*---------- -----------*/
+#define USBD_SUPPORT_USER_STRING_DESC     DCDC_NCM_ENABLE
 
 /****************************************/
 /* #define for FS and HS identification */
@@ -0,0 +1,157 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : usbd_pma.h
+  * @brief          : Compile-time packet memory (PMA) layout of the USB device.
+  ******************************************************************************
+  * @attention
+  *
+  * The layout is derived from the endpoint map and packet sizes of the DCDC
+  * class: the BTABLE covers exactly the endpoint registers in use, EP0 follows
+  * it, then every port takes its IN, OUT and notification buffers in turn
+  * (two packet buffers per direction for a double buffered port), then the
+  * vendor function its IN and OUT buffers and the NCM function its IN, OUT
+  * and notification buffers, each when enabled. Buffers are
+  * allocated back to back, so they cannot overlap; the build fails when the
+  * layout does not fit the peripheral.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_PMA__H__
+#define __USBD_PMA__H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_def.h"
+#include "usbd_dcdc.h"
+
+/** @addtogroup USBD_OTG_DRIVER
+  * @{
+  */
+
+/** @defgroup USBD_PMA USBD_PMA
+  * @brief Packet memory layout.
+  * @{
+  */
+
+/** @defgroup USBD_PMA_Exported_Defines USBD_PMA_Exported_Defines
+  * @{
+  */
+
+#define USBD_PMA_SIZE                1024U  /* Dedicated packet buffer memory */
+#define USBD_PMA_ALIGN               2U     /* Buffers are accessed by halfword */
+
+/* Highest endpoint number: notification endpoints end at EP(2N), the OUT
+   endpoints of double buffered ports follow them, then the vendor and NCM
+   functions */
+#define USBD_PMA_EP_COUNT            ((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT + DCDC_VENDOR_ENABLE + \
+                                      (2U * DCDC_NCM_ENABLE) + 1U)
+#define USBD_PMA_BTABLE              0x00U
+#define USBD_PMA_BTABLE_SIZE         (8U * USBD_PMA_EP_COUNT)
+
+#define USBD_PMA_EP0_OUT             (USBD_PMA_BTABLE + USBD_PMA_BTABLE_SIZE)
+#define USBD_PMA_EP0_IN              (USBD_PMA_EP0_OUT + USB_MAX_EP0_SIZE)
+#define USBD_PMA_PORTS_BASE          (USBD_PMA_EP0_IN + USB_MAX_EP0_SIZE)
+
+/* Size of one data pipe buffer (both halves when double buffered) */
+#define USBD_PMA_PIPE_SIZE(port)     ((DCDC_PORT_DBLBUF(port) + 1U) * DCDC_DATA_FS_MAX_PACKET_SIZE)
+
+/* Per port buffer offsets */
+#define USBD_PMA_DCDC_IN(port)       (USBD_PMA_PORTS_BASE +                                                    \
+                                      ((port) * ((2U * DCDC_DATA_FS_MAX_PACKET_SIZE) + DCDC_CMD_PACKET_SIZE)) + \
+                                      (DCDC_DBLBUF_RANK(port) * 2U * DCDC_DATA_FS_MAX_PACKET_SIZE))
+#define USBD_PMA_DCDC_OUT(port)      (USBD_PMA_DCDC_IN(port) + USBD_PMA_PIPE_SIZE(port))
+#define USBD_PMA_DCDC_CMD(port)      (USBD_PMA_DCDC_OUT(port) + USBD_PMA_PIPE_SIZE(port))
+
+/* Second half of a double buffered pipe */
+#define USBD_PMA_DCDC_IN1(port)      (USBD_PMA_DCDC_IN(port) + DCDC_DATA_FS_MAX_PACKET_SIZE)
+#define USBD_PMA_DCDC_OUT1(port)     (USBD_PMA_DCDC_OUT(port) + DCDC_DATA_FS_MAX_PACKET_SIZE)
+
+/* Vendor function bulk pair, after the last port */
+#define USBD_PMA_VENDOR_IN           (USBD_PMA_DCDC_CMD(DCDC_NUM_PORTS - 1U) + DCDC_CMD_PACKET_SIZE)
+#define USBD_PMA_VENDOR_OUT          (USBD_PMA_VENDOR_IN + DCDC_DATA_FS_MAX_PACKET_SIZE)
+
+/* NCM function bulk pair and notification endpoint, after the vendor function */
+#define USBD_PMA_NCM_IN              (USBD_PMA_VENDOR_IN + (DCDC_VENDOR_ENABLE * 2U * DCDC_DATA_FS_MAX_PACKET_SIZE))
+#define USBD_PMA_NCM_OUT             (USBD_PMA_NCM_IN + DCDC_DATA_FS_MAX_PACKET_SIZE)
+#define USBD_PMA_NCM_CMD             (USBD_PMA_NCM_OUT + DCDC_DATA_FS_MAX_PACKET_SIZE)
+
+#define USBD_PMA_END                 (USBD_PMA_NCM_IN + (DCDC_NCM_ENABLE * ((2U * DCDC_DATA_FS_MAX_PACKET_SIZE) + \
+                                                                        DCDC_CMD_PACKET_SIZE)))
+#define USBD_PMA_FREE                (USBD_PMA_SIZE - USBD_PMA_END)
+
+#if (USBD_PMA_BTABLE != BTABLE_ADDRESS)
+#error "USBD PMA layout does not match the BTABLE address programmed by the HAL"
+#endif
+
+#if (USBD_PMA_END > USBD_PMA_SIZE)
+#error "USBD PMA layout overflows the packet memory"
+#endif
+
+#if (((DCDC_DATA_FS_MAX_PACKET_SIZE % USBD_PMA_ALIGN) != 0U) || ((DCDC_CMD_PACKET_SIZE % USBD_PMA_ALIGN) != 0U))
+#error "USBD PMA layout: packet sizes must keep every buffer halfword aligned"
+#endif
+
+#if (DCDC_DATA_FS_MAX_PACKET_SIZE > 62U) && ((DCDC_DATA_FS_MAX_PACKET_SIZE % 32U) != 0U)
+#error "USBD PMA layout: OUT buffers above 62 bytes are sized in 32 byte blocks"
+#endif
+
+#if (DCDC_PMA_BENCH != 0U) && (USBD_PMA_FREE < DCDC_DATA_FS_MAX_PACKET_SIZE)
+#error "USBD PMA layout: DCDC_PMA_BENCH needs one free packet buffer past the endpoints"
+#endif
+
+/**
+  * @}
+  */
+
+#if (DCDC_PMA_BENCH != 0U)
+/** @defgroup USBD_PMA_Exported_Types USBD_PMA_Exported_Types
+  * @{
+  */
+
+/* Cycles of one PMA copy from or to a word aligned buffer, entry n for
+   n + 1 bytes, the best of DCDC_PMA_BENCH runs; filled by USBD_PMA_Bench */
+typedef struct
+{
+  uint16_t Write[DCDC_DATA_FS_MAX_PACKET_SIZE];            /* USB_WritePMA */
+  uint16_t OldWrite[DCDC_DATA_FS_MAX_PACKET_SIZE];         /* Halfword loop it replaced */
+  uint16_t Read[DCDC_DATA_FS_MAX_PACKET_SIZE];             /* USB_ReadPMA */
+  uint16_t OldRead[DCDC_DATA_FS_MAX_PACKET_SIZE];          /* Halfword loop it replaced */
+} USBD_PMA_BenchTypeDef;
+
+extern USBD_PMA_BenchTypeDef USBD_PMA_BenchResult;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_PMA_Exported_Functions USBD_PMA_Exported_Functions
+  * @{
+  */
+
+void USBD_PMA_Bench(void);
+
+/**
+  * @}
+  */
+#endif /* DCDC_PMA_BENCH */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_PMA__H__ */
@@ -41,37 +41,235 @@ extern "C" {
 /** @defgroup usbd_DCDC_Exported_Defines
   * @{
   */
-#define DCDC_IN_EP                                   0x81U  /* EP1 for data IN */
-#define DCDC_OUT_EP                                  0x01U  /* EP1 for data OUT */
-#define DCDC_CMD_EP                                  0x83U  /* EP2 for DCDC commands */
+#ifndef DCDC_NUM_PORTS
+#define DCDC_NUM_PORTS                               2U  /* Number of CDC ACM functions */
+#endif /* DCDC_NUM_PORTS */
+
+#ifndef DCDC_DBLBUF_PORTS
+#define DCDC_DBLBUF_PORTS                            0U  /* Bit n set: port n data pipes are double buffered */
+#endif /* DCDC_DBLBUF_PORTS */
+
+#define DCDC_PORT_DBLBUF(port)                       (((DCDC_DBLBUF_PORTS) >> (port)) & 1U)
+
+/* Double buffered ports below this one (ports are at most 3) */
+#define DCDC_DBLBUF_RANK(port)                       ((((port) > 0U) ? DCDC_PORT_DBLBUF(0U) : 0U) + \
+                                                      (((port) > 1U) ? DCDC_PORT_DBLBUF(1U) : 0U))
+#define DCDC_DBLBUF_COUNT                            (DCDC_PORT_DBLBUF(0U) + DCDC_PORT_DBLBUF(1U) + \
+                                                      DCDC_PORT_DBLBUF(2U))
+
+/* Endpoint map: port n carries its data IN/OUT pair on EP(n + 1) and its
+   notification endpoint on EP(DCDC_NUM_PORTS + n + 1). A double buffered
+   endpoint is unidirectional, so the OUT pipe of a double buffered port moves
+   to EP(2 * DCDC_NUM_PORTS + rank + 1). */
+#define DCDC_IN_EP(port)                             ((uint8_t)(0x81U + (port)))
+#define DCDC_OUT_EP(port)                            ((uint8_t)(DCDC_PORT_DBLBUF(port) ?                        \
+                                                      (0x01U + (2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_RANK(port)) : \
+                                                      (0x01U + (port))))
+#define DCDC_CMD_EP(port)                            ((uint8_t)(0x81U + DCDC_NUM_PORTS + (port)))
+
+#define DCDC_EP_TABLE_SIZE                           16U  /* Endpoint number -> port lookup */
+#define DCDC_NO_PORT                                 0xFFU
+
+#if (DCDC_NUM_PORTS < 1U) || ((2U * DCDC_NUM_PORTS) > 7U)
+#error "DCDC_NUM_PORTS: every port needs two endpoint registers and only EP1..EP7 exist"
+#endif
+
+#if ((DCDC_DBLBUF_PORTS >> DCDC_NUM_PORTS) != 0U)
+#error "DCDC_DBLBUF_PORTS selects a port beyond DCDC_NUM_PORTS"
+#endif
 
-#define DCDC_IN_EP2                                  0x82U
-#define DCDC_OUT_EP2                                 0x02U
-#define DCDC_CMD_EP2                                 0x84U
+#if (((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT) > 7U)
+#error "DCDC_DBLBUF_PORTS: each double buffered port needs a third endpoint register"
+#endif
 
+#ifndef DCDC_VENDOR_ENABLE
+#define DCDC_VENDOR_ENABLE                           0U  /* 1: vendor class bulk function after the ports */
+#endif /* DCDC_VENDOR_ENABLE */
+
+#ifndef DCDC_NCM_ENABLE
+#define DCDC_NCM_ENABLE                              0U  /* 1: CDC-NCM network function after the vendor function */
+#endif /* DCDC_NCM_ENABLE */
+
+/* The vendor function is one more pipe of the port array, index
+   DCDC_VENDOR_PORT, with no ACM control or notification endpoint. Its
+   IN/OUT pair shares the first endpoint register left by the ports, and it
+   owns the interface after theirs. */
+#define DCDC_NUM_PIPES                               (DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE + DCDC_NCM_ENABLE)
+#define DCDC_NUM_INTERFACES                          ((2U * DCDC_NUM_PORTS) + DCDC_VENDOR_ENABLE + \
+                                                      (2U * DCDC_NCM_ENABLE))
+#define DCDC_VENDOR_PORT                             DCDC_NUM_PORTS
+#define DCDC_VENDOR_EP_NUM                           ((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT + 1U)
+#define DCDC_VENDOR_IN_EP                            ((uint8_t)(0x80U | DCDC_VENDOR_EP_NUM))
+#define DCDC_VENDOR_OUT_EP                           ((uint8_t)DCDC_VENDOR_EP_NUM)
+
+#if (((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT + DCDC_VENDOR_ENABLE) > 7U)
+#error "DCDC_VENDOR_ENABLE: no endpoint register left for the vendor function"
+#endif
+
+/* The NCM function is the last pipe, index DCDC_NCM_PORT, with its
+   communication and data interfaces after the vendor one. Its bulk pair and
+   its notification endpoint take the next two endpoint registers. */
+#define DCDC_NCM_PORT                                (DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE)
+#define DCDC_NCM_ITF                                 ((2U * DCDC_NUM_PORTS) + DCDC_VENDOR_ENABLE)
+#define DCDC_NCM_EP_NUM                              ((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT + \
+                                                      DCDC_VENDOR_ENABLE + 1U)
+#define DCDC_NCM_IN_EP                               ((uint8_t)(0x80U | DCDC_NCM_EP_NUM))
+#define DCDC_NCM_OUT_EP                              ((uint8_t)DCDC_NCM_EP_NUM)
+#define DCDC_NCM_CMD_EP                              ((uint8_t)(0x80U | (DCDC_NCM_EP_NUM + 1U)))
+
+#if (((2U * DCDC_NUM_PORTS) + DCDC_DBLBUF_COUNT + DCDC_VENDOR_ENABLE + (2U * DCDC_NCM_ENABLE)) > 7U)
+#error "DCDC_NCM_ENABLE: the NCM function needs two free endpoint registers"
+#endif
+
+#if (DCDC_NCM_ENABLE != 0U) && (USBD_SUPPORT_USER_STRING_DESC != 1U)
+#error "DCDC_NCM_ENABLE: the MAC address string needs USBD_SUPPORT_USER_STRING_DESC"
+#endif
+
+/* Notification endpoint polling: 2^(n-1) microframes at HS, n frames at FS */
 #ifndef DCDC_HS_BINTERVAL
-#define DCDC_HS_BINTERVAL                          0x10U
+#define DCDC_HS_BINTERVAL                          0x04U
 #endif /* DCDC_HS_BINTERVAL */
 
 #ifndef DCDC_FS_BINTERVAL
-#define DCDC_FS_BINTERVAL                          0x10U
+#define DCDC_FS_BINTERVAL                          0x01U
 #endif /* DCDC_FS_BINTERVAL */
 
 /* DCDC Endpoints parameters: you can fine tune these values depending on the needed baudrates and performance. */
 #define DCDC_DATA_HS_MAX_PACKET_SIZE                 512U  /* Endpoint IN & OUT Packet size */
 #define DCDC_DATA_FS_MAX_PACKET_SIZE                 64U  /* Endpoint IN & OUT Packet size */
-#define DCDC_CMD_PACKET_SIZE                         8U  /* Control Endpoint Packet size */
+#define DCDC_CMD_PACKET_SIZE                         16U  /* Control Endpoint Packet size */
+#define DCDC_NOTIFY_DATA_SIZE                        (DCDC_CMD_PACKET_SIZE - 8U)  /* Payload after the notification header */
 
-#define USB_DCDC_CONFIG_DESC_SIZ                     67U
+#if (DCDC_CMD_PACKET_SIZE < 10U)
+#error "DCDC_CMD_PACKET_SIZE must hold a SERIAL_STATE notification"
+#endif
+
+#define USB_DCDC_FUNC_DESC_SIZ                       66U  /* IAD + CDC ACM interface pair */
+#define USB_DCDC_VENDOR_DESC_SIZ                     23U  /* Vendor interface + bulk endpoint pair */
+#define USB_DCDC_NCM_DESC_SIZ                        85U  /* IAD + CDC-NCM interface pair */
+#define USB_DCDC_CONFIG_DESC_SIZ                     (9U + (USB_DCDC_FUNC_DESC_SIZ * DCDC_NUM_PORTS) + \
+                                                      (USB_DCDC_VENDOR_DESC_SIZ * DCDC_VENDOR_ENABLE) + \
+                                                      (USB_DCDC_NCM_DESC_SIZ * DCDC_NCM_ENABLE))
 #define DCDC_DATA_HS_IN_PACKET_SIZE                  DCDC_DATA_HS_MAX_PACKET_SIZE
 #define DCDC_DATA_HS_OUT_PACKET_SIZE                 DCDC_DATA_HS_MAX_PACKET_SIZE
 
 #define DCDC_DATA_FS_IN_PACKET_SIZE                  DCDC_DATA_FS_MAX_PACKET_SIZE
 #define DCDC_DATA_FS_OUT_PACKET_SIZE                 DCDC_DATA_FS_MAX_PACKET_SIZE
 
+/* Speed specialization: the STM32G4 USB peripheral is full speed only, so by
+   default the high speed descriptors are left out, the speed tests fold to
+   constants and the per pipe buffers are sized for FS packets */
+#ifndef DCDC_HS_ENABLE
+#define DCDC_HS_ENABLE                               0U  /* 1: also support a high speed controller */
+#endif /* DCDC_HS_ENABLE */
+
+#if (DCDC_HS_ENABLE != 0U)
+#define DCDC_IS_HS(pdev)                             (((pdev)->dev_speed == USBD_SPEED_HIGH) ? 1U : 0U)
+#define DCDC_DATA_MAX_PACKET_SIZE                    DCDC_DATA_HS_MAX_PACKET_SIZE  /* Largest data packet of the build */
+#else
+#define DCDC_IS_HS(pdev)                             0U
+#define DCDC_DATA_MAX_PACKET_SIZE                    DCDC_DATA_FS_MAX_PACKET_SIZE
+#endif /* DCDC_HS_ENABLE */
+
+/* Data endpoint packet size at the current speed */
+#define DCDC_DATA_MPS(pdev)                          ((DCDC_IS_HS(pdev) != 0U) ? DCDC_DATA_HS_MAX_PACKET_SIZE \
+                                                                               : DCDC_DATA_FS_MAX_PACKET_SIZE)
+
+/* Interrupt side: PMA copy engine, USB interrupt lines, deferred processing */
+#ifndef DCDC_PMA_DMA_MIN_SIZE
+#define DCDC_PMA_DMA_MIN_SIZE                        0U  /* Smallest data packet copied to or from PMA by DMA, 0: CPU only */
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+
+#if (DCDC_PMA_DMA_MIN_SIZE == 1U)
+#error "DCDC_PMA_DMA_MIN_SIZE: a DMA copy moves at least one halfword"
+#endif
+
+#ifndef DCDC_USB_HP_IRQ
+#define DCDC_USB_HP_IRQ                              0U  /* 1: double buffered data endpoints and TX kicks on the USB_HP interrupt */
+#endif /* DCDC_USB_HP_IRQ */
+
+#ifndef DCDC_DEFERRED
+#define DCDC_DEFERRED                                0U  /* 1: data endpoint events run in a task, see USBD_DCDC_EventRun */
+#endif /* DCDC_DEFERRED */
+
+#define DCDC_EVENT_QUEUE_SIZE                        64U  /* One event per endpoint and direction, plus one per pipe */
+#define DCDC_EVENT_PORT                              0x40U  /* Event code of the pipe SOF work, ORed with the pipe index */
+
+#if ((DCDC_EVENT_QUEUE_SIZE & (DCDC_EVENT_QUEUE_SIZE - 1U)) != 0U) || \
+    (DCDC_EVENT_QUEUE_SIZE < ((2U * DCDC_EP_TABLE_SIZE) + DCDC_NUM_PIPES))
+#error "DCDC_EVENT_QUEUE_SIZE: power of two holding one event per endpoint and direction and per pipe"
+#endif
+
+#ifndef DCDC_RX_SLOTS
+#define DCDC_RX_SLOTS                                4U  /* Slots per RX ring, power of two */
+#endif /* DCDC_RX_SLOTS */
+
+#if (DCDC_RX_SLOTS < 2U) || (DCDC_RX_SLOTS > 32U) || ((DCDC_RX_SLOTS & (DCDC_RX_SLOTS - 1U)) != 0U)
+#error "DCDC_RX_SLOTS must be a power of two from 2 to 32"
+#endif
+
+#ifndef DCDC_TX_MSGS
+#define DCDC_TX_MSGS                                 8U  /* Queued messages per port in message mode, power of two */
+#endif /* DCDC_TX_MSGS */
+
+#if (DCDC_TX_MSGS == 0U) || ((DCDC_TX_MSGS & (DCDC_TX_MSGS - 1U)) != 0U)
+#error "DCDC_TX_MSGS must be a power of two"
+#endif
+
+#ifndef DCDC_RX_IDLE_FRAMES
+#define DCDC_RX_IDLE_FRAMES                          1U  /* Idle frames before a partial OUT transfer is delivered */
+#endif /* DCDC_RX_IDLE_FRAMES */
+
+/* IN scheduler frame budget: bulk packets one frame (FS) or microframe (HS)
+   can carry, shared among backlogged weighted ports */
+#ifndef DCDC_SCHED_FS_PACKETS
+#define DCDC_SCHED_FS_PACKETS                        19U
+#endif /* DCDC_SCHED_FS_PACKETS */
+
+#ifndef DCDC_SCHED_HS_PACKETS
+#define DCDC_SCHED_HS_PACKETS                        13U
+#endif /* DCDC_SCHED_HS_PACKETS */
+
+#define DCDC_TX_LAT_BUCKETS                          8U  /* Queue latency histogram: 0, 1, 2-3, 4-7 ... 64+ frames */
+
+/* Interrupt profiling, a development aid: set DCDC_ISR_PROFILE to 1 in
+   usbd_conf.h to start the DWT cycle counter in HAL_PCD_MspInit and time the
+   USB and PMA DMA interrupt handlers. The histogram is read back as class
+   registers DCDC_REG_ISR_MAX_CYCLES and DCDC_REG_ISR_HIST. Keep it 0 in
+   production builds */
+#ifndef DCDC_ISR_PROFILE
+#define DCDC_ISR_PROFILE                             0U  /* 1: the USB interrupt handler feeds USBD_DCDC_IsrProfile */
+#endif /* DCDC_ISR_PROFILE */
+
+#define DCDC_ISR_HIST_BUCKETS                        8U  /* Interrupt duration histogram: <256, 256-511 ... 16k+ cycles */
+#define DCDC_ISR_HIST_SHIFT                          8U  /* log2 of the first bucket bound in CPU cycles */
+
+/* Runtime port count: USBD_DCDC_Process acts on a request once the status
+   stage had time to complete, then drops D+ for DCDC_REENUM_OFF_MS */
+#ifndef DCDC_REENUM_ACK_MS
+#define DCDC_REENUM_ACK_MS                           2U
+#endif /* DCDC_REENUM_ACK_MS */
+
+#ifndef DCDC_REENUM_OFF_MS
+#define DCDC_REENUM_OFF_MS                           10U
+#endif /* DCDC_REENUM_OFF_MS */
+
+#define DCDC_PROCESS_IDLE                            0xFFFFFFFFU  /* USBD_DCDC_Process: nothing to do until USBD_DCDC_ProcessCallback */
+
+/* Short critical section for port state shared by task and USB interrupt */
+#define DCDC_ENTER_CRITICAL()                        uint32_t primask_bit = __get_PRIMASK(); \
+                                                     __disable_irq()
+#define DCDC_EXIT_CRITICAL()                         __set_PRIMASK(primask_bit)
+
 /*---------------------------------------------------------------------*/
 /*  DCDC definitions                                                    */
 /*---------------------------------------------------------------------*/
+/* Vendor device requests (recipient device) */
+#define DCDC_REQ_SET_PORT_COUNT                     0x01U  /* OUT, wValue: 1..DCDC_NUM_PORTS, re-enumerates */
+#define DCDC_REQ_GET_PORT_COUNT                     0x02U  /* IN, 1 byte: ports of the current configuration */
+#define DCDC_REQ_READ_REGS                          0x03U  /* IN, wValue: first register, see usbd_dcdc_regs.h */
+#define DCDC_REQ_WRITE_REGS                         0x04U  /* OUT, wValue: first register, see usbd_dcdc_regs.h */
+
 #define CDC_SEND_ENCAPSULATED_COMMAND               0x00U
 #define CDC_GET_ENCAPSULATED_RESPONSE               0x01U
 #define CDC_SET_COMM_FEATURE                        0x02U
@@ -82,6 +280,20 @@ extern "C" {
 #define CDC_SET_CONTROL_LINE_STATE                  0x22U
 #define CDC_SEND_BREAK                              0x23U
 
+#define CDC_NOTIFY_NETWORK_CONNECTION               0x00U
+#define CDC_NOTIFY_RESPONSE_AVAILABLE               0x01U
+#define CDC_NOTIFY_SERIAL_STATE                     0x20U
+
+/* SERIAL_STATE bitmap */
+#define CDC_SERIAL_STATE_DCD                        0x0001U  /* bRxCarrier */
+#define CDC_SERIAL_STATE_DSR                        0x0002U  /* bTxCarrier */
+#define CDC_SERIAL_STATE_BREAK                      0x0004U
+#define CDC_SERIAL_STATE_RING                       0x0008U
+#define CDC_SERIAL_STATE_FRAMING                    0x0010U
+#define CDC_SERIAL_STATE_PARITY                     0x0020U
+#define CDC_SERIAL_STATE_OVERRUN                    0x0040U
+#define CDC_SERIAL_STATE_EVENTS                     0x007CU  /* Reported once, accumulated while pending */
+
 /**
   * @}
   */
@@ -102,17 +314,128 @@ typedef struct
   uint8_t  datatype;
 } USBD_DCDC_LineCodingTypeDef;
 
+typedef struct
+{
+  uint8_t  *Buf;                                           /* DCDC_RX_SLOTS slots of SlotSize bytes */
+  uint32_t SlotSize;
+  uint32_t Len[DCDC_RX_SLOTS];                             /* Received length per slot */
+  __IO uint32_t Head;                                      /* Slots filled, advanced by DataOut */
+  __IO uint32_t Tail;                                      /* Slots drained, advanced by RxRelease */
+  __IO uint8_t  Stalled;                                   /* Ring full, OUT endpoint left unarmed */
+  uint8_t  Discard;                                        /* Message mode: dropping an oversize message */
+  uint32_t Dropped;                                        /* Statistics: oversize messages dropped */
+} USBD_DCDC_RxRingTypeDef;
+
+typedef struct
+{
+  uint8_t  *Buf;                                           /* DCDC_RX_SLOTS buffers of BufSize bytes */
+  uint32_t BufSize;
+  uint32_t Len[DCDC_RX_SLOTS];                             /* Received length per buffer */
+  __IO uint32_t Free;                                      /* Bit n set: buffer n is in the pool */
+  uint8_t  Armed;                                          /* Buffer the OUT endpoint fills */
+  __IO uint8_t  Starved;                                   /* All buffers on loan, OUT endpoint left unarmed */
+  uint32_t Loans;                                          /* Statistics: buffers handed to the application */
+  uint32_t Starves;                                        /* Statistics: times reception waited for a return */
+} USBD_DCDC_RxPoolTypeDef;
+
+typedef struct
+{
+  uint8_t  Peer;                                           /* Port the OUT packets go to, DCDC_NO_PORT if off */
+  uint8_t  Src;                                            /* Port whose packets this IN endpoint sends */
+  __IO uint8_t  Held;                                      /* OUT packet waiting in PMA for the peer IN endpoint */
+  uint8_t  InFlight;                                       /* IN transfer in progress is a forwarded packet */
+  uint32_t Forwarded;                                      /* Statistics: packets forwarded */
+  uint32_t Waits;                                          /* Statistics: packets that found the peer busy */
+} USBD_DCDC_CutTypeDef;
+
+typedef struct
+{
+  uint8_t  *Buf;                                           /* Byte FIFO, Size is a power of two */
+  uint32_t Size;
+  __IO uint32_t Head;                                      /* Bytes published to DataIn by the last writer out */
+  __IO uint32_t Tail;                                      /* Bytes sent, advanced by DataIn */
+  __IO uint32_t Reserve;                                   /* Bytes claimed by writers, at or ahead of Head */
+  __IO uint32_t Writers;                                   /* Writers between claim and publish */
+  uint32_t InFlight;                                       /* Bytes of the transfer in progress */
+  uint32_t Stage[DCDC_DATA_MAX_PACKET_SIZE / 4U];          /* Packet straddling the wrap */
+  uint32_t Bytes;                                          /* Statistics: payload bytes sent */
+  uint32_t Packets;                                        /* Statistics: packets sent, ZLPs included */
+  uint32_t SizeFlushes;                                    /* Statistics: transfers started by full packets */
+  uint32_t TimerFlushes;                                   /* Statistics: partial packets sent by the SOF flush */
+  uint8_t  FlushFrames;                                    /* Frames a partial packet may wait, 0 sends at once */
+  uint8_t  Age;                                            /* Frames the partial packet has waited */
+  uint32_t MsgStart[DCDC_TX_MSGS];                         /* Message mode: queue position of each message */
+  uint32_t MsgLen[DCDC_TX_MSGS];
+  __IO uint32_t MsgHead;                                   /* Messages queued, advanced by TxWrite */
+  __IO uint32_t MsgTail;                                   /* Messages started, advanced by the queue kick */
+  uint8_t  Weight;                                         /* Scheduler: share of the frame budget, 0 unscheduled */
+  uint8_t  Deferred;                                       /* Scheduler: held back, retried from SOF */
+  int32_t  Deficit;                                        /* Scheduler: bytes the port may still start */
+  uint32_t Rate;                                           /* Token bucket: bytes per frame, 0 uncapped */
+  uint32_t Burst;                                          /* Token bucket depth */
+  int32_t  Tokens;
+  uint32_t Defers;                                         /* Statistics: transfer starts held back */
+  uint32_t Stamp;                                          /* Frame the oldest unsent data was queued */
+  uint32_t Latency[DCDC_TX_LAT_BUCKETS];                   /* Statistics: frames from TxWrite to transfer start */
+} USBD_DCDC_TxQueueTypeDef;
+
+typedef struct
+{
+  const uint8_t *Buf;
+  uint32_t Len;
+} USBD_DCDC_IoVecTypeDef;
+
+typedef struct
+{
+  const USBD_DCDC_IoVecTypeDef *Iov;                       /* Chain in progress, NULL when idle */
+  uint32_t IovCnt;
+  uint32_t Index;                                          /* Current fragment */
+  uint32_t Offset;                                         /* Bytes of the current fragment sent */
+  uint32_t Total;                                          /* Bytes of the whole chain */
+  uint32_t Bounce[DCDC_DATA_MAX_PACKET_SIZE / 4U];         /* Packet straddling fragments */
+} USBD_DCDC_TxVecTypeDef;
+
+typedef struct
+{
+  uint32_t Buf[DCDC_CMD_PACKET_SIZE / 4U];                 /* Notification being sent */
+  __IO uint8_t  Busy;                                      /* Notification endpoint in use */
+  __IO uint8_t  Pending;                                   /* Notifications waiting for the endpoint */
+  uint16_t SerialState;                                    /* Line levels, plus events not yet reported */
+  uint8_t  Event;                                          /* Pending out-of-band notification */
+  uint8_t  EventLen;
+  uint16_t EventValue;
+  uint8_t  EventData[DCDC_NOTIFY_DATA_SIZE];
+  uint32_t Sent;                                           /* Statistics: notifications sent */
+  uint32_t Coalesced;                                      /* Statistics: posts merged into a pending one */
+} USBD_DCDC_NotifyTypeDef;
+
 typedef struct {
-    uint32_t data[DCDC_DATA_HS_MAX_PACKET_SIZE / 4U];      /* Force 32bits alignment */
+    uint32_t data[DCDC_DATA_MAX_PACKET_SIZE / 4U];         /* Force 32bits alignment */
     uint8_t  CmdOpCode;
     uint8_t  CmdLength;
+    uint8_t  Port;                                          /* Port index */
+    uint8_t  Itf;                                           /* Communication (or only) interface number */
+    uint8_t  InEp;
+    uint8_t  OutEp;
+    uint8_t  CmdEp;
     uint8_t  *RxBuffer;
     uint8_t  *TxBuffer;
     uint32_t RxLength;
     uint32_t TxLength;
+    uint32_t RxXferSize;                                    /* OUT transfer size, whole packets */
+    uint32_t RxPartial;                                     /* Bytes of the OUT transfer at the last SOF */
+    uint8_t  RxIdle;                                        /* Frames without OUT progress */
+    uint8_t  MsgMode;                                       /* Transfers delimit messages, see USBD_DCDC_SetMsgMode */
 
     __IO uint32_t TxState;
-    __IO uint32_t RxState;
+    __IO uint32_t RxState;                                  /* 0: idle, 1: OUT armed, 2: completed, DataOut queued */
+
+    USBD_DCDC_RxRingTypeDef RxRing;                         /* Used once USBD_DCDC_SetRxRing is called */
+    USBD_DCDC_RxPoolTypeDef RxPool;                         /* Used once USBD_DCDC_SetRxPool is called */
+    USBD_DCDC_CutTypeDef Cut;                               /* PMA to PMA forwarding, see USBD_DCDC_SetCutThrough */
+    USBD_DCDC_TxQueueTypeDef TxQueue;                       /* Used once USBD_DCDC_SetTxQueue is called */
+    USBD_DCDC_TxVecTypeDef TxVec;                           /* Scatter-gather transmit state */
+    USBD_DCDC_NotifyTypeDef Notify;                         /* Notification endpoint state */
 } USBD_CDC_HandleTypeDef;
 
 typedef struct _USBD_DCDC_Itf
@@ -121,16 +444,45 @@ typedef struct _USBD_DCDC_Itf
   int8_t (* DeInit)(USBD_CDC_HandleTypeDef *cdc);
   int8_t (* Control)(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t *pbuf, uint16_t length);
   int8_t (* Receive)(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len);
+  int8_t (* TransmitCplt)(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len);
 
 } USBD_DCDC_ItfTypeDef;
 
 typedef struct
 {
-  USBD_CDC_HandleTypeDef CDC1;
-  USBD_CDC_HandleTypeDef CDC2;
+  uint8_t  Ep[DCDC_EVENT_QUEUE_SIZE];                     /* Endpoint addresses, direction bit set for IN, or DCDC_EVENT_PORT */
+  __IO uint8_t Head;                                      /* Written by the USB interrupt only */
+  __IO uint8_t Tail;                                      /* Written by USBD_DCDC_EventRun only */
+  __IO uint32_t PortQueued;                               /* Bit n: SOF work of pipe n queued */
+} USBD_DCDC_EventQueueTypeDef;
+
+typedef struct
+{
+  USBD_CDC_HandleTypeDef CDC[DCDC_NUM_PIPES];                /* Ports, then the vendor and NCM functions */
+  uint8_t EpPort[DCDC_EP_TABLE_SIZE];                     /* Endpoint number -> port index */
+  uint8_t Ports;                                          /* Ports of this configuration, see USBD_DCDC_SetPortCount */
+  uint8_t Express;                                        /* Strict priority port, DCDC_NO_PORT if none */
+  uint32_t Frame;                                         /* SOF count, time base of the TX scheduler */
+  __IO uint32_t TxKick;                                   /* Bit n: pipe n queue kick handed to the USB interrupt */
+#if (DCDC_DEFERRED != 0U)
+  USBD_DCDC_EventQueueTypeDef Events;                     /* Data endpoint events waiting for USBD_DCDC_EventRun */
+#endif /* DCDC_DEFERRED */
 }
 USBD_DCDC_HandleTypeDef;
 
+typedef struct
+{
+  uint32_t Switches;                                      /* Port count changes completed */
+  uint32_t LastMs;                                        /* Request to SET_CONFIGURATION of the new layout */
+  uint32_t MaxMs;
+} USBD_DCDC_ReenumStatsTypeDef;
+
+typedef struct
+{
+  uint32_t Hist[DCDC_ISR_HIST_BUCKETS];                   /* USB interrupts by duration, log2 buckets */
+  uint32_t MaxCycles;                                     /* Longest USB interrupt */
+} USBD_DCDC_IsrStatsTypeDef;
+
 
 
 /** @defgroup USBD_CORE_Exported_Macros
@@ -147,6 +499,9 @@ USBD_DCDC_HandleTypeDef;
 
 extern USBD_ClassTypeDef  USBD_DCDC;
 #define USBD_DCDC_CLASS    &USBD_DCDC
+
+extern USBD_DCDC_ReenumStatsTypeDef USBD_DCDC_ReenumStats;
+extern USBD_DCDC_IsrStatsTypeDef USBD_DCDC_IsrStats;
 /**
   * @}
   */
@@ -166,9 +521,103 @@ uint8_t  USBD_DCDC_SetRxBuffer(USBD_HandleTypeDef   *pdev,
                               USBD_CDC_HandleTypeDef *cdc,
                               uint8_t  *pbuff);
 
+uint8_t  USBD_DCDC_SetRxRing(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint8_t  *pbuff,
+                            uint32_t slot_size);
+
+uint8_t  USBD_DCDC_SetRxPool(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint8_t  *pbuff,
+                            uint32_t buf_size);
+
+uint8_t  USBD_DCDC_SetCutThrough(USBD_HandleTypeDef   *pdev,
+                                USBD_CDC_HandleTypeDef *cdc,
+                                USBD_CDC_HandleTypeDef *peer);
+
+uint8_t  USBD_DCDC_RxReturn(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           uint8_t *buf);
+
+uint8_t  USBD_DCDC_SetRxXferSize(USBD_HandleTypeDef   *pdev,
+                                USBD_CDC_HandleTypeDef *cdc,
+                                uint32_t size);
+
+uint8_t  USBD_DCDC_RxFlush(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  *USBD_DCDC_RxPeek(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                          uint32_t *length);
+
+uint8_t  USBD_DCDC_RxRelease(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  USBD_DCDC_SetTxQueue(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t  *pbuff,
+                             uint32_t size);
+
+uint32_t USBD_DCDC_TxWrite(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           const uint8_t *pbuff, uint32_t length);
+
+uint8_t  USBD_DCDC_TxSubmit(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           const uint8_t *pbuff, uint32_t length);
+
+uint32_t USBD_DCDC_TxFree(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+void     USBD_DCDC_TxService(USBD_HandleTypeDef *pdev);
+
+uint8_t  USBD_DCDC_SetTxFlush(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t frames);
+
+uint8_t  USBD_DCDC_SetTxWeight(USBD_HandleTypeDef   *pdev,
+                              USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t weight);
+
+uint8_t  USBD_DCDC_SetTxRate(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint32_t rate, uint32_t burst);
+
+uint8_t  USBD_DCDC_SetTxExpress(USBD_HandleTypeDef   *pdev,
+                               USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  USBD_DCDC_SetMsgMode(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t enable);
+
+uint8_t  USBD_DCDC_NotifySerialState(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                    uint16_t state);
+
+uint8_t  USBD_DCDC_NotifyEvent(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t notification, uint16_t value,
+                              const uint8_t *pbuff, uint16_t length);
+
 uint8_t  USBD_DCDC_ReceivePacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
 
+uint8_t  USBD_DCDC_SetPortCount(USBD_HandleTypeDef *pdev, uint8_t ports);
+
+uint8_t  USBD_DCDC_GetPortCount(void);
+
+uint32_t USBD_DCDC_Process(USBD_HandleTypeDef *pdev);
+
+void     USBD_DCDC_ProcessCallback(USBD_HandleTypeDef *pdev);
+
 uint8_t  USBD_DCDC_TransmitPacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  USBD_DCDC_TransmitVec(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                              const USBD_DCDC_IoVecTypeDef *iov, uint32_t iovcnt);
+
+uint8_t  USBD_DCDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+uint8_t  USBD_DCDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+
+#if (DCDC_DEFERRED != 0U)
+uint8_t  USBD_DCDC_EventPost(USBD_HandleTypeDef *pdev, uint8_t ep_addr);
+
+uint8_t  USBD_DCDC_EventPending(USBD_HandleTypeDef *pdev);
+
+void     USBD_DCDC_EventRun(USBD_HandleTypeDef *pdev);
+#endif /* DCDC_DEFERRED */
+
+void     USBD_DCDC_IsrProfile(uint32_t cycles);
 /**
   * @}
   */
@@ -0,0 +1,146 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dcdc_ncm.h
+  * @brief   header file for the usbd_dcdc_ncm.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * The CDC-NCM function is the last pipe of the DCDC class, see
+  * DCDC_NCM_ENABLE. The class calls into this module for the NCM
+  * interfaces; the application sends Ethernet frames with USBD_NCM_Transmit
+  * and gets received NTBs through the interface Receive callback of the
+  * DCDC_NCM_PORT pipe, to be walked with NCM_NtbOpen/NCM_NtbNext and
+  * returned with USBD_DCDC_RxRelease.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_DCDC_NCM_H
+#define __USBD_DCDC_NCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_dcdc.h"
+#include  "usbd_ncm_ntb.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_DCDC_NCM
+  * @brief CDC-NCM network function of the DCDC class
+  * @{
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Exported_Defines
+  * @{
+  */
+#ifndef DCDC_NCM_NTB_IN_SIZE
+#define DCDC_NCM_NTB_IN_SIZE                         2048U  /* dwNtbInMaxSize, per NTB buffer */
+#endif /* DCDC_NCM_NTB_IN_SIZE */
+
+#ifndef DCDC_NCM_NTB_OUT_SIZE
+#define DCDC_NCM_NTB_OUT_SIZE                        2048U  /* RX ring slot; dwNtbOutMaxSize is one packet less */
+#endif /* DCDC_NCM_NTB_OUT_SIZE */
+
+#ifndef DCDC_NCM_FLUSH_FRAMES
+#define DCDC_NCM_FLUSH_FRAMES                        1U  /* Frames a datagram may wait for others, 0 sends at once */
+#endif /* DCDC_NCM_FLUSH_FRAMES */
+
+#ifndef DCDC_NCM_MAC_STR_IDX
+#define DCDC_NCM_MAC_STR_IDX                         0x06U  /* iMACAddress string index */
+#endif /* DCDC_NCM_MAC_STR_IDX */
+
+#ifndef DCDC_NCM_HOST_MAC
+#define DCDC_NCM_HOST_MAC                            "0280E1000001"  /* Locally administered */
+#endif /* DCDC_NCM_HOST_MAC */
+
+#define DCDC_NCM_MAX_SEGMENT_SIZE                    1514U  /* wMaxSegmentSize: Ethernet frame without FCS */
+
+#if (DCDC_NCM_NTB_IN_SIZE < 2048U) || (DCDC_NCM_NTB_IN_SIZE > 0xFFFFU) || ((DCDC_NCM_NTB_IN_SIZE % 4U) != 0U)
+#error "DCDC_NCM_NTB_IN_SIZE: NCM requires at least 2048 bytes, NTB16 at most 65535, word multiple"
+#endif
+
+#if ((DCDC_NCM_NTB_OUT_SIZE - DCDC_DATA_FS_MAX_PACKET_SIZE) < (NCM_NTH16_SIZE + NCM_NDP16_MIN_SIZE + 4U + DCDC_NCM_MAX_SEGMENT_SIZE)) || \
+    (DCDC_NCM_NTB_OUT_SIZE > 0xFFFFU)
+#error "DCDC_NCM_NTB_OUT_SIZE must hold an NTB with one full size datagram"
+#endif
+
+/* NCM class requests */
+#define NCM_SET_ETHERNET_PACKET_FILTER               0x43U
+#define NCM_GET_NTB_PARAMETERS                       0x80U
+#define NCM_GET_NTB_INPUT_SIZE                       0x85U
+#define NCM_SET_NTB_INPUT_SIZE                       0x86U
+
+#define CDC_NOTIFY_CONNECTION_SPEED_CHANGE           0x2AU
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint32_t TxDatagrams;                                    /* Statistics: datagrams queued for the host */
+  uint32_t TxNtbs;                                         /* Statistics: NTBs sent */
+  uint32_t TxFull;                                         /* Statistics: datagrams refused, both NTBs in use */
+} USBD_NCM_StatsTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Exported_Variables
+  * @{
+  */
+extern USBD_NCM_StatsTypeDef USBD_NCM_Stats;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_NCM_Init(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  USBD_NCM_Setup(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                        USBD_SetupReqTypedef *req);
+
+void     USBD_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+void     USBD_NCM_TxKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  USBD_NCM_SofDue(USBD_CDC_HandleTypeDef *cdc);
+
+void     USBD_NCM_SofRun(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+uint8_t  *USBD_NCM_GetUsrStrDescriptor(USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length);
+
+uint8_t  USBD_NCM_Transmit(USBD_HandleTypeDef *pdev, const uint8_t *frame, uint16_t length);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_DCDC_NCM_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,141 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dcdc_regs.h
+  * @brief   header file for the usbd_dcdc_regs.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * The register map is reached with the DCDC_REQ_READ_REGS and
+  * DCDC_REQ_WRITE_REGS vendor device requests, so the host can poll the
+  * class statistics and tune the TX parameters over EP0 without touching
+  * the data pipes. Registers are 32-bit little-endian words, addressed by
+  * index: block 0 holds the class registers, block n + 1 the registers of
+  * pipe n, each block DCDC_REG_BLOCK_SIZE registers long. Unmapped
+  * registers read as 0 so a burst may span gaps.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_DCDC_REGS_H
+#define __USBD_DCDC_REGS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_dcdc.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_DCDC_REGS
+  * @brief Vendor register map of the DCDC class
+  * @{
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Exported_Defines
+  * @{
+  */
+#define DCDC_REG_BLOCK_SIZE                          0x40U  /* Registers per block */
+#define DCDC_REG_COUNT                               (DCDC_REG_BLOCK_SIZE * (DCDC_NUM_PIPES + 1U))
+#define DCDC_REG_PIPE(pipe, reg)                     ((DCDC_REG_BLOCK_SIZE * ((pipe) + 1U)) + (reg))
+#define DCDC_REG_MAX_BURST                           (USBD_MAX_STR_DESC_SIZ / 4U)  /* Registers per request */
+
+#define DCDC_REG_ID_VALUE                            0x43444344U  /* "DCDC" */
+
+/* Class registers, block 0 */
+#define DCDC_REG_ID                                  0x00U  /* RO: DCDC_REG_ID_VALUE */
+#define DCDC_REG_PIPES                               0x01U  /* RO: pipe blocks that follow */
+#define DCDC_REG_PORTS                               0x02U  /* RO: ports of the current configuration */
+#define DCDC_REG_FRAME                               0x03U  /* RO: SOF count */
+#define DCDC_REG_EXPRESS                             0x04U  /* RW: strict priority pipe, 0xFF none */
+#define DCDC_REG_WRITE_ERRORS                        0x05U  /* RO: register writes refused */
+#define DCDC_REG_REENUM_SWITCHES                     0x08U  /* RO: USBD_DCDC_ReenumStats */
+#define DCDC_REG_REENUM_LAST_MS                      0x09U
+#define DCDC_REG_REENUM_MAX_MS                       0x0AU
+#define DCDC_REG_NCM_TX_DATAGRAMS                    0x10U  /* RO: USBD_NCM_Stats, 0 without NCM */
+#define DCDC_REG_NCM_TX_NTBS                         0x11U
+#define DCDC_REG_NCM_TX_FULL                         0x12U
+#define DCDC_REG_ISR_MAX_CYCLES                      0x18U  /* RO: USBD_DCDC_IsrStats, 0 without DCDC_ISR_PROFILE */
+#define DCDC_REG_ISR_HIST                            0x20U  /* RO: DCDC_ISR_HIST_BUCKETS histogram registers */
+
+/* Pipe registers, block n + 1 */
+#define DCDC_REG_STATE                               0x00U  /* RO: DCDC_REG_STATE_xxx bits */
+#define DCDC_REG_TX_SIZE                             0x01U  /* RO: TX queue size, 0 without queue */
+#define DCDC_REG_TX_QUEUED                           0x02U  /* RO: bytes waiting in the TX queue */
+#define DCDC_REG_TX_BYTES                            0x03U  /* RO: TX queue statistics */
+#define DCDC_REG_TX_PACKETS                          0x04U
+#define DCDC_REG_TX_SIZE_FLUSHES                     0x05U
+#define DCDC_REG_TX_TIMER_FLUSHES                    0x06U
+#define DCDC_REG_TX_DEFERS                           0x07U
+#define DCDC_REG_TX_FLUSH_FRAMES                     0x08U  /* RW: see USBD_DCDC_SetTxFlush */
+#define DCDC_REG_TX_WEIGHT                           0x09U  /* RW: see USBD_DCDC_SetTxWeight */
+#define DCDC_REG_TX_RATE                             0x0AU  /* RW: see USBD_DCDC_SetTxRate, raises the burst to the rate */
+#define DCDC_REG_TX_BURST                            0x0BU  /* RW: see USBD_DCDC_SetTxRate */
+#define DCDC_REG_TX_LATENCY                          0x10U  /* RO: DCDC_TX_LAT_BUCKETS histogram registers */
+#define DCDC_REG_RX_PENDING                          0x20U  /* RO: RX ring slots waiting for RxRelease */
+#define DCDC_REG_RX_DROPPED                          0x21U  /* RO: RX ring and pool statistics */
+#define DCDC_REG_RX_LOANS                            0x22U
+#define DCDC_REG_RX_STARVES                          0x23U
+#define DCDC_REG_NOTIFY_SENT                         0x28U  /* RO: notification statistics */
+#define DCDC_REG_NOTIFY_COALESCED                    0x29U
+#define DCDC_REG_SERIAL_STATE                        0x2AU  /* RO: SERIAL_STATE bitmap */
+#define DCDC_REG_CUT_FORWARDED                       0x30U  /* RO: cut-through statistics */
+#define DCDC_REG_CUT_WAITS                           0x31U
+
+#define DCDC_REG_STATE_TX_BUSY                       0x01U
+#define DCDC_REG_STATE_RX_BUSY                       0x02U
+#define DCDC_REG_STATE_MSG_MODE                      0x04U
+#define DCDC_REG_STATE_RX_STALLED                    0x08U
+#define DCDC_REG_STATE_RX_STARVED                    0x10U
+#define DCDC_REG_STATE_CUT_HELD                      0x20U
+
+#if ((DCDC_REG_TX_LATENCY + DCDC_TX_LAT_BUCKETS) > DCDC_REG_RX_PENDING)
+#error "DCDC_TX_LAT_BUCKETS: the latency histogram overlaps the RX registers"
+#endif
+
+#if ((DCDC_REG_ISR_HIST + DCDC_ISR_HIST_BUCKETS) > DCDC_REG_BLOCK_SIZE)
+#error "DCDC_ISR_HIST_BUCKETS: the interrupt histogram overflows the class block"
+#endif
+
+#if (DCDC_REG_COUNT > 0x10000U)
+#error "DCDC_REG_COUNT: registers are addressed by a 16-bit wValue"
+#endif
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_DCDC_RegSetup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req);
+
+void     USBD_DCDC_RegRxReady(USBD_HandleTypeDef *pdev);
+
+uint32_t USBD_DCDC_RegRead(USBD_HandleTypeDef *pdev, uint16_t reg);
+
+uint8_t  USBD_DCDC_RegWrite(USBD_HandleTypeDef *pdev, uint16_t reg, uint32_t value);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_DCDC_REGS_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file    usbd_ncm_ntb.h
+  * @brief   Header file for usbd_ncm_ntb.c: CDC-NCM NTB16 builder and parser.
+  ******************************************************************************
+  * @attention
+  *
+  * The codec only depends on the C library, so it builds for the target and
+  * for the host alike. Datagrams and NDPs are placed on NCM_NTB_ALIGN byte
+  * boundaries, matching the divisor and alignment the NCM function reports
+  * in GET_NTB_PARAMETERS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_NCM_NTB_H
+#define __USBD_NCM_NTB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_NCM_NTB
+  * @brief NTB16 transfer block encoding
+  * @{
+  */
+
+/** @defgroup usbd_NCM_NTB_Exported_Defines
+  * @{
+  */
+#define NCM_NTH16_SIGNATURE                          0x484D434EU  /* "NCMH" */
+#define NCM_NDP16_SIGNATURE                          0x304D434EU  /* "NCM0", no CRC */
+#define NCM_NDP16_CRC_SIGNATURE                      0x314D434EU  /* "NCM1", CRC appended */
+#define NCM_NTH16_SIZE                               12U
+#define NCM_NDP16_HDR_SIZE                           8U
+#define NCM_NDP16_MIN_SIZE                           16U
+#define NCM_NTB_ALIGN                                4U  /* Datagram and NDP alignment */
+
+#ifndef NCM_NTB_MAX_DATAGRAMS
+#define NCM_NTB_MAX_DATAGRAMS                        16U  /* Datagrams per built NTB */
+#endif /* NCM_NTB_MAX_DATAGRAMS */
+
+/* Return codes */
+#define NCM_NTB_OK                                   0U
+#define NCM_NTB_FULL                                 1U  /* Builder: datagram does not fit */
+#define NCM_NTB_END                                  2U  /* Reader: no more datagrams */
+#define NCM_NTB_ERROR                                3U  /* Reader: malformed NTB */
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_NCM_NTB_Exported_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint8_t  *Buf;
+  uint32_t Size;                                           /* NTB size limit, at most 0xFFFF */
+  uint32_t Len;                                            /* End of the last datagram */
+  uint16_t Seq;                                            /* wSequence of this NTB */
+  uint16_t Count;
+  uint16_t Index[NCM_NTB_MAX_DATAGRAMS];                   /* wDatagramIndex of each datagram */
+  uint16_t Length[NCM_NTB_MAX_DATAGRAMS];
+} NCM_NtbBuilderTypeDef;
+
+typedef struct
+{
+  const uint8_t *Ntb;
+  uint32_t Len;                                            /* wBlockLength */
+  uint16_t Ndp;                                            /* Current NDP, 0 when done */
+  uint16_t Entry;                                          /* Next entry of the current NDP */
+} NCM_NtbReaderTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_NCM_NTB_Exported_Functions
+  * @{
+  */
+void     NCM_NtbInit(NCM_NtbBuilderTypeDef *b, uint8_t *buf, uint32_t size, uint16_t seq);
+uint8_t  NCM_NtbAdd(NCM_NtbBuilderTypeDef *b, const uint8_t *dg, uint16_t len);
+uint32_t NCM_NtbFinish(NCM_NtbBuilderTypeDef *b);
+
+uint8_t  NCM_NtbOpen(NCM_NtbReaderTypeDef *r, const uint8_t *ntb, uint32_t len);
+uint8_t  NCM_NtbNext(NCM_NtbReaderTypeDef *r, const uint8_t **dg, uint16_t *len);
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USBD_NCM_NTB_H */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
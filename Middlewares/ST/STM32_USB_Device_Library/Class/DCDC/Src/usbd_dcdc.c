@@ -57,6 +57,8 @@ EndBSPDependencies */
 
 /* Includes ------------------------------------------------------------------*/
 #include "../Inc/usbd_dcdc.h"
+#include "../Inc/usbd_dcdc_ncm.h"
+#include "../Inc/usbd_dcdc_regs.h"
 #include "usbd_ctlreq.h"
 
 /** @addtogroup STM32_USB_DEVICE_LIBRARY
@@ -72,6 +74,16 @@ EndBSPDependencies */
 /** @defgroup USBD_DCDC_Private_TypesDefinitions
   * @{
   */
+typedef struct
+{
+  __IO uint8_t Request;                                    /* Port count asked for, 0 if none */
+  uint8_t  Target;                                         /* Port count being switched to */
+  uint8_t  State;                                          /* DCDC_REENUM_IDLE or DCDC_REENUM_OFF */
+  uint8_t  Measuring;                                      /* Switch not yet configured by the host */
+  uint32_t Start;                                          /* Tick of the request */
+  uint32_t Tick;                                           /* Tick of the request or of the disconnect */
+  uint32_t Logged;                                         /* Switches reported by USBD_DCDC_Process */
+} USBD_DCDC_ReenumTypeDef;
 /**
   * @}
   */
@@ -80,6 +92,15 @@ EndBSPDependencies */
 /** @defgroup USBD_DCDC_Private_Defines
   * @{
   */
+
+/* USBD_DCDC_NotifyTypeDef Pending bits */
+#define DCDC_NOTIFY_SERIAL_STATE   0x01U
+#define DCDC_NOTIFY_EVENT          0x02U
+
+/* USBD_DCDC_ReenumTypeDef State */
+#define DCDC_REENUM_IDLE           0x00U
+#define DCDC_REENUM_OFF            0x01U  /* D+ pull-up removed */
+
 /**
   * @}
   */
@@ -89,6 +110,252 @@ EndBSPDependencies */
   * @{
   */
 
+/* Longest whole-packet transfer the 16 bit length of USBD_LL_Transmit takes */
+#define DCDC_XFER_MAX(mps)              (0xFFFFU - (0xFFFFU % (mps)))
+
+/* Configuration descriptor header */
+#define DCDC_CFG_DESC_HEADER(type)                                              \
+  0x09,                           /* bLength: Configuration Descriptor size */ \
+  (type),                         /* bDescriptorType: Configuration */         \
+  LOBYTE(USB_DCDC_CONFIG_DESC_SIZ), /* wTotalLength:no of returned bytes */    \
+  HIBYTE(USB_DCDC_CONFIG_DESC_SIZ),                                            \
+  (uint8_t)DCDC_NUM_INTERFACES,   /* bNumInterfaces: ports, vendor and NCM */  \
+  0x01,                           /* bConfigurationValue: Configuration value */ \
+  0x00,                           /* iConfiguration: Index of string descriptor */ \
+  0xC0,                           /* bmAttributes: self powered */             \
+  0x32                            /* MaxPower 100 mA */
+
+/* IAD + CDC ACM interface pair of one port */
+#define DCDC_FUNC_DESC(port, mps, binterval)                                    \
+  /* IAD */                                                                     \
+  0x08,                           /* bLength */                                \
+  USB_DESC_TYPE_IAD,              /* bDescriptorType */                        \
+  (uint8_t)(2U * (port)),         /* bFirstInterface */                        \
+  0x02,                           /* bInterfaceCount */                        \
+  0x02,                           /* bFunctionClass: CDC */                    \
+  0x02,                           /* bFunctionSubClass - Abstract Control Model */ \
+  0x01,                           /* bFunctionProtocol - Common AT commands */ \
+  0x02,                           /* iFunction */                              \
+  /* Interface Descriptor */                                                    \
+  0x09,                           /* bLength: Interface Descriptor size */     \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: Interface */             \
+  (uint8_t)(2U * (port)),         /* bInterfaceNumber: Number of Interface */  \
+  0x00,                           /* bAlternateSetting: Alternate setting */   \
+  0x01,                           /* bNumEndpoints: One endpoints used */      \
+  0x02,                           /* bInterfaceClass: Communication Interface Class */ \
+  0x02,                           /* bInterfaceSubClass: Abstract Control Model */ \
+  0x01,                           /* bInterfaceProtocol: Common AT commands */ \
+  0x00,                           /* iInterface: */                            \
+  /* Header Functional Descriptor */                                            \
+  0x05,                           /* bLength: Endpoint Descriptor size */      \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x00,                           /* bDescriptorSubtype: Header Func Desc */   \
+  0x10,                           /* bcdCDC: spec release number */            \
+  0x01,                                                                         \
+  /* Call Management Functional Descriptor */                                   \
+  0x05,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x01,                           /* bDescriptorSubtype: Call Management Func Desc */ \
+  0x00,                           /* bmCapabilities: D0+D1 */                  \
+  (uint8_t)(2U * (port) + 1U),    /* bDataInterface */                         \
+  /* ACM Functional Descriptor */                                               \
+  0x04,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x02,                           /* bDescriptorSubtype: Abstract Control Management desc */ \
+  0x02,                           /* bmCapabilities */                         \
+  /* Union Functional Descriptor */                                             \
+  0x05,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x06,                           /* bDescriptorSubtype: Union func desc */    \
+  (uint8_t)(2U * (port)),         /* bMasterInterface: Communication class interface */ \
+  (uint8_t)(2U * (port) + 1U),    /* bSlaveInterface0: Data Class Interface */ \
+  /* Notification Endpoint Descriptor */                                        \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_CMD_EP(port),              /* bEndpointAddress */                       \
+  0x03,                           /* bmAttributes: Interrupt */                \
+  LOBYTE(DCDC_CMD_PACKET_SIZE),   /* wMaxPacketSize: */                        \
+  HIBYTE(DCDC_CMD_PACKET_SIZE),                                                 \
+  (binterval),                    /* bInterval: */                             \
+  /* Data class interface descriptor */                                         \
+  0x09,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: */                       \
+  (uint8_t)(2U * (port) + 1U),    /* bInterfaceNumber: Number of Interface */  \
+  0x00,                           /* bAlternateSetting: Alternate setting */   \
+  0x02,                           /* bNumEndpoints: Two endpoints used */      \
+  0x0A,                           /* bInterfaceClass: CDC */                   \
+  0x00,                           /* bInterfaceSubClass: */                    \
+  0x00,                           /* bInterfaceProtocol: */                    \
+  0x00,                           /* iInterface: */                            \
+  /* Endpoint OUT Descriptor */                                                 \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_OUT_EP(port),              /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00,                           /* bInterval: ignore for Bulk transfer */    \
+  /* Endpoint IN Descriptor */                                                  \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_IN_EP(port),               /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00                            /* bInterval: ignore for Bulk transfer */
+
+/* One DCDC_FUNC_DESC per port */
+#if (DCDC_NUM_PORTS == 1U)
+#define DCDC_FUNC_DESCS(mps, binterval)                                         \
+  DCDC_FUNC_DESC(0U, mps, binterval)
+#elif (DCDC_NUM_PORTS == 2U)
+#define DCDC_FUNC_DESCS(mps, binterval)                                         \
+  DCDC_FUNC_DESC(0U, mps, binterval),                                           \
+  DCDC_FUNC_DESC(1U, mps, binterval)
+#else
+#define DCDC_FUNC_DESCS(mps, binterval)                                         \
+  DCDC_FUNC_DESC(0U, mps, binterval),                                           \
+  DCDC_FUNC_DESC(1U, mps, binterval),                                           \
+  DCDC_FUNC_DESC(2U, mps, binterval)
+#endif
+
+/* Vendor class bulk function, appended after the ports */
+#if (DCDC_VENDOR_ENABLE != 0U)
+#define DCDC_VENDOR_DESCS(mps)                                                  \
+  ,                                                                             \
+  0x09,                           /* bLength: Interface Descriptor size */     \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: Interface */             \
+  (uint8_t)(2U * DCDC_NUM_PORTS), /* bInterfaceNumber */                       \
+  0x00,                           /* bAlternateSetting */                      \
+  0x02,                           /* bNumEndpoints */                          \
+  0xFF,                           /* bInterfaceClass: Vendor specific */       \
+  0x00,                           /* bInterfaceSubClass */                     \
+  0x00,                           /* bInterfaceProtocol */                     \
+  0x00,                           /* iInterface */                             \
+  /* Endpoint OUT Descriptor */                                                 \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_VENDOR_OUT_EP,             /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00,                           /* bInterval: ignore for Bulk transfer */    \
+  /* Endpoint IN Descriptor */                                                  \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_VENDOR_IN_EP,              /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00                            /* bInterval: ignore for Bulk transfer */
+#else
+#define DCDC_VENDOR_DESCS(mps)
+#endif
+
+/* IAD + CDC-NCM interface pair, appended after the vendor function */
+#if (DCDC_NCM_ENABLE != 0U)
+#define DCDC_NCM_DESCS(mps, binterval)                                          \
+  ,                                                                             \
+  /* IAD */                                                                     \
+  0x08,                           /* bLength */                                \
+  USB_DESC_TYPE_IAD,              /* bDescriptorType */                        \
+  (uint8_t)DCDC_NCM_ITF,          /* bFirstInterface */                        \
+  0x02,                           /* bInterfaceCount */                        \
+  0x02,                           /* bFunctionClass: CDC */                    \
+  0x0D,                           /* bFunctionSubClass: Network Control Model */ \
+  0x00,                           /* bFunctionProtocol: none */                \
+  0x00,                           /* iFunction */                              \
+  /* Communication Interface Descriptor */                                      \
+  0x09,                           /* bLength: Interface Descriptor size */     \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: Interface */             \
+  (uint8_t)DCDC_NCM_ITF,          /* bInterfaceNumber */                       \
+  0x00,                           /* bAlternateSetting */                      \
+  0x01,                           /* bNumEndpoints */                          \
+  0x02,                           /* bInterfaceClass: Communication Interface Class */ \
+  0x0D,                           /* bInterfaceSubClass: Network Control Model */ \
+  0x00,                           /* bInterfaceProtocol: none */               \
+  0x00,                           /* iInterface */                             \
+  /* Header Functional Descriptor */                                            \
+  0x05,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x00,                           /* bDescriptorSubtype: Header Func Desc */   \
+  0x10,                           /* bcdCDC: spec release number */            \
+  0x01,                                                                         \
+  /* Union Functional Descriptor */                                             \
+  0x05,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x06,                           /* bDescriptorSubtype: Union func desc */    \
+  (uint8_t)DCDC_NCM_ITF,          /* bMasterInterface */                       \
+  (uint8_t)(DCDC_NCM_ITF + 1U),   /* bSlaveInterface0 */                       \
+  /* Ethernet Networking Functional Descriptor */                               \
+  0x0D,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x0F,                           /* bDescriptorSubtype: Ethernet Networking */ \
+  DCDC_NCM_MAC_STR_IDX,           /* iMACAddress */                            \
+  0x00,                           /* bmEthernetStatistics: none */             \
+  0x00,                                                                         \
+  0x00,                                                                         \
+  0x00,                                                                         \
+  LOBYTE(DCDC_NCM_MAX_SEGMENT_SIZE), /* wMaxSegmentSize */                     \
+  HIBYTE(DCDC_NCM_MAX_SEGMENT_SIZE),                                            \
+  0x00,                           /* wNumberMCFilters */                       \
+  0x00,                                                                         \
+  0x00,                           /* bNumberPowerFilters */                    \
+  /* NCM Functional Descriptor */                                               \
+  0x06,                           /* bFunctionLength */                        \
+  0x24,                           /* bDescriptorType: CS_INTERFACE */          \
+  0x1A,                           /* bDescriptorSubtype: NCM */                \
+  0x00,                           /* bcdNcmVersion: 1.00 */                    \
+  0x01,                                                                         \
+  0x00,                           /* bmNetworkCapabilities */                  \
+  /* Notification Endpoint Descriptor */                                        \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_NCM_CMD_EP,                /* bEndpointAddress */                       \
+  0x03,                           /* bmAttributes: Interrupt */                \
+  LOBYTE(DCDC_CMD_PACKET_SIZE),   /* wMaxPacketSize: */                        \
+  HIBYTE(DCDC_CMD_PACKET_SIZE),                                                 \
+  (binterval),                    /* bInterval: */                             \
+  /* Data Interface Descriptor, alternate setting 0: no endpoints */            \
+  0x09,                           /* bLength: Interface Descriptor size */     \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: Interface */             \
+  (uint8_t)(DCDC_NCM_ITF + 1U),   /* bInterfaceNumber */                       \
+  0x00,                           /* bAlternateSetting */                      \
+  0x00,                           /* bNumEndpoints */                          \
+  0x0A,                           /* bInterfaceClass: CDC Data */              \
+  0x00,                           /* bInterfaceSubClass */                     \
+  0x01,                           /* bInterfaceProtocol: NTB */                \
+  0x00,                           /* iInterface */                             \
+  /* Data Interface Descriptor, alternate setting 1: bulk pair */               \
+  0x09,                           /* bLength: Interface Descriptor size */     \
+  USB_DESC_TYPE_INTERFACE,        /* bDescriptorType: Interface */             \
+  (uint8_t)(DCDC_NCM_ITF + 1U),   /* bInterfaceNumber */                       \
+  0x01,                           /* bAlternateSetting */                      \
+  0x02,                           /* bNumEndpoints */                          \
+  0x0A,                           /* bInterfaceClass: CDC Data */              \
+  0x00,                           /* bInterfaceSubClass */                     \
+  0x01,                           /* bInterfaceProtocol: NTB */                \
+  0x00,                           /* iInterface */                             \
+  /* Endpoint OUT Descriptor */                                                 \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_NCM_OUT_EP,                /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00,                           /* bInterval: ignore for Bulk transfer */    \
+  /* Endpoint IN Descriptor */                                                  \
+  0x07,                           /* bLength: Endpoint Descriptor size */      \
+  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */              \
+  DCDC_NCM_IN_EP,                 /* bEndpointAddress */                       \
+  0x02,                           /* bmAttributes: Bulk */                     \
+  LOBYTE(mps),                    /* wMaxPacketSize: */                        \
+  HIBYTE(mps),                                                                  \
+  0x00                            /* bInterval: ignore for Bulk transfer */
+#else
+#define DCDC_NCM_DESCS(mps, binterval)
+#endif
+
 /**
   * @}
   */
@@ -108,16 +375,57 @@ static uint8_t  USBD_DCDC_DeInit(USBD_HandleTypeDef *pdev,
 static uint8_t  USBD_DCDC_Setup(USBD_HandleTypeDef *pdev,
                                USBD_SetupReqTypedef *req);
 
-static uint8_t  USBD_DCDC_DataIn(USBD_HandleTypeDef *pdev,
-                                uint8_t epnum);
+static uint8_t  USBD_DCDC_EP0_RxReady(USBD_HandleTypeDef *pdev);
+
+static uint8_t  USBD_DCDC_SOF(USBD_HandleTypeDef *pdev);
 
-static uint8_t  USBD_DCDC_DataOut(USBD_HandleTypeDef *pdev,
-                                 uint8_t epnum);
+static void     USBD_DCDC_PortSof(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
 
-static uint8_t  USBD_DCDC_EP0_RxReady(USBD_HandleTypeDef *pdev);
+static uint8_t  USBD_DCDC_RxFlushPort(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static void     USBD_DCDC_RxRingArm(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static void     USBD_DCDC_RxPoolArm(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static void     USBD_DCDC_CutForward(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *src);
+
+static void     USBD_DCDC_TxQueueKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                      uint8_t flush);
+
+static uint32_t USBD_DCDC_TxWriteMsg(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                     const uint8_t *pbuff, uint32_t length);
+
+static uint32_t USBD_DCDC_TxPut(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                const uint8_t *pbuff, uint32_t length, uint8_t whole);
+
+static void     USBD_DCDC_TxPublish(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static void     USBD_DCDC_TxHandoff(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static uint8_t  USBD_DCDC_AtomicClaim(__IO uint32_t *flag);
+
+static uint32_t USBD_DCDC_AtomicAdd(__IO uint32_t *value, uint32_t delta);
+
+static uint32_t USBD_DCDC_AtomicSwap(__IO uint32_t *value, uint32_t swap);
+
+static uint8_t  USBD_DCDC_TxBacklogged(USBD_CDC_HandleTypeDef *cdc);
+
+static uint8_t  USBD_DCDC_TxSchedGrant(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                       uint32_t *len, uint32_t mps);
+
+static void     USBD_DCDC_TxSchedTick(USBD_HandleTypeDef *pdev);
+
+static void     USBD_DCDC_TxSchedResume(USBD_HandleTypeDef *pdev);
+
+static uint8_t  USBD_DCDC_TxVecNext(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static void     USBD_DCDC_NotifyKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc);
+
+static uint8_t  *USBD_DCDC_PortCfgDesc(uint8_t *desc, uint16_t *length);
 
 static uint8_t  *USBD_DCDC_GetFSCfgDesc(uint16_t *length);
 
+#if (DCDC_HS_ENABLE != 0U)
 static uint8_t  *USBD_DCDC_GetHSCfgDesc(uint16_t *length);
 
 static uint8_t  *USBD_DCDC_GetOtherSpeedCfgDesc(uint16_t *length);
@@ -140,6 +448,7 @@ __ALIGN_BEGIN static uint8_t USBD_DCDC_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER
   0x01,
   0x00,
 };
+#endif /* DCDC_HS_ENABLE */
 
 /**
   * @}
@@ -160,496 +469,71 @@ USBD_ClassTypeDef  USBD_DCDC =
   USBD_DCDC_EP0_RxReady,
   USBD_DCDC_DataIn,
   USBD_DCDC_DataOut,
+  USBD_DCDC_SOF,
   NULL,
   NULL,
-  NULL,
+#if (DCDC_HS_ENABLE != 0U)
   USBD_DCDC_GetHSCfgDesc,
   USBD_DCDC_GetFSCfgDesc,
   USBD_DCDC_GetOtherSpeedCfgDesc,
   USBD_DCDC_GetDeviceQualifierDescriptor,
+#else
+  NULL,                 /* The core only asks a high speed device for these */
+  USBD_DCDC_GetFSCfgDesc,
+  NULL,
+  NULL,
+#endif /* DCDC_HS_ENABLE */
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+#if (DCDC_NCM_ENABLE != 0U)
+  USBD_NCM_GetUsrStrDescriptor,
+#else
+  NULL,
+#endif /* DCDC_NCM_ENABLE */
+#endif /* USBD_SUPPORT_USER_STRING_DESC */
 };
 
+#if (DCDC_HS_ENABLE != 0U)
 /* USB DCDC device Configuration Descriptor */
-__ALIGN_BEGIN uint8_t USBD_DCDC_CfgHSDesc[] __ALIGN_END =
+__ALIGN_BEGIN uint8_t USBD_DCDC_CfgHSDesc[USB_DCDC_CONFIG_DESC_SIZ] __ALIGN_END =
 {
-  /*Configuration Descriptor*/
-  0x09,   /* bLength: Configuration Descriptor size */
-  USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
-  USB_DCDC_CONFIG_DESC_SIZ,                /* wTotalLength:no of returned bytes */
-  0x00,
-  0x04,   /* bNumInterfaces: 4 interface */
-  0x01,   /* bConfigurationValue: Configuration value */
-  0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
-  0xC0,   /* bmAttributes: self powered */
-  0x32,   /* MaxPower 0 mA */
-
-  /*---------------------------------------------------------------------------*/
-  /* IAD */
-  0x00,   /* bFirstInterface */
-  0x02,   /* bInterfaceCount */
-  0x02,   /* bFunctionClass: CDC */
-  0x02,   /* bFunctionSubClass - Abstract Control Model */
-  0x01,   /* bFunctionProtocol - Common AT commands */
-  0x02,   /* iFunction */
-
-  /*---------------------------------------------------------------------------*/
-
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bDCDCDC: spec release number */
-  0x01,
-
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  DCDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(DCDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(DCDC_CMD_PACKET_SIZE),
-  DCDC_HS_BINTERVAL,                           /* bInterval: */
-  /*---------------------------------------------------------------------------*/
-
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: CDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_IN_EP,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
-  ,
-  /*---------------------------------------------------------------------------*/
-  /* IAD */
-  0x02,   /* bFirstInterface */
-  0x02,   /* bInterfaceCount */
-  0x02,   /* bFunctionClass: CDC */
-  0x02,   /* bFunctionSubClass - Abstract Control Model */
-  0x01,   /* bFunctionProtocol - Common AT commands */
-  0x02,   /* iFunction */
-
-  /*---------------------------------------------------------------------------*/
-
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x02,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bDCDCDC: spec release number */
-  0x01,
-
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  DCDC_CMD_EP2,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(DCDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(DCDC_CMD_PACKET_SIZE),
-  DCDC_HS_BINTERVAL,                           /* bInterval: */
-  /*---------------------------------------------------------------------------*/
-
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x03,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: CDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_OUT_EP2,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_IN_EP2,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_HS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
-} ;
+  DCDC_CFG_DESC_HEADER(USB_DESC_TYPE_CONFIGURATION),
+  DCDC_FUNC_DESCS(DCDC_DATA_HS_MAX_PACKET_SIZE, DCDC_HS_BINTERVAL)
+  DCDC_VENDOR_DESCS(DCDC_DATA_HS_MAX_PACKET_SIZE)
+  DCDC_NCM_DESCS(DCDC_DATA_HS_MAX_PACKET_SIZE, DCDC_HS_BINTERVAL)
+};
+#endif /* DCDC_HS_ENABLE */
 
 
 /* USB DCDC device Configuration Descriptor */
-__ALIGN_BEGIN uint8_t USBD_DCDC_CfgFSDesc[] __ALIGN_END =
+__ALIGN_BEGIN uint8_t USBD_DCDC_CfgFSDesc[USB_DCDC_CONFIG_DESC_SIZ] __ALIGN_END =
 {
-  /*Configuration Descriptor*/
-  0x09,   /* bLength: Configuration Descriptor size */
-  USB_DESC_TYPE_CONFIGURATION,      /* bDescriptorType: Configuration */
-  0x8D,                /* wTotalLength:no of returned bytes */
-  0x00,
-  0x04,   /* bNumInterfaces: 2 interface */
-  0x01,   /* bConfigurationValue: Configuration value */
-  0x00,   /* iConfiguration: Index of string descriptor describing the configuration */
-  0xC0,   /* bmAttributes: self powered */
-  0x32,   /* MaxPower 0 mA */
-
-  /*---------------------------------------------------------------------------*/
-  /* IAD */
-  0x08,
-  USB_DESC_TYPE_IAD,
-  0x00,   /* bFirstInterface */
-  0x02,   /* bInterfaceCount */
-  0x02,   /* bFunctionClass: CDC */
-  0x02,   /* bFunctionSubClass - Abstract Control Model */
-  0x01,   /* bFunctionProtocol - Common AT commands */
-  0x02,   /* iFunction */
-  /*---------------------------------------------------------------------------*/
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bDCDCDC: spec release number */
-  0x01,
-
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  DCDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(DCDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(DCDC_CMD_PACKET_SIZE),
-  DCDC_FS_BINTERVAL,                           /* bInterval: */
-  /*---------------------------------------------------------------------------*/
-
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: DCDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_IN_EP,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
-  ,
-  /*---------------------------------------------------------------------------*/
-  /* IAD */
-  0x08,
-  USB_DESC_TYPE_IAD,
-  0x02,   /* bFirstInterface */
-  0x02,   /* bInterfaceCount */
-  0x02,   /* bFunctionClass: CDC */
-  0x02,   /* bFunctionSubClass - Abstract Control Model */
-  0x01,   /* bFunctionProtocol - Common AT commands */
-  0x02,   /* iFunction */
-  /*---------------------------------------------------------------------------*/
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x02,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bDCDCDC: spec release number */
-  0x01,
-
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x00,   /* bMasterInterface: Communication class interface */
-  0x01,   /* bSlaveInterface0: Data Class Interface */
-
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,   /* bDescriptorType: Endpoint */
-  DCDC_CMD_EP2,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(DCDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(DCDC_CMD_PACKET_SIZE),
-  DCDC_FS_BINTERVAL,                           /* bInterval: */
-  /*---------------------------------------------------------------------------*/
-
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x03,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: DCDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_OUT_EP2,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_IN_EP2,                         /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  LOBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize: */
-  HIBYTE(DCDC_DATA_FS_MAX_PACKET_SIZE),
-  0x00                               /* bInterval: ignore for Bulk transfer */
-
-
-
-} ;
+  DCDC_CFG_DESC_HEADER(USB_DESC_TYPE_CONFIGURATION),
+  DCDC_FUNC_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE, DCDC_FS_BINTERVAL)
+  DCDC_VENDOR_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE)
+  DCDC_NCM_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE, DCDC_FS_BINTERVAL)
+};
 
+#if (DCDC_HS_ENABLE != 0U)
 __ALIGN_BEGIN uint8_t USBD_DCDC_OtherSpeedCfgDesc[USB_DCDC_CONFIG_DESC_SIZ] __ALIGN_END =
 {
-  0x09,   /* bLength: Configuation Descriptor size */
-  USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION,
-  USB_DCDC_CONFIG_DESC_SIZ,
-  0x00,
-  0x02,   /* bNumInterfaces: 2 interfaces */
-  0x01,   /* bConfigurationValue: */
-  0x04,   /* iConfiguration: */
-  0xC0,   /* bmAttributes: */
-  0x32,   /* MaxPower 100 mA */
-
-  /*Interface Descriptor */
-  0x09,   /* bLength: Interface Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: Interface */
-  /* Interface descriptor type */
-  0x00,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x01,   /* bNumEndpoints: One endpoints used */
-  0x02,   /* bInterfaceClass: Communication Interface Class */
-  0x02,   /* bInterfaceSubClass: Abstract Control Model */
-  0x01,   /* bInterfaceProtocol: Common AT commands */
-  0x00,   /* iInterface: */
-
-  /*Header Functional Descriptor*/
-  0x05,   /* bLength: Endpoint Descriptor size */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x00,   /* bDescriptorSubtype: Header Func Desc */
-  0x10,   /* bDCDCDC: spec release number */
-  0x01,
-
-  /*Call Management Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x01,   /* bDescriptorSubtype: Call Management Func Desc */
-  0x00,   /* bmCapabilities: D0+D1 */
-  0x01,   /* bDataInterface: 1 */
-
-  /*ACM Functional Descriptor*/
-  0x04,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x02,   /* bDescriptorSubtype: Abstract Control Management desc */
-  0x02,   /* bmCapabilities */
-
-  /*Union Functional Descriptor*/
-  0x05,   /* bFunctionLength */
-  0x24,   /* bDescriptorType: CS_INTERFACE */
-  0x06,   /* bDescriptorSubtype: Union func desc */
-  0x02,   /* bMasterInterface: Communication class interface */
-  0x03,   /* bSlaveInterface0: Data Class Interface */
-
-  /*Endpoint 2 Descriptor*/
-  0x07,                           /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,         /* bDescriptorType: Endpoint */
-  DCDC_CMD_EP,                     /* bEndpointAddress */
-  0x03,                           /* bmAttributes: Interrupt */
-  LOBYTE(DCDC_CMD_PACKET_SIZE),     /* wMaxPacketSize: */
-  HIBYTE(DCDC_CMD_PACKET_SIZE),
-  DCDC_FS_BINTERVAL,                           /* bInterval: */
-
-  /*---------------------------------------------------------------------------*/
-
-  /*Data class interface descriptor*/
-  0x09,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_INTERFACE,  /* bDescriptorType: */
-  0x01,   /* bInterfaceNumber: Number of Interface */
-  0x00,   /* bAlternateSetting: Alternate setting */
-  0x02,   /* bNumEndpoints: Two endpoints used */
-  0x0A,   /* bInterfaceClass: DCDC */
-  0x00,   /* bInterfaceSubClass: */
-  0x00,   /* bInterfaceProtocol: */
-  0x00,   /* iInterface: */
-
-  /*Endpoint OUT Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,      /* bDescriptorType: Endpoint */
-  DCDC_OUT_EP,                        /* bEndpointAddress */
-  0x02,                              /* bmAttributes: Bulk */
-  0x40,                              /* wMaxPacketSize: */
-  0x00,
-  0x00,                              /* bInterval: ignore for Bulk transfer */
-
-  /*Endpoint IN Descriptor*/
-  0x07,   /* bLength: Endpoint Descriptor size */
-  USB_DESC_TYPE_ENDPOINT,     /* bDescriptorType: Endpoint */
-  DCDC_IN_EP,                        /* bEndpointAddress */
-  0x02,                             /* bmAttributes: Bulk */
-  0x40,                             /* wMaxPacketSize: */
-  0x00,
-  0x00                              /* bInterval */
+  DCDC_CFG_DESC_HEADER(USB_DESC_TYPE_OTHER_SPEED_CONFIGURATION),
+  DCDC_FUNC_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE, DCDC_FS_BINTERVAL)
+  DCDC_VENDOR_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE)
+  DCDC_NCM_DESCS(DCDC_DATA_FS_MAX_PACKET_SIZE, DCDC_FS_BINTERVAL)
 };
+#endif /* DCDC_HS_ENABLE */
+
+/* Configuration descriptor with fewer ports than DCDC_NUM_PORTS */
+__ALIGN_BEGIN static uint8_t USBD_DCDC_CfgRunDesc[USB_DCDC_CONFIG_DESC_SIZ] __ALIGN_END;
+
+/* Port count the host is shown; kept across re-enumeration */
+static uint8_t DCDC_PortCount = DCDC_NUM_PORTS;
+
+static USBD_DCDC_ReenumTypeDef DCDC_Reenum;
+
+USBD_DCDC_ReenumStatsTypeDef USBD_DCDC_ReenumStats;
+
+USBD_DCDC_IsrStatsTypeDef USBD_DCDC_IsrStats;
 
 /**
   * @}
@@ -669,73 +553,43 @@ __ALIGN_BEGIN uint8_t USBD_DCDC_OtherSpeedCfgDesc[USB_DCDC_CONFIG_DESC_SIZ] __AL
 static uint8_t  USBD_DCDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   uint8_t ret = 0U;
+  uint8_t port;
+  uint8_t ports = DCDC_PortCount;
+  uint16_t mps;
   USBD_DCDC_HandleTypeDef   *hDCDC;
+  USBD_CDC_HandleTypeDef    *cdc;
 
-  if (pdev->dev_speed == USBD_SPEED_HIGH)
-  {
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev, DCDC_IN_EP, USBD_EP_TYPE_BULK,
-                   DCDC_DATA_HS_IN_PACKET_SIZE);
-
-    pdev->ep_in[DCDC_IN_EP & 0xFU].is_used = 1U;
-
-    /* Open EP OUT */
-    USBD_LL_OpenEP(pdev, DCDC_OUT_EP, USBD_EP_TYPE_BULK,
-                   DCDC_DATA_HS_OUT_PACKET_SIZE);
-
-    pdev->ep_out[DCDC_OUT_EP & 0xFU].is_used = 1U;
-
-
-    // CDC 2
-
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev, DCDC_IN_EP2, USBD_EP_TYPE_BULK,
-                 DCDC_DATA_HS_IN_PACKET_SIZE);
-
-    pdev->ep_in[DCDC_IN_EP2 & 0xFU].is_used = 1U;
+  mps = DCDC_DATA_MPS(pdev);
 
-    /* Open EP OUT */
-    USBD_LL_OpenEP(pdev, DCDC_OUT_EP2, USBD_EP_TYPE_BULK,
-                 DCDC_DATA_HS_OUT_PACKET_SIZE);
-
-    pdev->ep_out[DCDC_OUT_EP2 & 0xFU].is_used  = 1U;
-
-  }
-  else
+  for (port = 0U; port < ports; port++)
   {
     /* Open EP IN */
-    USBD_LL_OpenEP(pdev, DCDC_IN_EP, USBD_EP_TYPE_BULK,
-                   DCDC_DATA_FS_IN_PACKET_SIZE);
-
-    pdev->ep_in[DCDC_IN_EP & 0xFU].is_used = 1U;
+    USBD_LL_OpenEP(pdev, DCDC_IN_EP(port), USBD_EP_TYPE_BULK, mps);
+    pdev->ep_in[DCDC_IN_EP(port) & 0xFU].is_used = 1U;
 
     /* Open EP OUT */
-    USBD_LL_OpenEP(pdev, DCDC_OUT_EP, USBD_EP_TYPE_BULK,
-                   DCDC_DATA_FS_OUT_PACKET_SIZE);
-
-    pdev->ep_out[DCDC_OUT_EP & 0xFU].is_used = 1U;
-
-    // CDC 2
-    /* Open EP IN */
-    USBD_LL_OpenEP(pdev, DCDC_IN_EP2, USBD_EP_TYPE_BULK,
-                 DCDC_DATA_FS_IN_PACKET_SIZE);
+    USBD_LL_OpenEP(pdev, DCDC_OUT_EP(port), USBD_EP_TYPE_BULK, mps);
+    pdev->ep_out[DCDC_OUT_EP(port) & 0xFU].is_used = 1U;
 
-    pdev->ep_in[DCDC_IN_EP2 & 0xFU].is_used = 1U;
+    /* Open Command IN EP */
+    USBD_LL_OpenEP(pdev, DCDC_CMD_EP(port), USBD_EP_TYPE_INTR, DCDC_CMD_PACKET_SIZE);
+    pdev->ep_in[DCDC_CMD_EP(port) & 0xFU].is_used = 1U;
+  }
 
-    /* Open EP OUT */
-    USBD_LL_OpenEP(pdev, DCDC_OUT_EP2, USBD_EP_TYPE_BULK,
-                 DCDC_DATA_FS_OUT_PACKET_SIZE);
+#if (DCDC_VENDOR_ENABLE != 0U)
+  /* Open the vendor function bulk pair */
+  USBD_LL_OpenEP(pdev, DCDC_VENDOR_IN_EP, USBD_EP_TYPE_BULK, mps);
+  pdev->ep_in[DCDC_VENDOR_IN_EP & 0xFU].is_used = 1U;
 
-    pdev->ep_out[DCDC_OUT_EP2 & 0xFU].is_used = 1U;
-  }
-  /* Open Command IN EP */
-  USBD_LL_OpenEP(pdev, DCDC_CMD_EP, USBD_EP_TYPE_INTR, DCDC_CMD_PACKET_SIZE);
-  pdev->ep_in[DCDC_CMD_EP & 0xFU].is_used = 1U;
+  USBD_LL_OpenEP(pdev, DCDC_VENDOR_OUT_EP, USBD_EP_TYPE_BULK, mps);
+  pdev->ep_out[DCDC_VENDOR_OUT_EP & 0xFU].is_used = 1U;
+#endif /* DCDC_VENDOR_ENABLE */
 
-  // CDC 2
-  /* Open Command IN EP */
-  USBD_LL_OpenEP(pdev, DCDC_CMD_EP2, USBD_EP_TYPE_INTR, DCDC_CMD_PACKET_SIZE);
-  pdev->ep_in[DCDC_CMD_EP2 & 0xFU].is_used = 1U;
+#if (DCDC_NCM_ENABLE != 0U)
+  /* NCM notification endpoint; the bulk pair opens with data alternate setting 1 */
+  USBD_LL_OpenEP(pdev, DCDC_NCM_CMD_EP, USBD_EP_TYPE_INTR, DCDC_CMD_PACKET_SIZE);
+  pdev->ep_in[DCDC_NCM_CMD_EP & 0xFU].is_used = 1U;
+#endif /* DCDC_NCM_ENABLE */
 
   pdev->pClassData = USBD_malloc(sizeof(USBD_DCDC_HandleTypeDef));
 
@@ -747,44 +601,113 @@ static uint8_t  USBD_DCDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   {
     hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
 
-    /* Init  physical Interface components */
-    // TODO: user handlers for two cdc
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Init(&hDCDC->CDC1);
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Init(&hDCDC->CDC2);
+    /* Build the endpoint number -> port lookup used by DataIn/DataOut */
+    for (port = 0U; port < DCDC_EP_TABLE_SIZE; port++)
+    {
+      hDCDC->EpPort[port] = DCDC_NO_PORT;
+    }
+    hDCDC->Ports = ports;
+    hDCDC->Express = DCDC_NO_PORT;
+    hDCDC->Frame = 0U;
+    hDCDC->TxKick = 0U;
+#if (DCDC_DEFERRED != 0U)
+    /* Events of the previous configuration are dropped with it */
+    hDCDC->Events.Head = 0U;
+    hDCDC->Events.Tail = 0U;
+    hDCDC->Events.PortQueued = 0U;
+#endif /* DCDC_DEFERRED */
+
+    /* A port count switch ends here, once the host configures the layout */
+    if ((DCDC_Reenum.Measuring != 0U) && (DCDC_Reenum.Target == ports))
+    {
+      DCDC_Reenum.Measuring = 0U;
+      USBD_DCDC_ReenumStats.LastMs = USBD_LL_GetTick() - DCDC_Reenum.Start;
+      USBD_DCDC_ReenumStats.MaxMs = MAX(USBD_DCDC_ReenumStats.MaxMs, USBD_DCDC_ReenumStats.LastMs);
+      USBD_DCDC_ReenumStats.Switches++;
+      USBD_DCDC_ProcessCallback(pdev);
+    }
 
-    /* Init Xfer states */
-    hDCDC->CDC1.TxState = 0U;
-    hDCDC->CDC1.RxState = 0U;
+    for (port = 0U; port < DCDC_NUM_PIPES; port++)
+    {
+      cdc = &hDCDC->CDC[port];
 
-    hDCDC->CDC2.TxState = 0U;
-    hDCDC->CDC2.RxState = 0U;
+      cdc->Port  = port;
+      cdc->Itf   = (uint8_t)(2U * MIN(port, ports));
 
+      if (port < DCDC_NUM_PORTS)
+      {
+        cdc->InEp  = DCDC_IN_EP(port);
+        cdc->OutEp = DCDC_OUT_EP(port);
+        cdc->CmdEp = DCDC_CMD_EP(port);
+      }
+#if (DCDC_NCM_ENABLE != 0U)
+      else if (port == DCDC_NCM_PORT)
+      {
+        cdc->Itf   = (uint8_t)((2U * ports) + DCDC_VENDOR_ENABLE);
+        cdc->InEp  = DCDC_NCM_IN_EP;
+        cdc->OutEp = DCDC_NCM_OUT_EP;
+        cdc->CmdEp = DCDC_NCM_CMD_EP;
+      }
+#endif /* DCDC_NCM_ENABLE */
+      else
+      {
+        /* No notification endpoint: CmdEp 0 keeps the Notify API off */
+        cdc->InEp  = DCDC_VENDOR_IN_EP;
+        cdc->OutEp = DCDC_VENDOR_OUT_EP;
+        cdc->CmdEp = 0U;
+      }
+      cdc->CmdOpCode = 0xFFU;
+      cdc->RxXferSize = mps;
+      cdc->MsgMode = 0U;
+      cdc->RxRing.Buf = NULL;
+      cdc->RxPool.Buf = NULL;
+      cdc->Cut.Peer = DCDC_NO_PORT;
+      cdc->Cut.Src = DCDC_NO_PORT;
+      cdc->Cut.Held = 0U;
+      cdc->Cut.InFlight = 0U;
+      cdc->Cut.Forwarded = 0U;
+      cdc->Cut.Waits = 0U;
+      cdc->TxQueue.Buf = NULL;
+      cdc->TxVec.Iov = NULL;
+      cdc->Notify.Busy = 0U;
+      cdc->Notify.Pending = 0U;
+      cdc->Notify.SerialState = 0U;
+      cdc->Notify.Sent = 0U;
+      cdc->Notify.Coalesced = 0U;
+
+      /* Port left out of this configuration: endpoints closed, no callbacks */
+      if ((port < DCDC_NUM_PORTS) && (port >= ports))
+      {
+        cdc->Itf = 0xFFU;
+        continue;
+      }
 
-    if (pdev->dev_speed == USBD_SPEED_HIGH)
-    {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP, hDCDC->CDC1.RxBuffer,
-                             DCDC_DATA_HS_OUT_PACKET_SIZE);
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP, hDCDC->CDC1.RxBuffer,
-                               DCDC_DATA_HS_OUT_PACKET_SIZE);
+      hDCDC->EpPort[cdc->InEp & 0xFU] = port;
+      hDCDC->EpPort[cdc->OutEp & 0xFU] = port;
+      if (cdc->CmdEp != 0U)
+      {
+        hDCDC->EpPort[cdc->CmdEp & 0xFU] = port;
+      }
 
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP2, hDCDC->CDC2.RxBuffer,
-                             DCDC_DATA_HS_OUT_PACKET_SIZE);
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP2, hDCDC->CDC2.RxBuffer,
-                               DCDC_DATA_HS_OUT_PACKET_SIZE);
-    }
-    else
-    {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP, hDCDC->CDC1.RxBuffer,
-                             DCDC_DATA_FS_OUT_PACKET_SIZE);
+      /* Init Xfer states */
+      cdc->TxState = 0U;
+      cdc->RxState = 0U;
+
+#if (DCDC_NCM_ENABLE != 0U)
+      if (port == DCDC_NCM_PORT)
+      {
+        /* The NCM function owns its buffers and arms OUT on SET_INTERFACE */
+        (void)USBD_NCM_Init(pdev, cdc);
+        ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Init(cdc);
+        continue;
+      }
+#endif /* DCDC_NCM_ENABLE */
+
+      /* Init  physical Interface components */
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Init(cdc);
 
       /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev, DCDC_OUT_EP2, hDCDC->CDC2.RxBuffer,
-                             DCDC_DATA_FS_OUT_PACKET_SIZE);
+      (void)USBD_DCDC_ReceivePacket(pdev, cdc);
     }
   }
   return ret;
@@ -800,39 +723,55 @@ static uint8_t  USBD_DCDC_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 static uint8_t  USBD_DCDC_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
 {
   uint8_t ret = 0U;
+  uint8_t port;
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    /* Close EP IN */
+    USBD_LL_CloseEP(pdev, DCDC_IN_EP(port));
+    pdev->ep_in[DCDC_IN_EP(port) & 0xFU].is_used = 0U;
+
+    /* Close EP OUT */
+    USBD_LL_CloseEP(pdev, DCDC_OUT_EP(port));
+    pdev->ep_out[DCDC_OUT_EP(port) & 0xFU].is_used = 0U;
 
-  /* Close EP IN */
-  USBD_LL_CloseEP(pdev, DCDC_IN_EP);
-  pdev->ep_in[DCDC_IN_EP & 0xFU].is_used = 0U;
+    /* Close Command IN EP */
+    USBD_LL_CloseEP(pdev, DCDC_CMD_EP(port));
+    pdev->ep_in[DCDC_CMD_EP(port) & 0xFU].is_used = 0U;
+  }
 
-  /* Close EP OUT */
-  USBD_LL_CloseEP(pdev, DCDC_OUT_EP);
-  pdev->ep_out[DCDC_OUT_EP & 0xFU].is_used = 0U;
+#if (DCDC_VENDOR_ENABLE != 0U)
+  USBD_LL_CloseEP(pdev, DCDC_VENDOR_IN_EP);
+  pdev->ep_in[DCDC_VENDOR_IN_EP & 0xFU].is_used = 0U;
 
-  /* Close Command IN EP */
-  USBD_LL_CloseEP(pdev, DCDC_CMD_EP);
-  pdev->ep_in[DCDC_CMD_EP & 0xFU].is_used = 0U;
+  USBD_LL_CloseEP(pdev, DCDC_VENDOR_OUT_EP);
+  pdev->ep_out[DCDC_VENDOR_OUT_EP & 0xFU].is_used = 0U;
+#endif /* DCDC_VENDOR_ENABLE */
 
-  /* Close EP IN */
-  USBD_LL_CloseEP(pdev, DCDC_IN_EP2);
-  pdev->ep_in[DCDC_IN_EP2 & 0xFU].is_used = 0U;
+#if (DCDC_NCM_ENABLE != 0U)
+  USBD_LL_CloseEP(pdev, DCDC_NCM_IN_EP);
+  pdev->ep_in[DCDC_NCM_IN_EP & 0xFU].is_used = 0U;
 
-  /* Close EP OUT */
-  USBD_LL_CloseEP(pdev, DCDC_OUT_EP2);
-  pdev->ep_out[DCDC_OUT_EP2 & 0xFU].is_used = 0U;
+  USBD_LL_CloseEP(pdev, DCDC_NCM_OUT_EP);
+  pdev->ep_out[DCDC_NCM_OUT_EP & 0xFU].is_used = 0U;
 
-  /* Close Command IN EP */
-  USBD_LL_CloseEP(pdev, DCDC_CMD_EP2);
-  pdev->ep_in[DCDC_CMD_EP2 & 0xFU].is_used = 0U;
+  USBD_LL_CloseEP(pdev, DCDC_NCM_CMD_EP);
+  pdev->ep_in[DCDC_NCM_CMD_EP & 0xFU].is_used = 0U;
+#endif /* DCDC_NCM_ENABLE */
 
   /* DeInit  physical Interface components */
   if (pdev->pClassData != NULL)
   {
-
-    // TODO....
     USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->DeInit(&hDCDC->CDC1);
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->DeInit(&hDCDC->CDC2);
+
+    for (port = 0U; port < DCDC_NUM_PIPES; port++)
+    {
+      if ((port < DCDC_NUM_PORTS) && (port >= hDCDC->Ports))
+      {
+        continue;
+      }
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->DeInit(&hDCDC->CDC[port]);
+    }
     USBD_free(pdev->pClassData);
     pdev->pClassData = NULL;
   }
@@ -851,41 +790,58 @@ static uint8_t  USBD_DCDC_Setup(USBD_HandleTypeDef *pdev,
                                USBD_SetupReqTypedef *req)
 {
   USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  USBD_CDC_HandleTypeDef    *cdc;
   uint8_t ifalt = 0U;
   uint16_t status_info = 0U;
+  uint16_t len;
+  uint8_t port;
   uint8_t ret = USBD_OK;
 
+#if (DCDC_NCM_ENABLE != 0U)
+  /* The NCM function handles its interfaces, alternate settings included */
+  if (((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE) &&
+      (hDCDC != NULL) && (LOBYTE(req->wIndex) >= hDCDC->CDC[DCDC_NCM_PORT].Itf))
+  {
+    return USBD_NCM_Setup(pdev, &hDCDC->CDC[DCDC_NCM_PORT], req);
+  }
+#endif /* DCDC_NCM_ENABLE */
 
   switch (req->bmRequest & USB_REQ_TYPE_MASK)
   {
     case USB_REQ_TYPE_CLASS :
+      /* Interfaces 2n and 2n+1 belong to port n */
+      port = (uint8_t)(LOBYTE(req->wIndex) >> 1);
+
+      if ((hDCDC == NULL) || (port >= hDCDC->Ports))
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+        break;
+      }
+
+      cdc = &hDCDC->CDC[port];
+      len = MIN(req->wLength, (uint16_t)sizeof(cdc->data));
+
       if (req->wLength)
       {
         if (req->bmRequest & 0x80U)
         {
-          if(req->wValue == 0 || req->wValue == 2) {
-            USBD_CDC_HandleTypeDef *cdc = req->wValue>>1?&hDCDC->CDC2:&hDCDC->CDC1;
-            ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Control(cdc, req->bRequest,
-                                                              (uint8_t *)(void *)cdc->data,
-                                                              req->wLength);
+          ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Control(cdc, req->bRequest,
+                                                            (uint8_t *)(void *)cdc->data,
+                                                            len);
 
-            USBD_CtlSendData(pdev, (uint8_t *)(void *)cdc->data, req->wLength);
-          }
+          USBD_CtlSendData(pdev, (uint8_t *)(void *)cdc->data, len);
         }
         else
         {
-          if(req->wValue == 0 || req->wValue == 2) {
-            USBD_CDC_HandleTypeDef *cdc = req->wValue>>1?&hDCDC->CDC2:&hDCDC->CDC1;
-            cdc->CmdOpCode = req->bRequest;
-            cdc->CmdLength = (uint8_t)req->wLength;
+          cdc->CmdOpCode = req->bRequest;
+          cdc->CmdLength = (uint8_t)len;
 
-            USBD_CtlPrepareRx(pdev, (uint8_t *)(void *)cdc->data, req->wLength);
-          }
+          USBD_CtlPrepareRx(pdev, (uint8_t *)(void *)cdc->data, len);
         }
       }
       else
       {
-        USBD_CDC_HandleTypeDef *cdc = req->wValue>>1?&hDCDC->CDC2:&hDCDC->CDC1;
         ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Control(cdc, req->bRequest,
                                                           (uint8_t *)(void *)req, 0U);
       }
@@ -933,6 +889,55 @@ static uint8_t  USBD_DCDC_Setup(USBD_HandleTypeDef *pdev,
       }
       break;
 
+    case USB_REQ_TYPE_VENDOR:
+      /* Device requests only; answered in any device state */
+      if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) != USB_REQ_RECIPIENT_DEVICE)
+      {
+        USBD_CtlError(pdev, req);
+        ret = USBD_FAIL;
+        break;
+      }
+
+      switch (req->bRequest)
+      {
+        case DCDC_REQ_SET_PORT_COUNT:
+          if ((req->wLength != 0U) || (req->wValue > 0xFFU) ||
+              (USBD_DCDC_SetPortCount(pdev, (uint8_t)req->wValue) != USBD_OK))
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          else
+          {
+            USBD_CtlSendStatus(pdev);
+          }
+          break;
+
+        case DCDC_REQ_GET_PORT_COUNT:
+          if (((req->bmRequest & 0x80U) == 0U) || (req->wLength == 0U))
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          else
+          {
+            ifalt = DCDC_PortCount;
+            USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          break;
+
+        case DCDC_REQ_READ_REGS:
+        case DCDC_REQ_WRITE_REGS:
+          ret = USBD_DCDC_RegSetup(pdev, req);
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
     default:
       USBD_CtlError(pdev, req);
       ret = USBD_FAIL;
@@ -944,35 +949,148 @@ static uint8_t  USBD_DCDC_Setup(USBD_HandleTypeDef *pdev,
 
 /**
   * @brief  USBD_DCDC_DataIn
-  *         Data sent on non-control IN endpoint
+  *         Data sent on non-control IN endpoint. Also called straight from
+  *         the PCD callback of a configured device, bypassing the core, or
+  *         from USBD_DCDC_EventRun with DCDC_DEFERRED.
   * @param  pdev: device instance
   * @param  epnum: endpoint number
   * @retval status
   */
-static uint8_t  USBD_DCDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+uint8_t  USBD_DCDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
   PCD_HandleTypeDef *hpcd = pdev->pData;
+  USBD_CDC_HandleTypeDef *cdc;
+  USBD_DCDC_TxQueueTypeDef *q;
+  uint32_t mps;
+  uint8_t port;
 
   if (pdev->pClassData != NULL)
   {
-    if ((pdev->ep_in[epnum].total_length > 0U) && ((pdev->ep_in[epnum].total_length % hpcd->IN_ep[epnum].maxpacket) == 0U))
+    port = hDCDC->EpPort[epnum & 0xFU];
+
+    if (port == DCDC_NO_PORT)
+    {
+      return USBD_FAIL;
+    }
+
+    cdc = &hDCDC->CDC[port];
+    q = &cdc->TxQueue;
+
+    if ((epnum | 0x80U) == cdc->CmdEp)
+    {
+      /* Notification sent: post what was coalesced meanwhile */
+      cdc->Notify.Busy = 0U;
+      USBD_DCDC_NotifyKick(pdev, cdc);
+      return USBD_OK;
+    }
+    mps = hpcd->IN_ep[epnum].maxpacket;
+
+    if (cdc->Cut.InFlight != 0U)
+    {
+      /* Forwarded packet sent: queued data goes first, then the next
+         packet held by the source port */
+      cdc->Cut.InFlight = 0U;
+      cdc->TxState = 0U;
+
+      if (q->Buf != NULL)
+      {
+        USBD_DCDC_TxQueueKick(pdev, cdc, 0U);
+      }
+      if (cdc->Cut.Src != DCDC_NO_PORT)
+      {
+        USBD_DCDC_CutForward(pdev, &hDCDC->CDC[cdc->Cut.Src]);
+      }
+      return USBD_OK;
+    }
+
+    if (cdc->TxVec.Iov != NULL)
+    {
+      if (USBD_DCDC_TxVecNext(pdev, cdc) != 0U)
+      {
+        return USBD_OK;
+      }
+
+      /* Chain sent: report it as a whole, ZLP handling as for one transfer */
+      cdc->TxVec.Iov = NULL;
+      cdc->TxBuffer = NULL;
+      cdc->TxLength = cdc->TxVec.Total;
+    }
+
+    if (q->InFlight != 0U)
+    {
+      /* Retire the transfer from the TX queue */
+      q->Tail += q->InFlight;
+      q->Bytes += q->InFlight;
+      q->Packets += (q->InFlight + mps - 1U) / mps;
+      q->InFlight = 0U;
+
+      /* A message still needs its ZLP below */
+      if ((q->Head != q->Tail) && (cdc->MsgMode == 0U))
+      {
+        uint8_t *done_buf = cdc->TxBuffer;
+        uint32_t done_len = cdc->TxLength;
+
+        /* More data queued: chain the next transfer, no ZLP needed */
+        pdev->ep_in[epnum].total_length = 0U;
+        cdc->TxState = 0U;
+        USBD_DCDC_TxQueueKick(pdev, cdc, 0U);
+
+        /* Queue space was freed even though the endpoint stays busy */
+        if (((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt != NULL)
+        {
+          ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt(cdc, done_buf, &done_len);
+        }
+        return USBD_OK;
+      }
+    }
+
+    if ((pdev->ep_in[epnum].total_length > 0U) && ((pdev->ep_in[epnum].total_length % mps) == 0U))
     {
       /* Update the packet total length */
       pdev->ep_in[epnum].total_length = 0U;
 
+      if (q->Buf != NULL)
+      {
+        q->Packets++;
+      }
+
       /* Send ZLP */
       USBD_LL_Transmit(pdev, epnum, NULL, 0U);
     }
     else
     {
-      //if(epnum == DCDC_IN_EP & EP_ADDR_MSK)
-      if(epnum == (DCDC_IN_EP & 0xFU))
-        hDCDC->CDC1.TxState = 0U;
-      //if(epnum == DCDC_IN_EP2 & EP_ADDR_MSK)
-      if(epnum == (DCDC_IN_EP2 & 0xFU))
-        hDCDC->CDC2.TxState = 0U;
-      
+      cdc->TxState = 0U;
+
+      if (((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt != NULL)
+      {
+        ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->TransmitCplt(cdc, cdc->TxBuffer, &cdc->TxLength);
+      }
+
+      /* Data queued while the ZLP or a plain transfer was in flight */
+      if (q->Buf != NULL)
+      {
+        USBD_DCDC_TxQueueKick(pdev, cdc, 0U);
+
+        /* Express port drained: release the ports it held back */
+        if ((port == hDCDC->Express) && (cdc->TxState == 0U))
+        {
+          USBD_DCDC_TxSchedResume(pdev);
+        }
+      }
+
+      /* Endpoint still idle: take a packet held for cut-through */
+      if (cdc->Cut.Src != DCDC_NO_PORT)
+      {
+        USBD_DCDC_CutForward(pdev, &hDCDC->CDC[cdc->Cut.Src]);
+      }
+#if (DCDC_NCM_ENABLE != 0U)
+      else if (port == DCDC_NCM_PORT)
+      {
+        /* Datagrams gathered during the transfer leave as the next NTB */
+        USBD_NCM_TxKick(pdev, cdc);
+      }
+#endif /* DCDC_NCM_ENABLE */
     }
     return USBD_OK;
   }
@@ -984,27 +1102,108 @@ static uint8_t  USBD_DCDC_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 
 /**
   * @brief  USBD_DCDC_DataOut
-  *         Data received on non-control Out endpoint
+  *         Data received on non-control Out endpoint. Also called straight
+  *         from the PCD callback of a configured device, bypassing the core,
+  *         or from USBD_DCDC_EventRun with DCDC_DEFERRED.
   * @param  pdev: device instance
   * @param  epnum: endpoint number
   * @retval status
   */
-static uint8_t  USBD_DCDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+uint8_t  USBD_DCDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
   USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  USBD_CDC_HandleTypeDef    *cdc;
+  uint8_t port;
 
-  /* Get the received data length */
-  uint32_t rxSize = USBD_LL_GetRxDataSize(pdev, epnum);
-  
   /* USB data will be immediately processed, this allow next USB traffic being
   NAKed till the end of the application Xfer */
   if (pdev->pClassData != NULL)
   {
-      USBD_CDC_HandleTypeDef *cdc = &hDCDC->CDC1;
-    if(epnum == DCDC_OUT_EP2)
-        cdc = &hDCDC->CDC2;
-    cdc->RxLength = rxSize;
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Receive(cdc, cdc->RxBuffer, &cdc->RxLength);
+    port = hDCDC->EpPort[epnum & 0xFU];
+
+    if (port == DCDC_NO_PORT)
+    {
+      return USBD_FAIL;
+    }
+
+    cdc = &hDCDC->CDC[port];
+    cdc->RxState = 0U;
+
+    /* Get the received data length */
+    cdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
+
+    if (cdc->Cut.Peer != DCDC_NO_PORT)
+    {
+      /* The packet stays in the OUT PMA buffer until the peer IN endpoint
+         is free; the host is NAKed meanwhile */
+      cdc->Cut.Held = 1U;
+
+      if (hDCDC->CDC[cdc->Cut.Peer].TxState != 0U)
+      {
+        cdc->Cut.Waits++;
+      }
+      USBD_DCDC_CutForward(pdev, cdc);
+    }
+    else if (cdc->RxRing.Buf != NULL)
+    {
+      USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+      uint32_t slot = ring->Head & (DCDC_RX_SLOTS - 1U);
+      uint8_t *buf = cdc->RxBuffer;
+
+      if (cdc->MsgMode != 0U)
+      {
+        if (cdc->RxLength == cdc->RxXferSize)
+        {
+          /* Slot full without a short packet: the message is the slot
+             size or longer, drop it up to the short packet or ZLP that
+             terminates it */
+          if (ring->Discard == 0U)
+          {
+            ring->Discard = 1U;
+            ring->Dropped++;
+          }
+          (void)USBD_DCDC_ReceivePacket(pdev, cdc);
+          return USBD_OK;
+        }
+
+        if (ring->Discard != 0U)
+        {
+          /* Tail of the dropped message, reuse the slot */
+          ring->Discard = 0U;
+          (void)USBD_DCDC_ReceivePacket(pdev, cdc);
+          return USBD_OK;
+        }
+      }
+
+      /* Commit the slot and re-arm into the next free one first, so the
+         host is not NAKed while the application looks at the data; it
+         drains with RxPeek/RxRelease */
+      ring->Len[slot] = cdc->RxLength;
+      ring->Head++;
+
+      USBD_DCDC_RxRingArm(pdev, cdc);
+
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Receive(cdc, buf, &ring->Len[slot]);
+    }
+    else if (cdc->RxPool.Buf != NULL)
+    {
+      USBD_DCDC_RxPoolTypeDef *pool = &cdc->RxPool;
+      uint8_t *buf = cdc->RxBuffer;
+      uint32_t idx = pool->Armed;
+
+      /* Re-arm from the pool first, then lend the filled buffer out; the
+         application hands it back with USBD_DCDC_RxReturn */
+      pool->Len[idx] = cdc->RxLength;
+      pool->Loans++;
+
+      USBD_DCDC_RxPoolArm(pdev, cdc);
+
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Receive(cdc, buf, &pool->Len[idx]);
+    }
+    else
+    {
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Receive(cdc, cdc->RxBuffer, &cdc->RxLength);
+    }
 
     return USBD_OK;
   }
@@ -1023,150 +1222,1812 @@ static uint8_t  USBD_DCDC_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t  USBD_DCDC_EP0_RxReady(USBD_HandleTypeDef *pdev)
 {
   USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  USBD_CDC_HandleTypeDef    *cdc;
+  uint8_t port;
+
+  /* Vendor register writes, if that was the data stage */
+  USBD_DCDC_RegRxReady(pdev);
+
+  if ((pdev->pUserData == NULL) || (hDCDC == NULL))
+  {
+    return USBD_OK;
+  }
 
-  if ((pdev->pUserData != NULL) && (hDCDC->CDC1.CmdOpCode != 0xFFU))
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
   {
-    ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Control(&hDCDC->CDC1, hDCDC->CDC1.CmdOpCode,
-                                                      (uint8_t *)(void *)hDCDC->CDC1.data,
-                                                      (uint16_t)hDCDC->CDC1.CmdLength);
-    hDCDC->CDC1.CmdOpCode = 0xFFU;
+    cdc = &hDCDC->CDC[port];
+
+    if (cdc->CmdOpCode != 0xFFU)
+    {
+      ((USBD_DCDC_ItfTypeDef *)pdev->pUserData)->Control(cdc, cdc->CmdOpCode,
+                                                        (uint8_t *)(void *)cdc->data,
+                                                        (uint16_t)cdc->CmdLength);
+      cdc->CmdOpCode = 0xFFU;
+    }
+  }
 
+#if (DCDC_NCM_ENABLE != 0U)
+  if (hDCDC->CDC[DCDC_NCM_PORT].CmdOpCode != 0xFFU)
+  {
+    USBD_NCM_EP0_RxReady(pdev, &hDCDC->CDC[DCDC_NCM_PORT]);
   }
+#endif /* DCDC_NCM_ENABLE */
   return USBD_OK;
 }
 
 /**
-  * @brief  USBD_DCDC_GetFSCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_DCDC_SOF
+  *         Refill the IN scheduler credits, flush partial IN packets that
+  *         reached their latency budget, and detect the pipes with frame
+  *         driven work (USBD_DCDC_PortSof). With DCDC_DEFERRED that work is
+  *         queued for USBD_DCDC_EventRun, as it runs application callbacks
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t  USBD_DCDC_SOF(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  USBD_CDC_HandleTypeDef    *cdc;
+  USBD_DCDC_TxQueueTypeDef  *q;
+  uint32_t count;
+  uint8_t port;
+  uint8_t work;
+
+  if (hDCDC == NULL)
+  {
+    return USBD_OK;
+  }
+
+  hDCDC->Frame++;
+  USBD_DCDC_TxSchedTick(pdev);
+
+  for (port = 0U; port < DCDC_NUM_PIPES; port++)
+  {
+    cdc = &hDCDC->CDC[port];
+    q = &cdc->TxQueue;
+
+    /* Partial packet held back on an idle IN endpoint: send it once it has
+       waited FlushFrames frames */
+    if ((q->Buf != NULL) && (q->FlushFrames != 0U) && (cdc->TxState == 0U) &&
+        (q->Head != q->Tail) && (++q->Age >= q->FlushFrames))
+    {
+      USBD_DCDC_TxQueueKick(pdev, cdc, 1U);
+    }
+
+    work = 0U;
+
+#if (DCDC_NCM_ENABLE != 0U)
+    if (port == DCDC_NCM_PORT)
+    {
+      work = USBD_NCM_SofDue(cdc);
+    }
+#endif /* DCDC_NCM_ENABLE */
+
+    /* Idle check of an armed OUT transfer. A message mode transfer only
+       ends on its short packet */
+    if ((cdc->RxState == 1U) && (cdc->MsgMode == 0U))
+    {
+      count = USBD_LL_GetRxDataSize(pdev, cdc->OutEp);
+
+      if ((count == 0U) || (count != cdc->RxPartial))
+      {
+        cdc->RxPartial = count;
+        cdc->RxIdle = 0U;
+      }
+      else if ((cdc->RxIdle >= DCDC_RX_IDLE_FRAMES) || (++cdc->RxIdle >= DCDC_RX_IDLE_FRAMES))
+      {
+        work = 1U;
+      }
+    }
+
+    if (work == 0U)
+    {
+      continue;
+    }
+
+#if (DCDC_DEFERRED != 0U)
+    /* One queued event per pipe: the task runs the work as it finds it */
+    if (((hDCDC->Events.PortQueued & (1UL << port)) == 0U) &&
+        (USBD_DCDC_EventPost(pdev, DCDC_EVENT_PORT | port) == USBD_OK))
+    {
+      hDCDC->Events.PortQueued |= (1UL << port);
+    }
+#else
+    USBD_DCDC_PortSof(pdev, cdc);
+#endif /* DCDC_DEFERRED */
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_PortSof
+  *         Frame driven work of a pipe found by USBD_DCDC_SOF: the NCM
+  *         notification and NTB flush, and the delivery of a multi-packet
+  *         OUT transfer the host left partially filled once no packet
+  *         arrived for DCDC_RX_IDLE_FRAMES frames. Runs with the USB
+  *         interrupts held off.
+  * @param  pdev: device instance
+  * @param  cdc: pipe handle
+  * @retval None
+  */
+static void  USBD_DCDC_PortSof(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+#if (DCDC_NCM_ENABLE != 0U)
+  if (cdc->Port == DCDC_NCM_PORT)
+  {
+    USBD_NCM_SofRun(pdev, cdc);
+  }
+#endif /* DCDC_NCM_ENABLE */
+
+  /* Packets may have arrived since the idle check */
+  if ((cdc->RxIdle >= DCDC_RX_IDLE_FRAMES) && (cdc->RxState == 1U) &&
+      (USBD_LL_GetRxDataSize(pdev, cdc->OutEp) == cdc->RxPartial))
+  {
+    (void)USBD_DCDC_RxFlushPort(pdev, cdc);
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_RxFlushPort
+  *         Body of USBD_DCDC_RxFlush, called with the USB interrupts held
+  *         off. A transfer whose DataOut is already queued is left to it.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval USBD_OK if data was delivered, else USBD_FAIL
+  */
+static uint8_t  USBD_DCDC_RxFlushPort(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  if ((cdc->RxState != 1U) || (cdc->MsgMode != 0U) ||
+      (USBD_LL_EndReceive(pdev, cdc->OutEp) != USBD_OK))
+  {
+    return USBD_FAIL;
+  }
+
+  (void)USBD_DCDC_DataOut(pdev, cdc->OutEp & 0xFU);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_RxRingArm
+  *         Arm the OUT endpoint into the next free ring slot, or leave it
+  *         unarmed (host NAKed) while the ring is full
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval None
+  */
+static void  USBD_DCDC_RxRingArm(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+
+  if ((ring->Head - ring->Tail) < DCDC_RX_SLOTS)
+  {
+    ring->Stalled = 0U;
+    cdc->RxBuffer = &ring->Buf[(ring->Head & (DCDC_RX_SLOTS - 1U)) * ring->SlotSize];
+    (void)USBD_DCDC_ReceivePacket(pdev, cdc);
+  }
+  else
+  {
+    ring->Stalled = 1U;
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_RxPoolArm
+  *         Arm the OUT endpoint with a buffer taken from the loan pool, or
+  *         leave it unarmed (host NAKed) while every buffer is on loan.
+  *         Called from the USB interrupt or with interrupts masked.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval None
+  */
+static void  USBD_DCDC_RxPoolArm(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_RxPoolTypeDef *pool = &cdc->RxPool;
+  uint32_t free = pool->Free;
+  uint8_t idx;
+
+  if (free == 0U)
+  {
+    if (pool->Starved == 0U)
+    {
+      pool->Starved = 1U;
+      pool->Starves++;
+    }
+    return;
+  }
+
+  for (idx = 0U; (free & 1U) == 0U; idx++)
+  {
+    free >>= 1;
+  }
+
+  pool->Free &= ~(1UL << idx);
+  pool->Armed = idx;
+  pool->Starved = 0U;
+
+  cdc->RxBuffer = &pool->Buf[idx * pool->BufSize];
+  (void)USBD_DCDC_ReceivePacket(pdev, cdc);
+}
+
+/**
+  * @brief  USBD_DCDC_CutForward
+  *         Send the packet held in the source OUT PMA buffer on the peer IN
+  *         endpoint by exchanging the two PMA buffers, then re-arm the
+  *         source OUT endpoint into the buffer the peer gave up. Does
+  *         nothing until a packet is held and the peer is idle.
+  * @param  pdev: device instance
+  * @param  src: cut-through source port
+  * @retval None
+  */
+static void  USBD_DCDC_CutForward(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *src)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *dst;
+
+  if ((src->Cut.Held == 0U) || (src->Cut.Peer == DCDC_NO_PORT))
+  {
+    return;
+  }
+
+  dst = &hDCDC->CDC[src->Cut.Peer];
+
+  if (dst->TxState != 0U)
+  {
+    return;
+  }
+
+  src->Cut.Held = 0U;
+
+  if (USBD_LL_PMAExchange(pdev, src->OutEp, dst->InEp) == USBD_OK)
+  {
+    dst->TxState = 1U;
+    dst->Cut.InFlight = 1U;
+
+    /* One packet per transfer: a ZLP from the host is forwarded as one */
+    pdev->ep_in[dst->InEp & 0xFU].total_length = 0U;
+    (void)USBD_LL_Transmit(pdev, dst->InEp, NULL, (uint16_t)src->RxLength);
+    src->Cut.Forwarded++;
+  }
+
+  (void)USBD_DCDC_ReceivePacket(pdev, src);
+}
+
+/**
+  * @brief  USBD_DCDC_TxQueueKick
+  *         Start the next transfer from the TX queue if the IN endpoint is
+  *         idle. Everything queued goes out as one multi-packet transfer, so
+  *         small writes made while the endpoint was busy share full packets.
+  *         Only the last packet of the queued data may be short: a packet
+  *         that straddles the wrap is copied to the Stage buffer and sent
+  *         from there. With a flush budget (FlushFrames) a trailing partial packet is
+  *         held back for the SOF flush unless flush is set. The IN
+  *         scheduler may shorten the transfer or defer it to a later SOF.
+  *         Called from the USB interrupt or with interrupts masked.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  flush: send a partial packet now
+  * @retval None
+  */
+static void  USBD_DCDC_TxQueueKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                   uint8_t flush)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t mps = DCDC_DATA_MPS(pdev);
+  uint32_t pending;
+  uint32_t offset;
+  uint32_t len;
+  uint32_t msg;
+  uint8_t *stage = (uint8_t *)(void *)q->Stage;
+  uint8_t staged = 0U;
+
+  if (cdc->TxState != 0U)
+  {
+    return;
+  }
+
+  if (cdc->MsgMode != 0U)
+  {
+    if (q->MsgHead == q->MsgTail)
+    {
+      return;
+    }
+
+    /* One transfer per message, stored contiguously: skip the padding
+       left before it at the wrap */
+    msg = q->MsgTail & (DCDC_TX_MSGS - 1U);
+    len = q->MsgLen[msg];
+
+    if (USBD_DCDC_TxSchedGrant(pdev, cdc, &len, mps) == 0U)
+    {
+      return;
+    }
+
+    q->Tail = q->MsgStart[msg];
+    q->MsgTail++;
+
+    q->InFlight = q->MsgLen[msg];
+    cdc->TxBuffer = &q->Buf[q->Tail & (q->Size - 1U)];
+    cdc->TxLength = q->MsgLen[msg];
+
+    (void)USBD_DCDC_TransmitPacket(pdev, cdc);
+    return;
+  }
+
+  if (q->Head == q->Tail)
+  {
+    return;
+  }
+
+  pending = q->Head - q->Tail;
+  offset = q->Tail & (q->Size - 1U);
+  len = MIN(pending, q->Size - offset);
+
+  /* Wrapped or over the transfer limit: keep the first part to whole
+     packets, the rest follows */
+  if (len > DCDC_XFER_MAX(mps))
+  {
+    len = DCDC_XFER_MAX(mps);
+  }
+
+  if ((len < pending) && (len >= mps))
+  {
+    len -= len % mps;
+  }
+  else if (len < pending)
+  {
+    /* Less than a packet before the wrap: one packet across it, staged */
+    len = MIN(pending, mps);
+    staged = 1U;
+  }
+
+  if ((q->FlushFrames != 0U) && (flush == 0U))
+  {
+    if (pending < mps)
+    {
+      /* Only a partial packet: wait for more data or the SOF flush */
+      return;
+    }
+
+    /* Send the full packets, the partial tail stays queued */
+    if (len == pending)
+    {
+      len -= len % mps;
+    }
+  }
+
+  if (USBD_DCDC_TxSchedGrant(pdev, cdc, &len, mps) == 0U)
+  {
+    return;
+  }
+
+  if (q->FlushFrames != 0U)
+  {
+    if (flush != 0U)
+    {
+      q->TimerFlushes++;
+    }
+    else
+    {
+      q->SizeFlushes++;
+    }
+
+    q->Age = 0U;
+  }
+
+  q->InFlight = len;
+  cdc->TxBuffer = &q->Buf[offset];
+  cdc->TxLength = len;
+
+  if (staged != 0U)
+  {
+    (void)memcpy(stage, &q->Buf[offset], q->Size - offset);
+    (void)memcpy(&stage[q->Size - offset], q->Buf, len - (q->Size - offset));
+    cdc->TxBuffer = stage;
+  }
+
+  (void)USBD_DCDC_TransmitPacket(pdev, cdc);
+}
+
+/**
+  * @brief  USBD_DCDC_TxBacklogged
+  *         Whether the port TX queue holds data no transfer has taken yet
+  * @param  cdc: port handle
+  * @retval 1 if backlogged, else 0
+  */
+static uint8_t  USBD_DCDC_TxBacklogged(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+
+  if (q->Buf == NULL)
+  {
+    return 0U;
+  }
+
+  if (cdc->MsgMode != 0U)
+  {
+    return (q->MsgHead != q->MsgTail) ? 1U : 0U;
+  }
+
+  return ((q->Head - q->Tail) > q->InFlight) ? 1U : 0U;
+}
+
+/**
+  * @brief  USBD_DCDC_TxSchedGrant
+  *         Admit a TX queue transfer. The express port goes first: while it
+  *         has data queued or on the bus, other ports wait. A weighted port
+  *         needs a positive deficit and a rate capped port positive tokens;
+  *         a stream transfer is shortened to the smaller credit rounded up
+  *         to whole packets, never past its own length, a message goes
+  *         whole. Credits may go negative
+  *         and are paid back from later frames. Also records how long the
+  *         oldest queued data waited.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  len: transfer length, may be shortened
+  * @param  mps: max packet size
+  * @retval 1 to start the transfer, 0 if deferred
+  */
+static uint8_t  USBD_DCDC_TxSchedGrant(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                       uint32_t *len, uint32_t mps)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  USBD_CDC_HandleTypeDef *express;
+  int32_t credit = 0x7FFFFFFF;
+  uint32_t wait;
+  uint32_t bucket;
+
+  if ((hDCDC->Express != DCDC_NO_PORT) && (hDCDC->Express != cdc->Port))
+  {
+    express = &hDCDC->CDC[hDCDC->Express];
+
+    if ((express->TxState != 0U) || (USBD_DCDC_TxBacklogged(express) != 0U))
+    {
+      q->Deferred = 1U;
+      q->Defers++;
+      return 0U;
+    }
+  }
+
+  if (q->Weight != 0U)
+  {
+    credit = q->Deficit;
+  }
+
+  if ((q->Rate != 0U) && (q->Tokens < credit))
+  {
+    credit = q->Tokens;
+  }
+
+  if (credit <= 0)
+  {
+    q->Deferred = 1U;
+    q->Defers++;
+    return 0U;
+  }
+
+  if ((cdc->MsgMode == 0U) && (*len > (uint32_t)credit))
+  {
+    /* Rounding up must not reach past the queued data */
+    *len = MIN((((uint32_t)credit + mps - 1U) / mps) * mps, *len);
+  }
+
+  if (q->Weight != 0U)
+  {
+    q->Deficit -= (int32_t)*len;
+  }
+
+  if (q->Rate != 0U)
+  {
+    q->Tokens -= (int32_t)*len;
+  }
+
+  q->Deferred = 0U;
+
+  /* Queue latency: log2 buckets of the frames waited */
+  wait = hDCDC->Frame - q->Stamp;
+  for (bucket = 0U; (wait != 0U) && (bucket < (DCDC_TX_LAT_BUCKETS - 1U)); bucket++)
+  {
+    wait >>= 1;
+  }
+  q->Latency[bucket]++;
+  q->Stamp = hDCDC->Frame;
+
+  return 1U;
+}
+
+/**
+  * @brief  USBD_DCDC_TxSchedTick
+  *         Per frame credit refill. The frame budget is shared among the
+  *         backlogged weighted ports in proportion to their weights; an idle
+  *         port keeps no credit. Token buckets fill by their rate up to the
+  *         burst depth. Deferred ports are then retried.
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void  USBD_DCDC_TxSchedTick(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_DCDC_TxQueueTypeDef *q;
+  uint32_t budget;
+  uint32_t weights = 0U;
+  uint32_t share;
+  uint8_t port;
+
+  budget = (DCDC_IS_HS(pdev) != 0U) ? (DCDC_SCHED_HS_PACKETS * DCDC_DATA_HS_MAX_PACKET_SIZE)
+                                    : (DCDC_SCHED_FS_PACKETS * DCDC_DATA_FS_MAX_PACKET_SIZE);
+
+  for (port = 0U; port < DCDC_NUM_PIPES; port++)
+  {
+    q = &hDCDC->CDC[port].TxQueue;
+
+    if ((q->Weight != 0U) && (USBD_DCDC_TxBacklogged(&hDCDC->CDC[port]) != 0U))
+    {
+      weights += q->Weight;
+    }
+  }
+
+  for (port = 0U; port < DCDC_NUM_PIPES; port++)
+  {
+    q = &hDCDC->CDC[port].TxQueue;
+
+    if (q->Weight != 0U)
+    {
+      if (USBD_DCDC_TxBacklogged(&hDCDC->CDC[port]) == 0U)
+      {
+        q->Deficit = MIN(q->Deficit, 0);
+      }
+      else
+      {
+        /* Capped to one frame budget so a port blocked on its endpoint
+           cannot hoard credit */
+        share = (budget * q->Weight) / weights;
+        q->Deficit = MIN(q->Deficit + (int32_t)share, (int32_t)budget);
+      }
+    }
+
+    if (q->Rate != 0U)
+    {
+      q->Tokens = MIN(q->Tokens + (int32_t)q->Rate, (int32_t)q->Burst);
+    }
+  }
+
+  USBD_DCDC_TxSchedResume(pdev);
+}
+
+/**
+  * @brief  USBD_DCDC_TxSchedResume
+  *         Retry the ports the scheduler deferred
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void  USBD_DCDC_TxSchedResume(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *cdc;
+  uint8_t port;
+
+  /* Express port first */
+  for (port = 0U; port < DCDC_NUM_PIPES; port++)
+  {
+    cdc = &hDCDC->CDC[(hDCDC->Express != DCDC_NO_PORT) ? ((hDCDC->Express + port) % DCDC_NUM_PIPES) : port];
+
+    if ((cdc->TxQueue.Deferred != 0U) && (cdc->TxState == 0U))
+    {
+      cdc->TxQueue.Deferred = 0U;
+      USBD_DCDC_TxQueueKick(pdev, cdc, 0U);
+    }
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_TxVecNext
+  *         Start the next piece of a scatter-gather chain: the whole packets
+  *         of the current fragment straight from its memory, or one packet
+  *         assembled in the bounce buffer where data straddles fragments.
+  *         Every piece but the last is whole packets, so the ZLP rule of a
+  *         single transfer still holds for the chain.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval 1 if a piece was started, 0 once the chain is sent
+  */
+static uint8_t  USBD_DCDC_TxVecNext(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_TxVecTypeDef *v = &cdc->TxVec;
+  uint32_t mps = DCDC_DATA_MPS(pdev);
+  uint8_t *bounce = (uint8_t *)(void *)v->Bounce;
+  const uint8_t *buf;
+  uint32_t rem;
+  uint32_t len;
+  uint32_t chunk;
+  uint32_t i;
+
+  while ((v->Index < v->IovCnt) && (v->Offset == v->Iov[v->Index].Len))
+  {
+    v->Index++;
+    v->Offset = 0U;
+  }
+
+  if (v->Index >= v->IovCnt)
+  {
+    return 0U;
+  }
+
+  rem = v->Iov[v->Index].Len - v->Offset;
+  buf = &v->Iov[v->Index].Buf[v->Offset];
+
+  for (i = v->Index + 1U; (i < v->IovCnt) && (v->Iov[i].Len == 0U); i++)
+  {
+  }
+
+  if (rem >= mps)
+  {
+    /* Whole packets, zero copy; a longer fragment takes several pieces */
+    len = MIN(rem - (rem % mps), DCDC_XFER_MAX(mps));
+    v->Offset += len;
+  }
+  else if (i >= v->IovCnt)
+  {
+    /* Short tail of the chain, zero copy */
+    len = rem;
+    v->Offset += len;
+  }
+  else
+  {
+    /* Gather one packet across fragment boundaries */
+    len = 0U;
+    while ((len < mps) && (v->Index < v->IovCnt))
+    {
+      chunk = MIN(mps - len, v->Iov[v->Index].Len - v->Offset);
+      (void)memcpy(&bounce[len], &v->Iov[v->Index].Buf[v->Offset], chunk);
+      len += chunk;
+      v->Offset += chunk;
+
+      if (v->Offset == v->Iov[v->Index].Len)
+      {
+        v->Index++;
+        v->Offset = 0U;
+      }
+    }
+    buf = bounce;
+  }
+
+  cdc->TxBuffer = (uint8_t *)buf;
+  cdc->TxLength = len;
+  pdev->ep_in[cdc->InEp & 0xFU].total_length = len;
+
+  (void)USBD_LL_Transmit(pdev, cdc->InEp, cdc->TxBuffer, (uint16_t)len);
+
+  return 1U;
+}
+
+/**
+  * @brief  USBD_DCDC_AtomicClaim
+  *         Set a flag from 0 to 1 with LDREX/STREX. An exception between
+  *         the two clears the exclusive monitor, so the store fails and the
+  *         flag is read again.
+  * @param  flag: flag word
+  * @retval 1 if this caller set it, 0 if it was already set
+  */
+static uint8_t  USBD_DCDC_AtomicClaim(__IO uint32_t *flag)
+{
+  do
+  {
+    if (__LDREXW(flag) != 0U)
+    {
+      __CLREX();
+      return 0U;
+    }
+  } while (__STREXW(1U, flag) != 0U);
+
+  return 1U;
+}
+
+/**
+  * @brief  USBD_DCDC_AtomicAdd
+  *         Add to a word with LDREX/STREX
+  * @param  value: word
+  * @param  delta: addend, (uint32_t)-1 to decrement
+  * @retval new value
+  */
+static uint32_t  USBD_DCDC_AtomicAdd(__IO uint32_t *value, uint32_t delta)
+{
+  uint32_t v;
+
+  do
+  {
+    v = __LDREXW(value) + delta;
+  } while (__STREXW(v, value) != 0U);
+
+  return v;
+}
+
+/**
+  * @brief  USBD_DCDC_AtomicSwap
+  *         Replace a word with LDREX/STREX
+  * @param  value: word
+  * @param  swap: new value
+  * @retval previous value
+  */
+static uint32_t  USBD_DCDC_AtomicSwap(__IO uint32_t *value, uint32_t swap)
+{
+  uint32_t v;
+
+  do
+  {
+    v = __LDREXW(value);
+  } while (__STREXW(swap, value) != 0U);
+
+  return v;
+}
+
+/**
+  * @brief  USBD_DCDC_NotifyKick
+  *         Send the next pending notification if the notification endpoint
+  *         is idle, SERIAL_STATE first. Called from the USB interrupt or
+  *         with interrupts masked.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval None
+  */
+static void  USBD_DCDC_NotifyKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_NotifyTypeDef *n = &cdc->Notify;
+  uint8_t *pkt = (uint8_t *)(void *)n->Buf;
+  uint16_t len;
+  uint16_t i;
+
+  if ((n->Busy != 0U) || (n->Pending == 0U))
+  {
+    return;
+  }
+
+  pkt[0] = 0xA1U;                               /* bmRequestType: class, interface, IN */
+  pkt[4] = cdc->Itf;                            /* wIndex: communication interface */
+  pkt[5] = 0U;
+
+  if ((n->Pending & DCDC_NOTIFY_SERIAL_STATE) != 0U)
+  {
+    pkt[1] = CDC_NOTIFY_SERIAL_STATE;
+    pkt[2] = 0U;
+    pkt[3] = 0U;
+    pkt[6] = 2U;
+    pkt[7] = 0U;
+    pkt[8] = LOBYTE(n->SerialState);
+    pkt[9] = HIBYTE(n->SerialState);
+    len = 10U;
+
+    /* Events are reported once, line levels persist */
+    n->SerialState &= (uint16_t)~CDC_SERIAL_STATE_EVENTS;
+    n->Pending &= (uint8_t)~DCDC_NOTIFY_SERIAL_STATE;
+  }
+  else
+  {
+    pkt[1] = n->Event;
+    pkt[2] = LOBYTE(n->EventValue);
+    pkt[3] = HIBYTE(n->EventValue);
+    pkt[6] = n->EventLen;
+    pkt[7] = 0U;
+
+    for (i = 0U; i < n->EventLen; i++)
+    {
+      pkt[8U + i] = n->EventData[i];
+    }
+    len = 8U + n->EventLen;
+
+    n->Pending &= (uint8_t)~DCDC_NOTIFY_EVENT;
+  }
+
+  n->Busy = 1U;
+  n->Sent++;
+
+  USBD_LL_Transmit(pdev, cdc->CmdEp, pkt, len);
+}
+
+/**
+  * @brief  USBD_DCDC_PortCfgDesc
+  *         Configuration descriptor for the current port count: the port
+  *         functions beyond it are cut out and the functions after the
+  *         ports take over the freed interface numbers. Endpoint numbers
+  *         and the PMA layout do not change.
+  * @param  desc: descriptor built for DCDC_NUM_PORTS ports
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DCDC_PortCfgDesc(uint8_t *desc, uint16_t *length)
+{
+  uint8_t *out = USBD_DCDC_CfgRunDesc;
+  uint32_t head = 9U + (USB_DCDC_FUNC_DESC_SIZ * DCDC_PortCount);
+  uint32_t skip = USB_DCDC_FUNC_DESC_SIZ * (DCDC_NUM_PORTS - DCDC_PortCount);
+  uint32_t total = USB_DCDC_CONFIG_DESC_SIZ - skip;
+  uint8_t shift = (uint8_t)(2U * (DCDC_NUM_PORTS - DCDC_PortCount));
+  uint32_t i;
+  uint32_t k;
+
+  if (DCDC_PortCount == DCDC_NUM_PORTS)
+  {
+    *length = USB_DCDC_CONFIG_DESC_SIZ;
+    return desc;
+  }
+
+  (void)memcpy(out, desc, head);
+  (void)memcpy(&out[head], &desc[head + skip], total - head);
+
+  out[2] = LOBYTE(total);
+  out[3] = HIBYTE(total);
+  out[4] = (uint8_t)(out[4] - shift);             /* bNumInterfaces */
+
+  for (i = head; (i < total) && (out[i] != 0U); i += out[i])
+  {
+    if ((out[i + 1U] == USB_DESC_TYPE_IAD) || (out[i + 1U] == USB_DESC_TYPE_INTERFACE))
+    {
+      out[i + 2U] = (uint8_t)(out[i + 2U] - shift);
+    }
+    else if ((out[i + 1U] == 0x24U) && (out[i + 2U] == 0x01U))
+    {
+      /* Call Management: bDataInterface */
+      out[i + 4U] = (uint8_t)(out[i + 4U] - shift);
+    }
+    else if ((out[i + 1U] == 0x24U) && (out[i + 2U] == 0x06U))
+    {
+      /* Union: master and slave interfaces */
+      for (k = 3U; k < out[i]; k++)
+      {
+        out[i + k] = (uint8_t)(out[i + k] - shift);
+      }
+    }
+    else
+    {
+    }
+  }
+
+  *length = (uint16_t)total;
+  return out;
+}
+
+/**
+  * @brief  USBD_DCDC_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DCDC_GetFSCfgDesc(uint16_t *length)
+{
+  return USBD_DCDC_PortCfgDesc(USBD_DCDC_CfgFSDesc, length);
+}
+
+#if (DCDC_HS_ENABLE != 0U)
+/**
+  * @brief  USBD_DCDC_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DCDC_GetHSCfgDesc(uint16_t *length)
+{
+  return USBD_DCDC_PortCfgDesc(USBD_DCDC_CfgHSDesc, length);
+}
+
+/**
+  * @brief  USBD_DCDC_GetCfgDesc
+  *         Return configuration descriptor
+  * @param  speed : current device speed
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t  *USBD_DCDC_GetOtherSpeedCfgDesc(uint16_t *length)
+{
+  return USBD_DCDC_PortCfgDesc(USBD_DCDC_OtherSpeedCfgDesc, length);
+}
+
+/**
+* @brief  DeviceQualifierDescriptor
+*         return Device Qualifier descriptor
+* @param  length : pointer data length
+* @retval pointer to descriptor buffer
+*/
+uint8_t  *USBD_DCDC_GetDeviceQualifierDescriptor(uint16_t *length)
+{
+  *length = sizeof(USBD_DCDC_DeviceQualifierDesc);
+  return USBD_DCDC_DeviceQualifierDesc;
+}
+#endif /* DCDC_HS_ENABLE */
+
+/**
+* @brief  USBD_DCDC_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: CD  Interface callback
+  * @retval status
+  */
+uint8_t  USBD_DCDC_RegisterInterface(USBD_HandleTypeDef   *pdev,
+                                    USBD_DCDC_ItfTypeDef *fops)
+{
+  uint8_t  ret = USBD_FAIL;
+
+  if (fops != NULL)
+  {
+    pdev->pUserData = fops;
+    ret = USBD_OK;
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  USBD_DCDC_SetTxBuffer
+  * @param  pdev: device instance
+  * @param  pbuff: Tx Buffer
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetTxBuffer(USBD_HandleTypeDef   *pdev,
+                              USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t  *pbuff,
+                              uint16_t length)
+{
+  //USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+
+  cdc->TxBuffer = pbuff;
+  cdc->TxLength = length;
+
+  return USBD_OK;
+}
+
+
+/**
+  * @brief  USBD_DCDC_SetRxBuffer
+  * @param  pdev: device instance
+  * @param  pbuff: Rx Buffer
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetRxBuffer(USBD_HandleTypeDef   *pdev,
+                              USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t  *pbuff)
+{
+    // TODO this code sucks...fix this
+  //USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+
+  cdc->RxBuffer = pbuff;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_SetRxRing
+  *         Give the port DCDC_RX_SLOTS slots to receive into, one OUT transfer
+  *         per slot. Call from the interface Init callback; the class then
+  *         re-arms the OUT endpoint itself, before the Receive callback
+  *         runs, and the application must not call ReceivePacket.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: DCDC_RX_SLOTS * slot_size bytes
+  * @param  slot_size: slot size, at least one max packet; also the OUT
+  *         transfer size (see USBD_DCDC_SetRxXferSize)
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetRxRing(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint8_t  *pbuff,
+                            uint32_t slot_size)
+{
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+
+  if ((pbuff == NULL) || (slot_size < DCDC_DATA_FS_MAX_PACKET_SIZE) ||
+      ((DCDC_IS_HS(pdev) != 0U) && (slot_size < DCDC_DATA_HS_MAX_PACKET_SIZE)))
+  {
+    return USBD_FAIL;
+  }
+
+  ring->Buf = pbuff;
+  ring->SlotSize = slot_size;
+  ring->Head = 0U;
+  ring->Tail = 0U;
+  ring->Stalled = 0U;
+  ring->Discard = 0U;
+  ring->Dropped = 0U;
+
+  cdc->RxPool.Buf = NULL;
+  cdc->RxBuffer = pbuff;
+
+  /* One OUT transfer per slot, whole packets only */
+  return USBD_DCDC_SetRxXferSize(pdev, cdc, slot_size);
+}
+
+/**
+  * @brief  USBD_DCDC_SetRxPool
+  *         Give the port a pool of receive buffers to lend out. Each filled
+  *         buffer is handed to the Receive callback and stays with the
+  *         application, in place, until USBD_DCDC_RxReturn; the OUT endpoint
+  *         is re-armed from the pool before the callback runs. Buffers may
+  *         be returned in any order. Call from the interface Init callback;
+  *         the class arms the endpoint itself and the application must not
+  *         call ReceivePacket.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: DCDC_RX_SLOTS * buf_size bytes
+  * @param  buf_size: buffer size, at least one max packet; also the OUT
+  *         transfer size (see USBD_DCDC_SetRxXferSize)
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetRxPool(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint8_t  *pbuff,
+                            uint32_t buf_size)
+{
+  USBD_DCDC_RxPoolTypeDef *pool = &cdc->RxPool;
+
+  if ((pbuff == NULL) || (buf_size < DCDC_DATA_FS_MAX_PACKET_SIZE) ||
+      ((DCDC_IS_HS(pdev) != 0U) && (buf_size < DCDC_DATA_HS_MAX_PACKET_SIZE)))
+  {
+    return USBD_FAIL;
+  }
+
+  /* Buffer 0 is the one armed at Init */
+  pool->Buf = pbuff;
+  pool->BufSize = buf_size;
+  pool->Free = ((DCDC_RX_SLOTS == 32U) ? 0xFFFFFFFFU : ((1UL << DCDC_RX_SLOTS) - 1U)) & ~1UL;
+  pool->Armed = 0U;
+  pool->Starved = 0U;
+  pool->Loans = 0U;
+  pool->Starves = 0U;
+
+  cdc->RxRing.Buf = NULL;
+  cdc->MsgMode = 0U;
+  cdc->RxBuffer = pbuff;
+
+  return USBD_DCDC_SetRxXferSize(pdev, cdc, buf_size);
+}
+
+/**
+  * @brief  USBD_DCDC_RxReturn
+  *         Give a lent buffer back to the port pool; restarts reception if
+  *         the pool had run dry. Callable from task or interrupt context.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  buf: buffer passed to the Receive callback
+  * @retval USBD_OK, or USBD_FAIL if buf is not a lent buffer of the pool
+  */
+uint8_t  USBD_DCDC_RxReturn(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           uint8_t *buf)
+{
+  USBD_DCDC_RxPoolTypeDef *pool = &cdc->RxPool;
+  uint8_t ret = USBD_FAIL;
+  uint32_t offset;
+  uint32_t bit;
+
+  if ((pool->Buf == NULL) || (buf < pool->Buf))
+  {
+    return USBD_FAIL;
+  }
+
+  offset = (uint32_t)(buf - pool->Buf);
+
+  if (((offset % pool->BufSize) != 0U) || ((offset / pool->BufSize) >= DCDC_RX_SLOTS))
+  {
+    return USBD_FAIL;
+  }
+
+  bit = 1UL << (offset / pool->BufSize);
+
+  DCDC_ENTER_CRITICAL();
+
+  if (((pool->Free & bit) == 0U) &&
+      ((pool->Starved != 0U) || (cdc->RxBuffer != buf)))
+  {
+    pool->Free |= bit;
+    ret = USBD_OK;
+
+    if ((pool->Starved != 0U) && (pdev->pClassData != NULL))
+    {
+      USBD_DCDC_RxPoolArm(pdev, cdc);
+    }
+  }
+
+  DCDC_EXIT_CRITICAL();
+
+  return ret;
+}
+
+/**
+  * @brief  USBD_DCDC_SetCutThrough
+  *         Forward every OUT packet of the port to the IN endpoint of peer
+  *         without copying it: the packet is left in its PMA buffer and the
+  *         buffer is exchanged with the idle peer IN buffer in the BTABLE.
+  *         Packet boundaries, short packets and ZLPs are kept; the host is
+  *         NAKed while the peer IN endpoint is busy. The port Receive
+  *         callback no longer runs; data queued on the peer with TxWrite
+  *         still goes out, between forwarded packets. Both endpoints must
+  *         be single buffered (see DCDC_DBLBUF_PORTS). Call from the
+  *         interface Init callback; peer may be the port itself (echo).
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  peer: destination port handle, NULL to turn forwarding off
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetCutThrough(USBD_HandleTypeDef   *pdev,
+                                USBD_CDC_HandleTypeDef *cdc,
+                                USBD_CDC_HandleTypeDef *peer)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+
+  if ((hDCDC == NULL) || (cdc->Port >= DCDC_NUM_PORTS))
+  {
+    return USBD_FAIL;
+  }
+
+  if (peer == NULL)
+  {
+    if (cdc->Cut.Peer != DCDC_NO_PORT)
+    {
+      hDCDC->CDC[cdc->Cut.Peer].Cut.Src = DCDC_NO_PORT;
+    }
+    cdc->Cut.Peer = DCDC_NO_PORT;
+    return USBD_OK;
+  }
+
+  if ((peer->Port >= DCDC_NUM_PORTS) || (DCDC_PORT_DBLBUF(cdc->Port) != 0U) ||
+      (DCDC_PORT_DBLBUF(peer->Port) != 0U) ||
+      ((peer->Cut.Src != DCDC_NO_PORT) && (peer->Cut.Src != cdc->Port)))
+  {
+    return USBD_FAIL;
+  }
+
+  cdc->Cut.Peer = peer->Port;
+  cdc->Cut.Held = 0U;
+  peer->Cut.Src = cdc->Port;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_SetRxXferSize
+  *         Set how many bytes one OUT transfer may gather before the Receive
+  *         callback runs. The transfer also ends on a short packet, and on
+  *         an idle bus after DCDC_RX_IDLE_FRAMES frames. Rounded down to
+  *         whole packets; takes effect at the next arming. A ring or pool
+  *         port gets its buffer size from USBD_DCDC_SetRxRing or
+  *         USBD_DCDC_SetRxPool.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  size: transfer size in bytes, at most the receive buffer size
+  * @retval status
   */
-static uint8_t  *USBD_DCDC_GetFSCfgDesc(uint16_t *length)
+uint8_t  USBD_DCDC_SetRxXferSize(USBD_HandleTypeDef   *pdev,
+                                USBD_CDC_HandleTypeDef *cdc,
+                                uint32_t size)
 {
-  *length = sizeof(USBD_DCDC_CfgFSDesc);
-  return USBD_DCDC_CfgFSDesc;
+  uint32_t mps;
+
+  mps = DCDC_DATA_MPS(pdev);
+
+  if ((size < mps) || (size > 0xFFFFU) ||
+      ((cdc->RxRing.Buf != NULL) && (size > cdc->RxRing.SlotSize)) ||
+      ((cdc->RxPool.Buf != NULL) && (size > cdc->RxPool.BufSize)))
+  {
+    return USBD_FAIL;
+  }
+
+  cdc->RxXferSize = size - (size % mps);
+
+  return USBD_OK;
 }
 
 /**
-  * @brief  USBD_DCDC_GetHSCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_DCDC_RxFlush
+  *         Deliver the OUT transfer in progress with the packets received so
+  *         far, as if it had ended on a short packet. The Receive callback
+  *         runs with the USB interrupts masked (USBD_LL_MaskIrq), other
+  *         interrupts stay live. Call from a task or a class callback, not
+  *         from an interrupt that may preempt the USB ones.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval USBD_OK if data was delivered, else USBD_FAIL (always in
+  *         message mode)
   */
-static uint8_t  *USBD_DCDC_GetHSCfgDesc(uint16_t *length)
+uint8_t  USBD_DCDC_RxFlush(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
 {
-  *length = sizeof(USBD_DCDC_CfgHSDesc);
-  return USBD_DCDC_CfgHSDesc;
+  uint8_t ret = USBD_FAIL;
+
+  (void)USBD_LL_MaskIrq(pdev, 1U);
+
+  if (pdev->pClassData != NULL)
+  {
+    ret = USBD_DCDC_RxFlushPort(pdev, cdc);
+  }
+
+  (void)USBD_LL_MaskIrq(pdev, 0U);
+
+  return ret;
 }
 
 /**
-  * @brief  USBD_DCDC_GetCfgDesc
-  *         Return configuration descriptor
-  * @param  speed : current device speed
-  * @param  length : pointer data length
-  * @retval pointer to descriptor buffer
+  * @brief  USBD_DCDC_RxPeek
+  *         Oldest filled slot of the port RX ring
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  length: number of bytes in the slot
+  * @retval pointer to the slot data, NULL if the ring is empty
   */
-static uint8_t  *USBD_DCDC_GetOtherSpeedCfgDesc(uint16_t *length)
+uint8_t  *USBD_DCDC_RxPeek(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                          uint32_t *length)
 {
-  *length = sizeof(USBD_DCDC_OtherSpeedCfgDesc);
-  return USBD_DCDC_OtherSpeedCfgDesc;
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+  uint32_t slot;
+
+  if ((ring->Buf == NULL) || (ring->Head == ring->Tail))
+  {
+    return NULL;
+  }
+
+  slot = ring->Tail & (DCDC_RX_SLOTS - 1U);
+  *length = ring->Len[slot];
+
+  return &ring->Buf[slot * ring->SlotSize];
 }
 
 /**
-* @brief  DeviceQualifierDescriptor
-*         return Device Qualifier descriptor
-* @param  length : pointer data length
-* @retval pointer to descriptor buffer
-*/
-uint8_t  *USBD_DCDC_GetDeviceQualifierDescriptor(uint16_t *length)
+  * @brief  USBD_DCDC_RxRelease
+  *         Return the oldest slot to the ring; restarts reception if the ring
+  *         had run full. Callable from task or interrupt context.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval status
+  */
+uint8_t  USBD_DCDC_RxRelease(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
 {
-  *length = sizeof(USBD_DCDC_DeviceQualifierDesc);
-  return USBD_DCDC_DeviceQualifierDesc;
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+
+  if ((ring->Buf == NULL) || (ring->Head == ring->Tail))
+  {
+    return USBD_FAIL;
+  }
+
+  ring->Tail++;
+
+  if (ring->Stalled != 0U)
+  {
+    DCDC_ENTER_CRITICAL();
+
+    if ((ring->Stalled != 0U) && (pdev->pClassData != NULL))
+    {
+      USBD_DCDC_RxRingArm(pdev, cdc);
+    }
+
+    DCDC_EXIT_CRITICAL();
+  }
+
+  return USBD_OK;
 }
 
 /**
-* @brief  USBD_DCDC_RegisterInterface
+  * @brief  USBD_DCDC_SetTxQueue
+  *         Give the port a byte FIFO to queue writes in. Call from the
+  *         interface Init callback.
   * @param  pdev: device instance
-  * @param  fops: CD  Interface callback
+  * @param  cdc: port handle
+  * @param  pbuff: FIFO storage
+  * @param  size: FIFO size, a power of two
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetTxQueue(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t  *pbuff,
+                             uint32_t size)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t i;
+
+  if ((pbuff == NULL) || (size == 0U) || ((size & (size - 1U)) != 0U))
+  {
+    return USBD_FAIL;
+  }
+
+  q->Buf = pbuff;
+  q->Size = size;
+  q->Head = 0U;
+  q->Tail = 0U;
+  q->Reserve = 0U;
+  q->Writers = 0U;
+  q->InFlight = 0U;
+  q->Bytes = 0U;
+  q->Packets = 0U;
+  q->MsgHead = 0U;
+  q->MsgTail = 0U;
+  q->SizeFlushes = 0U;
+  q->TimerFlushes = 0U;
+  q->FlushFrames = 0U;
+  q->Age = 0U;
+  q->Weight = 0U;
+  q->Deferred = 0U;
+  q->Deficit = 0;
+  q->Rate = 0U;
+  q->Burst = 0U;
+  q->Tokens = 0;
+  q->Defers = 0U;
+  q->Stamp = 0U;
+  for (i = 0U; i < DCDC_TX_LAT_BUCKETS; i++)
+  {
+    q->Latency[i] = 0U;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_TxWrite
+  *         Queue data on the port; starts a transfer if the IN endpoint is
+  *         idle, otherwise DataIn picks it up on completion. Lock-free:
+  *         tasks and interrupts may write the same port concurrently, each
+  *         write lands in one piece. In message mode a write that finds
+  *         another one in progress is refused (returns 0) and may retry.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: data
+  * @param  length: number of bytes
+  * @retval number of bytes accepted, limited by the free space
+  */
+uint32_t USBD_DCDC_TxWrite(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           const uint8_t *pbuff, uint32_t length)
+{
+  return USBD_DCDC_TxPut(pdev, cdc, pbuff, length, 0U);
+}
+
+/**
+  * @brief  USBD_DCDC_TxSubmit
+  *         Queue data on the port all or nothing, see USBD_DCDC_TxWrite.
+  *         The free space check and the claim are one atomic step, so
+  *         concurrent writers cannot split the data.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: data
+  * @param  length: number of bytes
+  * @retval USBD_OK, USBD_BUSY if the queue lacks room, USBD_FAIL without
+  *         class or queue
+  */
+uint8_t  USBD_DCDC_TxSubmit(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                           const uint8_t *pbuff, uint32_t length)
+{
+  if ((pdev->pClassData == NULL) || (cdc->TxQueue.Buf == NULL))
+  {
+    return USBD_FAIL;
+  }
+
+  return (USBD_DCDC_TxPut(pdev, cdc, pbuff, length, 1U) == length) ? USBD_OK : USBD_BUSY;
+}
+
+/**
+  * @brief  USBD_DCDC_TxPut
+  *         Claim queue space by advancing Reserve, copy into it, then
+  *         publish. Writers nest (an interrupt preempts a task in the middle
+  *         of its copy) or interleave (tasks of equal priority): Writers
+  *         counts those between claim and publish, and the last one out
+  *         moves Head up to Reserve for all of them.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: data
+  * @param  length: number of bytes
+  * @param  whole: queue nothing unless all of it fits
+  * @retval number of bytes accepted
+  */
+static uint32_t  USBD_DCDC_TxPut(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                 const uint8_t *pbuff, uint32_t length, uint8_t whole)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t start;
+  uint32_t room;
+  uint32_t len;
+  uint32_t offset;
+  uint32_t chunk;
+
+  if ((pdev->pClassData == NULL) || (q->Buf == NULL))
+  {
+    return 0U;
+  }
+
+  if (cdc->MsgMode != 0U)
+  {
+    return USBD_DCDC_TxWriteMsg(pdev, cdc, pbuff, length);
+  }
+
+  (void)USBD_DCDC_AtomicAdd(&q->Writers, 1U);
+
+  do
+  {
+    start = __LDREXW(&q->Reserve);
+    room = q->Size - (start - q->Tail);
+    len = ((whole != 0U) && (length > room)) ? 0U : MIN(length, room);
+
+    if (len == 0U)
+    {
+      __CLREX();
+      break;
+    }
+  } while (__STREXW(start + len, &q->Reserve) != 0U);
+
+  if (len != 0U)
+  {
+    if ((start - q->Tail) == q->InFlight)
+    {
+      q->Stamp = ((USBD_DCDC_HandleTypeDef *)pdev->pClassData)->Frame;
+    }
+
+    offset = start & (q->Size - 1U);
+    chunk = MIN(len, q->Size - offset);
+
+    (void)memcpy(&q->Buf[offset], pbuff, chunk);
+    (void)memcpy(q->Buf, &pbuff[chunk], len - chunk);
+  }
+
+  /* Even without data: an overlapped writer may have left publishing to us */
+  USBD_DCDC_TxPublish(pdev, cdc);
+
+  return len;
+}
+
+/**
+  * @brief  USBD_DCDC_TxPublish
+  *         Leave the writer section. The last writer out publishes every
+  *         claimed byte: Head is stored with STREX only if no writer
+  *         entered since Writers was seen at 0, which an exception in
+  *         between would show by failing the store. Hands the queue kick
+  *         to the USB interrupt if the IN endpoint is idle.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval None
+  */
+static void  USBD_DCDC_TxPublish(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t head;
+  uint32_t reserve;
+
+  if (USBD_DCDC_AtomicAdd(&q->Writers, (uint32_t)-1) != 0U)
+  {
+    return;
+  }
+
+  do
+  {
+    head = __LDREXW(&q->Head);
+    reserve = q->Reserve;
+
+    if ((q->Writers != 0U) || (reserve == head))
+    {
+      __CLREX();
+      return;
+    }
+  } while (__STREXW(reserve, &q->Head) != 0U);
+
+  /* DataIn sees the new Head if the endpoint is still busy here */
+  if (cdc->TxState == 0U)
+  {
+    USBD_DCDC_TxHandoff(pdev, cdc);
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_TxHandoff
+  *         Ask the USB interrupt to kick the port TX queue, see
+  *         USBD_DCDC_TxService. The queue kick and the IN scheduler state
+  *         then only ever change in the USB interrupt, without masking
+  *         interrupts in the caller.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval None
+  */
+static void  USBD_DCDC_TxHandoff(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  uint32_t bit = 1UL << cdc->Port;
+  uint32_t kick;
+
+  if ((hDCDC->TxKick & bit) == 0U)
+  {
+    do
+    {
+      kick = __LDREXW(&hDCDC->TxKick) | bit;
+    } while (__STREXW(kick, &hDCDC->TxKick) != 0U);
+  }
+
+  (void)USBD_LL_TriggerIrq(pdev);
+}
+
+/**
+  * @brief  USBD_DCDC_TxService
+  *         Run the TX queue kicks handed over by TxWrite and TxSubmit.
+  *         Call at the end of the USB interrupt handler.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void  USBD_DCDC_TxService(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  uint32_t kick;
+  uint8_t pipe;
+
+  if ((hDCDC == NULL) || (hDCDC->TxKick == 0U))
+  {
+    return;
+  }
+
+  kick = USBD_DCDC_AtomicSwap(&hDCDC->TxKick, 0U);
+
+  for (pipe = 0U; pipe < DCDC_NUM_PIPES; pipe++)
+  {
+    if ((kick & (1UL << pipe)) != 0U)
+    {
+      USBD_DCDC_TxQueueKick(pdev, &hDCDC->CDC[pipe], 0U);
+    }
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_TxWriteMsg
+  *         Queue one message, kept contiguous so it goes out as one transfer.
+  *         Single writer: Writers is claimed as a flag, so a writer that
+  *         preempts or interleaves with another one is turned away.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  pbuff: message
+  * @param  length: message length, 0 for an empty message (ZLP)
+  * @retval length if queued, 0 if it does not fit or another write is in
+  *         progress
+  */
+static uint32_t  USBD_DCDC_TxWriteMsg(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                      const uint8_t *pbuff, uint32_t length)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t offset;
+  uint32_t pad = 0U;
+  uint32_t msg;
+
+  if ((length > 0xFFFFU) || (USBD_DCDC_AtomicClaim(&q->Writers) == 0U))
+  {
+    return 0U;
+  }
+
+  offset = q->Head & (q->Size - 1U);
+
+  /* Does not fit before the wrap: restart the message at the buffer start */
+  if (length > (q->Size - offset))
+  {
+    pad = q->Size - offset;
+  }
+
+  if (((q->MsgHead - q->MsgTail) >= DCDC_TX_MSGS) ||
+      ((pad + length) > (q->Size - (q->Head - q->Tail))))
+  {
+    q->Writers = 0U;
+    return 0U;
+  }
+
+  /* Single writer: Reserve just follows Head */
+  q->Reserve = q->Head + pad + length;
+
+  if (q->MsgHead == q->MsgTail)
+  {
+    q->Stamp = ((USBD_DCDC_HandleTypeDef *)pdev->pClassData)->Frame;
+  }
+
+  q->Head += pad;
+  (void)memcpy(&q->Buf[q->Head & (q->Size - 1U)], pbuff, length);
+
+  msg = q->MsgHead & (DCDC_TX_MSGS - 1U);
+  q->MsgStart[msg] = q->Head;
+  q->MsgLen[msg] = length;
+
+  q->Head += length;
+  q->MsgHead++;
+  q->Writers = 0U;
+
+  if (cdc->TxState == 0U)
+  {
+    USBD_DCDC_TxHandoff(pdev, cdc);
+  }
+
+  return length;
+}
+
+/**
+  * @brief  USBD_DCDC_TxFree
+  *         Free space of the port TX queue. In message mode, the largest
+  *         message TxWrite accepts now.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @retval number of bytes
+  */
+uint32_t USBD_DCDC_TxFree(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  uint32_t free;
+  uint32_t contig;
+
+  if (q->Buf == NULL)
+  {
+    return 0U;
+  }
+
+  free = q->Size - (q->Reserve - q->Tail);
+
+  if (cdc->MsgMode != 0U)
+  {
+    if ((q->MsgHead - q->MsgTail) >= DCDC_TX_MSGS)
+    {
+      return 0U;
+    }
+
+    /* Before the wrap, or after it once the end is given up as padding */
+    contig = q->Size - (q->Head & (q->Size - 1U));
+    free = (free > contig) ? MAX(contig, free - contig) : free;
+  }
+
+  return free;
+}
+
+/**
+  * @brief  USBD_DCDC_SetTxFlush
+  *         Set the latency budget of the port TX queue. With frames != 0 the
+  *         queue only sends full packets when written; a partial packet is
+  *         sent from SOF after waiting that many frames on an idle endpoint.
+  *         SizeFlushes and TimerFlushes count both cases. Not used in
+  *         message mode.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  frames: 1 ms (FS) frames, 0 sends every write at once
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetTxFlush(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t frames)
+{
+  UNUSED(pdev);
+
+  if (cdc->TxQueue.Buf == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  cdc->TxQueue.Age = 0U;
+  cdc->TxQueue.FlushFrames = frames;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_SetTxWeight
+  *         Give the port a weighted share of the IN frame budget
+  *         (DCDC_SCHED_FS_PACKETS / DCDC_SCHED_HS_PACKETS packets per SOF),
+  *         split among the backlogged weighted ports. Applies to TX queue
+  *         transfers; TransmitPacket and TransmitVec are not scheduled.
+  * @param  pdev: device instance
+  * @param  cdc: port handle, with a TX queue
+  * @param  weight: relative share, 0 leaves the port unscheduled
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetTxWeight(USBD_HandleTypeDef   *pdev,
+                              USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t weight)
+{
+  UNUSED(pdev);
+
+  if (cdc->TxQueue.Buf == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  cdc->TxQueue.Deficit = 0;
+  cdc->TxQueue.Weight = weight;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_SetTxRate
+  *         Cap the port TX queue with a token bucket
+  * @param  pdev: device instance
+  * @param  cdc: port handle, with a TX queue
+  * @param  rate: bytes per frame (FS) or microframe (HS), 0 removes the cap
+  * @param  burst: bucket depth in bytes, at least rate
   * @retval status
   */
-uint8_t  USBD_DCDC_RegisterInterface(USBD_HandleTypeDef   *pdev,
-                                    USBD_DCDC_ItfTypeDef *fops)
+uint8_t  USBD_DCDC_SetTxRate(USBD_HandleTypeDef   *pdev,
+                            USBD_CDC_HandleTypeDef *cdc,
+                            uint32_t rate, uint32_t burst)
 {
-  uint8_t  ret = USBD_FAIL;
+  UNUSED(pdev);
 
-  if (fops != NULL)
+  if ((cdc->TxQueue.Buf == NULL) || (burst < rate) || (burst > 0x7FFFFFFFU))
   {
-    pdev->pUserData = fops;
-    ret = USBD_OK;
+    return USBD_FAIL;
   }
 
-  return ret;
+  cdc->TxQueue.Burst = burst;
+  cdc->TxQueue.Tokens = (int32_t)burst;
+  cdc->TxQueue.Rate = rate;
+
+  return USBD_OK;
 }
 
 /**
-  * @brief  USBD_DCDC_SetTxBuffer
+  * @brief  USBD_DCDC_SetTxExpress
+  *         Make the port the strict priority port: no other port starts a
+  *         TX queue transfer while it has data queued or on the bus. It is
+  *         still subject to its own weight and rate cap.
   * @param  pdev: device instance
-  * @param  pbuff: Tx Buffer
+  * @param  cdc: port handle, NULL for no express port
   * @retval status
   */
-uint8_t  USBD_DCDC_SetTxBuffer(USBD_HandleTypeDef   *pdev,
-                              USBD_CDC_HandleTypeDef *cdc,
-                              uint8_t  *pbuff,
-                              uint16_t length)
+uint8_t  USBD_DCDC_SetTxExpress(USBD_HandleTypeDef   *pdev,
+                               USBD_CDC_HandleTypeDef *cdc)
 {
-  //USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
 
-  cdc->TxBuffer = pbuff;
-  cdc->TxLength = length;
+  if (hDCDC == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  hDCDC->Express = (cdc != NULL) ? cdc->Port : DCDC_NO_PORT;
 
   return USBD_OK;
 }
 
-
 /**
-  * @brief  USBD_DCDC_SetRxBuffer
+  * @brief  USBD_DCDC_SetMsgMode
+  *         Make transfers delimit messages on the port. Call from the
+  *         interface Init callback, after SetRxRing and SetTxQueue.
+  *         OUT: a ring slot receives one whole message, ended by a short
+  *         packet within the slot, so at most the slot size less one byte;
+  *         longer messages, one of exactly the slot size (ended by a ZLP)
+  *         included, are dropped and counted in RxRing.Dropped.
+  *         IN: each TxWrite is one message, queued whole or not at all, and
+  *         always ends with a short packet or ZLP. TransmitPacket and
+  *         TransmitVec already send one message per call.
   * @param  pdev: device instance
-  * @param  pbuff: Rx Buffer
+  * @param  cdc: port handle
+  * @param  enable: 1 for message mode, 0 for a byte stream
   * @retval status
   */
-uint8_t  USBD_DCDC_SetRxBuffer(USBD_HandleTypeDef   *pdev,
-                              USBD_CDC_HandleTypeDef *cdc,
-                              uint8_t  *pbuff)
+uint8_t  USBD_DCDC_SetMsgMode(USBD_HandleTypeDef   *pdev,
+                             USBD_CDC_HandleTypeDef *cdc,
+                             uint8_t enable)
 {
-    // TODO this code sucks...fix this
-  //USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  uint32_t mps;
 
-  cdc->RxBuffer = pbuff;
+  mps = DCDC_DATA_MPS(pdev);
+
+  if ((enable != 0U) && ((cdc->RxRing.Buf == NULL) || (cdc->RxXferSize < (2U * mps))))
+  {
+    return USBD_FAIL;
+  }
+
+  cdc->MsgMode = (enable != 0U) ? 1U : 0U;
 
   return USBD_OK;
 }
 
 /**
   * @brief  USBD_DCDC_TransmitPacket
-  *         Transmit packet on IN endpoint
+  *         Transmit packet on IN endpoint. A transfer is at most 0xFFFF
+  *         bytes, the length USBD_LL_Transmit takes.
   * @param  pdev: device instance
   * @retval status
   */
 uint8_t  USBD_DCDC_TransmitPacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
 {
-  USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
-
-  if (pdev->pClassData != NULL)
+  if ((pdev->pClassData != NULL) && (cdc->TxLength <= 0xFFFFU))
   {
-    if (cdc->TxState == 0U)
+    /* Check and set in one step: task and interrupt may both submit */
+    if (USBD_DCDC_AtomicClaim(&cdc->TxState) != 0U)
     {
-      /* Tx Transfer in progress */
-      cdc->TxState = 1U;
-
       /* Update the packet total length */
-      uint32_t epnum = cdc==&hDCDC->CDC1?DCDC_IN_EP: DCDC_IN_EP2;
-      pdev->ep_in[epnum & 0xFU].total_length = cdc->TxLength;
+      pdev->ep_in[cdc->InEp & 0xFU].total_length = cdc->TxLength;
 
       /* Transmit next packet */
-      USBD_LL_Transmit(pdev, epnum, cdc->TxBuffer,
+      USBD_LL_Transmit(pdev, cdc->InEp, cdc->TxBuffer,
                        (uint16_t)cdc->TxLength);
 
       return USBD_OK;
@@ -1183,35 +3044,193 @@ uint8_t  USBD_DCDC_TransmitPacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeD
 }
 
 
+/**
+  * @brief  USBD_DCDC_TransmitVec
+  *         Transmit a chain of fragments without gathering them first. Only
+  *         bytes of a packet straddling two fragments are copied, and a
+  *         fragment over DCDC_XFER_MAX goes out in several transfers. The
+  *         fragments must stay untouched until the interface TransmitCplt
+  *         callback, which gets Buf == NULL and the chain length.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  iov: fragment array
+  * @param  iovcnt: number of fragments
+  * @retval status
+  */
+uint8_t  USBD_DCDC_TransmitVec(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                              const USBD_DCDC_IoVecTypeDef *iov, uint32_t iovcnt)
+{
+  USBD_DCDC_TxVecTypeDef *v = &cdc->TxVec;
+  uint8_t ret = USBD_OK;
+  uint32_t total = 0U;
+  uint32_t i;
+
+  if ((pdev->pClassData == NULL) || (iov == NULL))
+  {
+    return USBD_FAIL;
+  }
+
+  for (i = 0U; i < iovcnt; i++)
+  {
+    total += iov[i].Len;
+  }
+
+  if (total == 0U)
+  {
+    return USBD_FAIL;
+  }
+
+  /* Queued data goes first; once TxState is claimed, a queue kick waits
+     for the chain to complete */
+  if (((cdc->TxQueue.Buf != NULL) && (cdc->TxQueue.Reserve != cdc->TxQueue.Tail)) ||
+      (USBD_DCDC_AtomicClaim(&cdc->TxState) == 0U))
+  {
+    ret = USBD_BUSY;
+  }
+  else
+  {
+    v->Iov = iov;
+    v->IovCnt = iovcnt;
+    v->Index = 0U;
+    v->Offset = 0U;
+    v->Total = total;
+
+    (void)USBD_DCDC_TxVecNext(pdev, cdc);
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  USBD_DCDC_NotifySerialState
+  *         Post a SERIAL_STATE notification on the port notification
+  *         endpoint. While one is pending, line levels are replaced and the
+  *         event bits (break, ring, framing, parity, overrun) accumulate.
+  *         Callable from task or interrupt context.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  state: CDC_SERIAL_STATE_x bits
+  * @retval status
+  */
+uint8_t  USBD_DCDC_NotifySerialState(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                                    uint16_t state)
+{
+  USBD_DCDC_NotifyTypeDef *n = &cdc->Notify;
+  uint8_t ret = USBD_FAIL;
+
+  DCDC_ENTER_CRITICAL();
+
+  if ((pdev->pClassData != NULL) && (cdc->CmdEp != 0U))
+  {
+    if ((n->Pending & DCDC_NOTIFY_SERIAL_STATE) != 0U)
+    {
+      n->Coalesced++;
+    }
+
+    n->SerialState = (uint16_t)((n->SerialState & CDC_SERIAL_STATE_EVENTS) | state);
+    n->Pending |= DCDC_NOTIFY_SERIAL_STATE;
+
+    USBD_DCDC_NotifyKick(pdev, cdc);
+    ret = USBD_OK;
+  }
+
+  DCDC_EXIT_CRITICAL();
+
+  return ret;
+}
+
+/**
+  * @brief  USBD_DCDC_NotifyEvent
+  *         Post an out-of-band notification on the port notification
+  *         endpoint. A pending notification with the same code is replaced.
+  *         Callable from task or interrupt context.
+  * @param  pdev: device instance
+  * @param  cdc: port handle
+  * @param  notification: bNotification code
+  * @param  value: wValue
+  * @param  pbuff: payload, may be NULL when length is 0
+  * @param  length: payload length, at most DCDC_NOTIFY_DATA_SIZE
+  * @retval USBD_OK, USBD_BUSY while another code is pending, else USBD_FAIL
+  */
+uint8_t  USBD_DCDC_NotifyEvent(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                              uint8_t notification, uint16_t value,
+                              const uint8_t *pbuff, uint16_t length)
+{
+  USBD_DCDC_NotifyTypeDef *n = &cdc->Notify;
+  uint8_t ret = USBD_FAIL;
+  uint16_t i;
+
+  if (length > DCDC_NOTIFY_DATA_SIZE)
+  {
+    return USBD_FAIL;
+  }
+
+  DCDC_ENTER_CRITICAL();
+
+  if ((pdev->pClassData != NULL) && (cdc->CmdEp != 0U))
+  {
+    if (((n->Pending & DCDC_NOTIFY_EVENT) != 0U) && (n->Event != notification))
+    {
+      ret = USBD_BUSY;
+    }
+    else
+    {
+      if ((n->Pending & DCDC_NOTIFY_EVENT) != 0U)
+      {
+        n->Coalesced++;
+      }
+
+      n->Event = notification;
+      n->EventValue = value;
+      n->EventLen = (uint8_t)length;
+
+      for (i = 0U; i < length; i++)
+      {
+        n->EventData[i] = pbuff[i];
+      }
+
+      n->Pending |= DCDC_NOTIFY_EVENT;
+
+      USBD_DCDC_NotifyKick(pdev, cdc);
+      ret = USBD_OK;
+    }
+  }
+
+  DCDC_EXIT_CRITICAL();
+
+  return ret;
+}
+
 /**
   * @brief  USBD_DCDC_ReceivePacket
-  *         prepare OUT Endpoint for reception
+  *         prepare OUT Endpoint for reception of up to RxXferSize bytes
   * @param  pdev: device instance
   * @retval status
   */
 uint8_t  USBD_DCDC_ReceivePacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
 {
-  USBD_DCDC_HandleTypeDef   *hDCDC = (USBD_DCDC_HandleTypeDef *) pdev->pClassData;
+  uint8_t *buf = cdc->RxBuffer;
+  uint32_t len = cdc->RxXferSize;
 
   /* Suspend or Resume USB Out process */
   if (pdev->pClassData != NULL)
   {
-    if (pdev->dev_speed == USBD_SPEED_HIGH)
-    {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-                             cdc==&hDCDC->CDC1? DCDC_OUT_EP: DCDC_OUT_EP2,
-                             cdc->RxBuffer,
-                             DCDC_DATA_HS_OUT_PACKET_SIZE);
-    }
-    else
+    cdc->RxPartial = 0U;
+    cdc->RxIdle = 0U;
+    cdc->RxState = 1U;
+
+    if (cdc->Cut.Peer != DCDC_NO_PORT)
     {
-      /* Prepare Out endpoint to receive next packet */
-      USBD_LL_PrepareReceive(pdev,
-                             cdc==&hDCDC->CDC1? DCDC_OUT_EP: DCDC_OUT_EP2,
-                             cdc->RxBuffer,
-                             DCDC_DATA_FS_OUT_PACKET_SIZE);
+      /* Cut-through: one packet, left in its PMA buffer */
+      buf = NULL;
+      len = DCDC_DATA_MPS(pdev);
     }
+
+    /* Prepare Out endpoint to receive the next transfer */
+    USBD_LL_PrepareReceive(pdev,
+                           cdc->OutEp,
+                           buf,
+                           (uint16_t)len);
     return USBD_OK;
   }
   else
@@ -1219,6 +3238,285 @@ uint8_t  USBD_DCDC_ReceivePacket(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDe
     return USBD_FAIL;
   }
 }
+
+/**
+  * @brief  USBD_DCDC_SetPortCount
+  *         Ask for a configuration with the first ports ports only. The
+  *         switch is done by USBD_DCDC_Process: soft disconnect, then
+  *         re-enumeration with the new descriptors. Also called for the
+  *         DCDC_REQ_SET_PORT_COUNT vendor request. Before USBD_Start, it
+  *         sets the port count of the first enumeration.
+  * @param  pdev: device instance
+  * @param  ports: 1 to DCDC_NUM_PORTS
+  * @retval status
+  */
+uint8_t  USBD_DCDC_SetPortCount(USBD_HandleTypeDef *pdev, uint8_t ports)
+{
+  if ((ports == 0U) || (ports > DCDC_NUM_PORTS))
+  {
+    return USBD_FAIL;
+  }
+
+  if (pdev->dev_state == USBD_STATE_DEFAULT)
+  {
+    /* Not enumerated yet: nothing to disconnect */
+    DCDC_PortCount = ports;
+    return USBD_OK;
+  }
+
+  DCDC_Reenum.Start = USBD_LL_GetTick();
+  DCDC_Reenum.Tick = DCDC_Reenum.Start;
+  DCDC_Reenum.Request = ports;
+  USBD_DCDC_ProcessCallback(pdev);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_GetPortCount
+  *         Ports of the configuration the host sees
+  * @retval port count
+  */
+uint8_t  USBD_DCDC_GetPortCount(void)
+{
+  return DCDC_PortCount;
+}
+
+/**
+  * @brief  USBD_DCDC_Process
+  *         Carry out a port count request. Call from thread context when
+  *         USBD_DCDC_ProcessCallback signals work, and again once the time
+  *         returned has passed; it never blocks. The status stage of the
+  *         request gets DCDC_REENUM_ACK_MS, then D+ is released for
+  *         DCDC_REENUM_OFF_MS and the host re-enumerates on reconnection.
+  *         USBD_DCDC_ReenumStats records the time from the request to the
+  *         host configuring the new layout, which is also logged here.
+  * @param  pdev: device instance
+  * @retval ms until the next call is due, DCDC_PROCESS_IDLE if none
+  */
+uint32_t USBD_DCDC_Process(USBD_HandleTypeDef *pdev)
+{
+  uint32_t now = USBD_LL_GetTick();
+  uint32_t elapsed;
+  uint8_t ports;
+
+  if (DCDC_Reenum.Logged != USBD_DCDC_ReenumStats.Switches)
+  {
+    DCDC_Reenum.Logged = USBD_DCDC_ReenumStats.Switches;
+    USBD_UsrLog("DCDC: %u port layout configured %lu ms after the request",
+                DCDC_PortCount, (unsigned long)USBD_DCDC_ReenumStats.LastMs);
+  }
+
+  elapsed = now - DCDC_Reenum.Tick;
+
+  if (DCDC_Reenum.State == DCDC_REENUM_OFF)
+  {
+    if (elapsed < DCDC_REENUM_OFF_MS)
+    {
+      return DCDC_REENUM_OFF_MS - elapsed;
+    }
+
+    DCDC_PortCount = DCDC_Reenum.Target;
+    DCDC_Reenum.State = DCDC_REENUM_IDLE;
+    (void)USBD_LL_Connect(pdev, 1U);
+
+    /* A request made meanwhile waits for the next call */
+    return (DCDC_Reenum.Request != 0U) ? DCDC_REENUM_ACK_MS : DCDC_PROCESS_IDLE;
+  }
+
+  if (DCDC_Reenum.Request == 0U)
+  {
+    return DCDC_PROCESS_IDLE;
+  }
+
+  if (elapsed < DCDC_REENUM_ACK_MS)
+  {
+    return DCDC_REENUM_ACK_MS - elapsed;
+  }
+
+  DCDC_ENTER_CRITICAL();
+  ports = DCDC_Reenum.Request;
+  DCDC_Reenum.Request = 0U;
+  DCDC_EXIT_CRITICAL();
+
+  if (ports == DCDC_PortCount)
+  {
+    return DCDC_PROCESS_IDLE;
+  }
+
+  DCDC_Reenum.Target = ports;
+  DCDC_Reenum.Measuring = 1U;
+  DCDC_Reenum.Tick = now;
+  DCDC_Reenum.State = DCDC_REENUM_OFF;
+  (void)USBD_LL_Connect(pdev, 0U);
+
+  return DCDC_REENUM_OFF_MS;
+}
+
+/**
+  * @brief  USBD_DCDC_ProcessCallback
+  *         USBD_DCDC_Process has work: a port count request, or a switch
+  *         the host configured, to be logged. Called from the USB interrupt,
+  *         or from the thread calling USBD_DCDC_SetPortCount. Override it to
+  *         wake the thread that runs USBD_DCDC_Process.
+  * @param  pdev: device instance
+  * @retval None
+  */
+__weak void  USBD_DCDC_ProcessCallback(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+}
+
+#if (DCDC_DEFERRED != 0U)
+/**
+  * @brief  USBD_DCDC_EventPost
+  *         Queue a data endpoint completion for USBD_DCDC_EventRun. Called
+  *         by the PCD callbacks of the USB interrupts in place of DataIn and
+  *         DataOut, and by USBD_DCDC_SOF for the pipe SOF work; never
+  *         blocks. The endpoint stays idle until the event has run, so one
+  *         slot per endpoint and direction, plus one per pipe, is enough.
+  *         A queued OUT completion moves the port RxState to 2, which keeps
+  *         USBD_DCDC_RxFlush off the finished transfer.
+  * @param  pdev: device instance
+  * @param  ep_addr: endpoint address, direction bit set for IN, or
+  *         DCDC_EVENT_PORT ORed with the pipe index
+  * @retval USBD_OK if queued, else USBD_FAIL
+  */
+uint8_t  USBD_DCDC_EventPost(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_DCDC_EventQueueTypeDef *q;
+  uint8_t port;
+
+  if (hDCDC == NULL)
+  {
+    return USBD_FAIL;
+  }
+
+  q = &hDCDC->Events;
+
+  if ((uint8_t)(q->Head - q->Tail) >= DCDC_EVENT_QUEUE_SIZE)
+  {
+    return USBD_FAIL;
+  }
+
+  if ((ep_addr & (0x80U | DCDC_EVENT_PORT)) == 0U)
+  {
+    port = hDCDC->EpPort[ep_addr & 0xFU];
+
+    if ((port != DCDC_NO_PORT) && (hDCDC->CDC[port].OutEp == ep_addr))
+    {
+      hDCDC->CDC[port].RxState = 2U;
+    }
+  }
+
+  q->Ep[q->Head & (DCDC_EVENT_QUEUE_SIZE - 1U)] = ep_addr;
+  __DMB();
+  q->Head++;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_EventPending
+  *         Tell whether events wait for USBD_DCDC_EventRun
+  * @param  pdev: device instance
+  * @retval 1 if the queue is not empty, else 0
+  */
+uint8_t  USBD_DCDC_EventPending(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+
+  return ((hDCDC != NULL) && (hDCDC->Events.Head != hDCDC->Events.Tail)) ? 1U : 0U;
+}
+
+/**
+  * @brief  USBD_DCDC_EventRun
+  *         Run the data endpoint and pipe SOF events queued by
+  *         USBD_DCDC_EventPost, so the class and the application Receive and
+  *         TransmitCplt callbacks execute in the calling task. Each event runs with the USB
+  *         interrupts masked (USBD_LL_MaskIrq), other interrupts stay live.
+  *         Call from the task notified by the interrupt.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void  USBD_DCDC_EventRun(USBD_HandleTypeDef *pdev)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC;
+  USBD_DCDC_EventQueueTypeDef *q;
+  uint8_t ep_addr;
+
+  for (;;)
+  {
+    (void)USBD_LL_MaskIrq(pdev, 1U);
+
+    /* Re-read under the mask: a reset or SET_CONFIGURATION may have
+       replaced the class data since the last event */
+    hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+
+    if ((hDCDC == NULL) || (hDCDC->Events.Head == hDCDC->Events.Tail))
+    {
+      (void)USBD_LL_MaskIrq(pdev, 0U);
+      return;
+    }
+
+    q = &hDCDC->Events;
+    ep_addr = q->Ep[q->Tail & (DCDC_EVENT_QUEUE_SIZE - 1U)];
+    q->Tail++;
+
+    if ((ep_addr & DCDC_EVENT_PORT) != 0U)
+    {
+      ep_addr &= (uint8_t)~DCDC_EVENT_PORT;
+      q->PortQueued &= ~(1UL << ep_addr);
+
+      if (pdev->dev_state == USBD_STATE_CONFIGURED)
+      {
+        USBD_DCDC_PortSof(pdev, &hDCDC->CDC[ep_addr]);
+      }
+    }
+    else if (pdev->dev_state == USBD_STATE_CONFIGURED)
+    {
+      if ((ep_addr & 0x80U) != 0U)
+      {
+        (void)USBD_DCDC_DataIn(pdev, ep_addr & 0x7FU);
+      }
+      else
+      {
+        (void)USBD_DCDC_DataOut(pdev, ep_addr);
+      }
+    }
+
+    (void)USBD_LL_MaskIrq(pdev, 0U);
+  }
+}
+#endif /* DCDC_DEFERRED */
+
+/**
+  * @brief  USBD_DCDC_IsrProfile
+  *         Account one USB interrupt in USBD_DCDC_IsrStats. Called by the
+  *         interrupt handler with its duration when DCDC_ISR_PROFILE is set.
+  *         Each handler is counted on its own: the USB handlers that
+  *         preempt another one (USB_HP, the PMA DMA) are left out of its
+  *         duration. Other interrupts nested in it are not.
+  * @param  cycles: CPU cycles spent in the handler, less nested USB handlers
+  * @retval None
+  */
+void  USBD_DCDC_IsrProfile(uint32_t cycles)
+{
+  uint32_t bucket;
+  uint32_t n = cycles >> DCDC_ISR_HIST_SHIFT;
+
+  for (bucket = 0U; (n != 0U) && (bucket < (DCDC_ISR_HIST_BUCKETS - 1U)); bucket++)
+  {
+    n >>= 1;
+  }
+  USBD_DCDC_IsrStats.Hist[bucket]++;
+
+  if (cycles > USBD_DCDC_IsrStats.MaxCycles)
+  {
+    USBD_DCDC_IsrStats.MaxCycles = cycles;
+  }
+}
 /**
   * @}
   */
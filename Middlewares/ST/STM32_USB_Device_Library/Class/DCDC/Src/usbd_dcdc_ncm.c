@@ -0,0 +1,540 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dcdc_ncm.c
+  * @brief   CDC-NCM network function of the DCDC class.
+  *
+  *  @verbatim
+  *
+  *          ===================================================================
+  *                                NCM Function Description
+  *          ===================================================================
+  *           This module implements the "Universal Serial Bus Communications
+  *           Class Subclass Specification for Network Control Model Devices
+  *           Revision 1.0" on the DCDC_NCM_PORT pipe of the DCDC class:
+  *             - NCM class requests: NTB parameters, NTB input size and
+  *               packet filter (all frames are delivered)
+  *             - Data interface alternate settings 0 (no endpoints) and 1
+  *             - NETWORK_CONNECTION and CONNECTION_SPEED_CHANGE notifications
+  *             - IN: datagrams are aggregated into NTB16 blocks, one bulk
+  *               transfer each. Two NTB buffers alternate: one is built while
+  *               the other is on the bus, so datagrams queued during a
+  *               transfer leave together once it completes.
+  *             - OUT: each NTB arrives as one transfer in a slot of the pipe
+  *               RX ring (message mode), for the application to parse.
+  *           The host MAC address is reported through a string descriptor.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "../Inc/usbd_dcdc_ncm.h"
+#include "usbd_ctlreq.h"
+
+#if (DCDC_NCM_ENABLE != 0U)
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup usbd_DCDC_NCM
+  * @brief CDC-NCM network function of the DCDC class
+  * @{
+  */
+
+/** @defgroup usbd_DCDC_NCM_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  NCM_NtbBuilderTypeDef Builder;                           /* NTB being filled */
+  uint32_t Ntb[2][DCDC_NCM_NTB_IN_SIZE / 4U];              /* Built and in-flight NTBs */
+  uint32_t Ring[(DCDC_RX_SLOTS * DCDC_NCM_NTB_OUT_SIZE) / 4U];
+  uint32_t Ctl[28U / 4U];                                  /* EP0 data stage */
+  uint8_t  StrDesc[2U + (2U * (sizeof(DCDC_NCM_HOST_MAC) - 1U))];
+  uint32_t NtbInSize;                                      /* dwNtbInMaxSize set by the host */
+  uint16_t Seq;                                            /* wSequence of the next NTB */
+  uint8_t  Fill;                                           /* Ntb[] buffer being filled */
+  uint8_t  Alt;                                            /* Data interface alternate setting */
+  uint8_t  Age;                                            /* Frames the NTB being filled has waited */
+  uint8_t  ConnPending;                                    /* NETWORK_CONNECTION still to post */
+} USBD_NCM_StateTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Private_Variables
+  * @{
+  */
+static USBD_NCM_StateTypeDef NCM_State;
+
+USBD_NCM_StatsTypeDef USBD_NCM_Stats;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_NCM_NtbReset
+  *         Start an empty NTB in the buffer that is not on the bus. Ends one
+  *         alignment unit short of dwNtbInMaxSize so a full NTB still ends
+  *         on a short packet or ZLP.
+  * @param  None
+  * @retval None
+  */
+static void  USBD_NCM_NtbReset(void)
+{
+  NCM_NtbInit(&NCM_State.Builder, (uint8_t *)(void *)NCM_State.Ntb[NCM_State.Fill],
+              NCM_State.NtbInSize - NCM_NTB_ALIGN, NCM_State.Seq);
+  NCM_State.Age = 0U;
+}
+
+/**
+  * @brief  USBD_NCM_SetAlt
+  *         Select the data interface alternate setting. Alternate setting 1
+  *         opens the bulk pair with reset state and announces the link.
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @param  alt: 0 or 1
+  * @retval None
+  */
+static void  USBD_NCM_SetAlt(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc, uint8_t alt)
+{
+  uint32_t speed[2];
+  uint16_t mps;
+
+  mps = DCDC_DATA_MPS(pdev);
+
+  if (NCM_State.Alt != 0U)
+  {
+    USBD_LL_CloseEP(pdev, DCDC_NCM_IN_EP);
+    pdev->ep_in[DCDC_NCM_IN_EP & 0xFU].is_used = 0U;
+
+    USBD_LL_CloseEP(pdev, DCDC_NCM_OUT_EP);
+    pdev->ep_out[DCDC_NCM_OUT_EP & 0xFU].is_used = 0U;
+  }
+
+  cdc->TxState = 0U;
+  cdc->RxState = 0U;
+  NCM_State.Alt = alt;
+  NCM_State.ConnPending = 0U;
+
+  if (alt == 0U)
+  {
+    return;
+  }
+
+  USBD_LL_OpenEP(pdev, DCDC_NCM_IN_EP, USBD_EP_TYPE_BULK, mps);
+  pdev->ep_in[DCDC_NCM_IN_EP & 0xFU].is_used = 1U;
+
+  USBD_LL_OpenEP(pdev, DCDC_NCM_OUT_EP, USBD_EP_TYPE_BULK, mps);
+  pdev->ep_out[DCDC_NCM_OUT_EP & 0xFU].is_used = 1U;
+
+  /* Datagrams left from a previous session are dropped */
+  (void)USBD_DCDC_SetRxRing(pdev, cdc, (uint8_t *)(void *)NCM_State.Ring, DCDC_NCM_NTB_OUT_SIZE);
+  NCM_State.Fill = 0U;
+  USBD_NCM_NtbReset();
+
+  (void)USBD_DCDC_ReceivePacket(pdev, cdc);
+
+  /* Bus speed both ways, then the link goes up from SOF */
+  speed[0] = (DCDC_IS_HS(pdev) != 0U) ? 480000000U : 12000000U;
+  speed[1] = speed[0];
+  (void)USBD_DCDC_NotifyEvent(pdev, cdc, CDC_NOTIFY_CONNECTION_SPEED_CHANGE, 0U,
+                              (const uint8_t *)(void *)speed, 8U);
+  NCM_State.ConnPending = 1U;
+}
+
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_NCM_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_NCM_Init
+  *         Reset the NCM function; called by the class Init before the
+  *         interface Init callback. The data interface starts in alternate
+  *         setting 0.
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @retval status
+  */
+uint8_t  USBD_NCM_Init(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  NCM_State.Alt = 0U;
+  NCM_State.ConnPending = 0U;
+  NCM_State.Seq = 0U;
+  NCM_State.Fill = 0U;
+  NCM_State.NtbInSize = DCDC_NCM_NTB_IN_SIZE;
+  USBD_NCM_NtbReset();
+
+  if (USBD_DCDC_SetRxRing(pdev, cdc, (uint8_t *)(void *)NCM_State.Ring,
+                          DCDC_NCM_NTB_OUT_SIZE) != USBD_OK)
+  {
+    return USBD_FAIL;
+  }
+
+  /* One NTB per transfer, ended by a short packet or ZLP */
+  return USBD_DCDC_SetMsgMode(pdev, cdc, 1U);
+}
+
+/**
+  * @brief  USBD_NCM_Setup
+  *         Handle the requests addressed to the NCM interfaces
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @param  req: usb request
+  * @retval status
+  */
+uint8_t  USBD_NCM_Setup(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc,
+                        USBD_SetupReqTypedef *req)
+{
+  uint8_t *ctl = (uint8_t *)(void *)NCM_State.Ctl;
+  uint8_t data_itf = (LOBYTE(req->wIndex) == (cdc->Itf + 1U)) ? 1U : 0U;
+  uint16_t status_info = 0U;
+  uint32_t mps;
+  uint8_t ifalt;
+  uint8_t ret = USBD_OK;
+
+  mps = DCDC_DATA_MPS(pdev);
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_CLASS :
+      switch (req->bRequest)
+      {
+        case NCM_GET_NTB_PARAMETERS:
+          /* wLength, bmNtbFormatsSupported: NTB16 only */
+          ctl[0] = 28U;
+          ctl[1] = 0U;
+          ctl[2] = 0x01U;
+          ctl[3] = 0U;
+          /* IN: dwNtbInMaxSize, wNdpInDivisor, wNdpInPayloadRemainder,
+             wNdpInAlignment, wReserved */
+          ctl[4] = LOBYTE(DCDC_NCM_NTB_IN_SIZE);
+          ctl[5] = HIBYTE(DCDC_NCM_NTB_IN_SIZE);
+          ctl[6] = 0U;
+          ctl[7] = 0U;
+          ctl[8] = NCM_NTB_ALIGN;
+          ctl[9] = 0U;
+          ctl[10] = 0U;
+          ctl[11] = 0U;
+          ctl[12] = NCM_NTB_ALIGN;
+          ctl[13] = 0U;
+          ctl[14] = 0U;
+          ctl[15] = 0U;
+          /* OUT: dwNtbOutMaxSize one packet below the transfer size, so an
+             NTB always ends on a short packet; wNtbOutMaxDatagrams: any */
+          ctl[16] = LOBYTE(cdc->RxXferSize - mps);
+          ctl[17] = HIBYTE(cdc->RxXferSize - mps);
+          ctl[18] = 0U;
+          ctl[19] = 0U;
+          ctl[20] = NCM_NTB_ALIGN;
+          ctl[21] = 0U;
+          ctl[22] = 0U;
+          ctl[23] = 0U;
+          ctl[24] = NCM_NTB_ALIGN;
+          ctl[25] = 0U;
+          ctl[26] = 0U;
+          ctl[27] = 0U;
+          USBD_CtlSendData(pdev, ctl, MIN(req->wLength, 28U));
+          break;
+
+        case NCM_GET_NTB_INPUT_SIZE:
+          ctl[0] = (uint8_t)NCM_State.NtbInSize;
+          ctl[1] = (uint8_t)(NCM_State.NtbInSize >> 8);
+          ctl[2] = 0U;
+          ctl[3] = 0U;
+          USBD_CtlSendData(pdev, ctl, MIN(req->wLength, 4U));
+          break;
+
+        case NCM_SET_NTB_INPUT_SIZE:
+          if (req->wLength != 4U)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+            break;
+          }
+          cdc->CmdOpCode = req->bRequest;
+          USBD_CtlPrepareRx(pdev, ctl, 4U);
+          break;
+
+        case NCM_SET_ETHERNET_PACKET_FILTER:
+          /* No filtering: every frame goes to the host */
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
+    case USB_REQ_TYPE_STANDARD:
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+          USBD_CtlSendData(pdev, (uint8_t *)(void *)&status_info, 2U);
+          break;
+
+        case USB_REQ_GET_INTERFACE:
+          ifalt = (data_itf != 0U) ? NCM_State.Alt : 0U;
+          ctl[0] = ifalt;
+          USBD_CtlSendData(pdev, ctl, 1U);
+          break;
+
+        case USB_REQ_SET_INTERFACE:
+          ifalt = (uint8_t)req->wValue;
+
+          if ((pdev->dev_state != USBD_STATE_CONFIGURED) ||
+              (ifalt > data_itf) || (req->wValue > 0xFFU))
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          else if (data_itf != 0U)
+          {
+            USBD_NCM_SetAlt(pdev, cdc, ifalt);
+          }
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+      break;
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  USBD_NCM_EP0_RxReady
+  *         Apply the data stage of a SET_NTB_INPUT_SIZE request. Sizes the
+  *         NTB buffers cannot hold are ignored; the new size applies from
+  *         the next NTB.
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @retval None
+  */
+void  USBD_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  const uint8_t *ctl = (const uint8_t *)(void *)NCM_State.Ctl;
+  uint32_t size;
+
+  UNUSED(pdev);
+
+  if (cdc->CmdOpCode == NCM_SET_NTB_INPUT_SIZE)
+  {
+    size = (uint32_t)ctl[0] | ((uint32_t)ctl[1] << 8) | ((uint32_t)ctl[2] << 16) | ((uint32_t)ctl[3] << 24);
+
+    if ((size >= 2048U) && (size <= DCDC_NCM_NTB_IN_SIZE))
+    {
+      NCM_State.NtbInSize = size & ~(NCM_NTB_ALIGN - 1U);
+    }
+  }
+  cdc->CmdOpCode = 0xFFU;
+}
+
+/**
+  * @brief  USBD_NCM_TxKick
+  *         Send the NTB being filled if the IN endpoint is idle, and start
+  *         the next one in the other buffer. Called from the USB interrupt or
+  *         with interrupts masked.
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @retval None
+  */
+void  USBD_NCM_TxKick(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  NCM_NtbBuilderTypeDef *b = &NCM_State.Builder;
+
+  if ((NCM_State.Alt == 0U) || (cdc->TxState != 0U) || (b->Count == 0U))
+  {
+    return;
+  }
+
+  cdc->TxLength = NCM_NtbFinish(b);
+  cdc->TxBuffer = b->Buf;
+  USBD_NCM_Stats.TxNtbs++;
+
+  NCM_State.Fill ^= 1U;
+  NCM_State.Seq++;
+  USBD_NCM_NtbReset();
+
+  (void)USBD_DCDC_TransmitPacket(pdev, cdc);
+}
+
+/**
+  * @brief  USBD_NCM_SofDue
+  *         Frame accounting of the NCM pipe, called on each SOF. The work it
+  *         reports is run by USBD_NCM_SofRun
+  * @param  cdc: NCM pipe handle
+  * @retval 1 if USBD_NCM_SofRun has something to do, else 0
+  */
+uint8_t  USBD_NCM_SofDue(USBD_CDC_HandleTypeDef *cdc)
+{
+  if (NCM_State.Alt == 0U)
+  {
+    return 0U;
+  }
+
+  if ((NCM_State.Builder.Count == 0U) || (cdc->TxState != 0U))
+  {
+    return NCM_State.ConnPending;
+  }
+
+  if (NCM_State.Age < DCDC_NCM_FLUSH_FRAMES)
+  {
+    NCM_State.Age++;
+  }
+
+  return ((NCM_State.ConnPending != 0U) || (NCM_State.Age >= DCDC_NCM_FLUSH_FRAMES)) ? 1U : 0U;
+}
+
+/**
+  * @brief  USBD_NCM_SofRun
+  *         Post NETWORK_CONNECTION once the notification endpoint takes it,
+  *         and send a partly filled NTB after DCDC_NCM_FLUSH_FRAMES frames
+  * @param  pdev: device instance
+  * @param  cdc: NCM pipe handle
+  * @retval None
+  */
+void  USBD_NCM_SofRun(USBD_HandleTypeDef *pdev, USBD_CDC_HandleTypeDef *cdc)
+{
+  if (NCM_State.Alt == 0U)
+  {
+    return;
+  }
+
+  if ((NCM_State.ConnPending != 0U) &&
+      (USBD_DCDC_NotifyEvent(pdev, cdc, CDC_NOTIFY_NETWORK_CONNECTION, 1U, NULL, 0U) == USBD_OK))
+  {
+    NCM_State.ConnPending = 0U;
+  }
+
+  if ((NCM_State.Builder.Count != 0U) && (cdc->TxState == 0U) &&
+      (NCM_State.Age >= DCDC_NCM_FLUSH_FRAMES))
+  {
+    USBD_NCM_TxKick(pdev, cdc);
+  }
+}
+
+/**
+  * @brief  USBD_NCM_GetUsrStrDescriptor
+  *         Return the iMACAddress string
+  * @param  pdev: device instance
+  * @param  index: string index
+  * @param  length: descriptor length
+  * @retval pointer to the descriptor, NULL (request stalled) for other indexes
+  */
+uint8_t  *USBD_NCM_GetUsrStrDescriptor(USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length)
+{
+  *length = 0U;
+
+  if (index != DCDC_NCM_MAC_STR_IDX)
+  {
+    USBD_CtlError(pdev, &pdev->request);
+    return NULL;
+  }
+
+  USBD_GetString((uint8_t *)DCDC_NCM_HOST_MAC, NCM_State.StrDesc, length);
+
+  return NCM_State.StrDesc;
+}
+
+/**
+  * @brief  USBD_NCM_Transmit
+  *         Queue one Ethernet frame for the host. It joins the NTB being
+  *         filled, which leaves when the IN endpoint frees up, when it is
+  *         full, or after DCDC_NCM_FLUSH_FRAMES frames. Callable from task or
+  *         interrupt context.
+  * @param  pdev: device instance
+  * @param  frame: Ethernet frame without FCS
+  * @param  length: frame length, at most DCDC_NCM_MAX_SEGMENT_SIZE
+  * @retval USBD_OK, USBD_BUSY while both NTB buffers are in use, else
+  *         USBD_FAIL (link down or bad length)
+  */
+uint8_t  USBD_NCM_Transmit(USBD_HandleTypeDef *pdev, const uint8_t *frame, uint16_t length)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  USBD_CDC_HandleTypeDef *cdc;
+  uint8_t status;
+  uint8_t ret = USBD_OK;
+
+  if ((length == 0U) || (length > DCDC_NCM_MAX_SEGMENT_SIZE))
+  {
+    return USBD_FAIL;
+  }
+
+  DCDC_ENTER_CRITICAL();
+
+  if ((hDCDC == NULL) || (NCM_State.Alt == 0U))
+  {
+    ret = USBD_FAIL;
+  }
+  else
+  {
+    cdc = &hDCDC->CDC[DCDC_NCM_PORT];
+    status = NCM_NtbAdd(&NCM_State.Builder, frame, length);
+
+    if ((status == NCM_NTB_FULL) && (cdc->TxState == 0U))
+    {
+      /* Send the full NTB and start over in the other buffer */
+      USBD_NCM_TxKick(pdev, cdc);
+      status = NCM_NtbAdd(&NCM_State.Builder, frame, length);
+    }
+
+    if (status != NCM_NTB_OK)
+    {
+      USBD_NCM_Stats.TxFull++;
+      ret = USBD_BUSY;
+    }
+    else
+    {
+      USBD_NCM_Stats.TxDatagrams++;
+
+      if (DCDC_NCM_FLUSH_FRAMES == 0U)
+      {
+        USBD_NCM_TxKick(pdev, cdc);
+      }
+    }
+  }
+
+  DCDC_EXIT_CRITICAL();
+
+  return ret;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#endif /* DCDC_NCM_ENABLE */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,533 @@
+/**
+  ******************************************************************************
+  * @file    usbd_dcdc_regs.c
+  * @brief   Vendor register map of the DCDC class.
+  *
+  *  @verbatim
+  *
+  *          ===================================================================
+  *                                Register Map Description
+  *          ===================================================================
+  *           Two vendor device requests move runs of consecutive registers
+  *           over EP0:
+  *             - DCDC_REQ_READ_REGS (IN): wValue first register, wLength
+  *               4 * count bytes
+  *             - DCDC_REQ_WRITE_REGS (OUT): same, the data stage carries the
+  *               values
+  *           A burst is at most DCDC_REG_MAX_BURST registers. Each register
+  *           has a type and an access right in the block tables: plain
+  *           fields of the class and pipe handles are read in place, the
+  *           others are computed. Writes go through the USBD_DCDC_SetTxXxx
+  *           setters, so the register map enforces the same limits as the
+  *           application API; a write whose range holds a read only or
+  *           unmapped register is stalled in the setup stage, and a value a
+  *           setter refuses is counted in DCDC_REG_WRITE_ERRORS.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "../Inc/usbd_dcdc_regs.h"
+#include "../Inc/usbd_dcdc_ncm.h"
+#include "usbd_ctlreq.h"
+#include <stddef.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup usbd_DCDC_REGS
+  * @brief Vendor register map of the DCDC class
+  * @{
+  */
+
+/** @defgroup usbd_DCDC_REGS_Private_TypesDefinitions
+  * @{
+  */
+typedef struct
+{
+  uint16_t Field;                                          /* Offset in the class or pipe handle */
+  uint8_t  Type;                                           /* DCDC_REG_NONE ... DCDC_REG_CALC */
+  uint8_t  Access;                                         /* DCDC_REG_RO or DCDC_REG_RW */
+} DCDC_RegDefTypeDef;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Private_Defines
+  * @{
+  */
+#define DCDC_REG_NONE                                0U  /* Unmapped, reads as 0 */
+#define DCDC_REG_U8                                  1U
+#define DCDC_REG_U16                                 2U
+#define DCDC_REG_U32                                 3U
+#define DCDC_REG_CALC                                4U  /* Computed on read */
+
+#define DCDC_REG_RO                                  0U
+#define DCDC_REG_RW                                  1U
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Private_Macros
+  * @{
+  */
+#define DCDC_REG_CLASS_FIELD(f, t, a)                { (uint16_t)offsetof(USBD_DCDC_HandleTypeDef, f), (t), (a) }
+#define DCDC_REG_PIPE_FIELD(f, t, a)                 { (uint16_t)offsetof(USBD_CDC_HandleTypeDef, f), (t), (a) }
+#define DCDC_REG_COMPUTED(a)                         { 0U, DCDC_REG_CALC, (a) }
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Private_Variables
+  * @{
+  */
+static const DCDC_RegDefTypeDef DCDC_ClassRegs[DCDC_REG_BLOCK_SIZE] =
+{
+  [DCDC_REG_ID]                 = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_PIPES]              = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_PORTS]              = DCDC_REG_CLASS_FIELD(Ports, DCDC_REG_U8, DCDC_REG_RO),
+  [DCDC_REG_FRAME]              = DCDC_REG_CLASS_FIELD(Frame, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_EXPRESS]            = DCDC_REG_CLASS_FIELD(Express, DCDC_REG_U8, DCDC_REG_RW),
+  [DCDC_REG_WRITE_ERRORS]       = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_REENUM_SWITCHES]    = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_REENUM_LAST_MS]     = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_REENUM_MAX_MS]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_NCM_TX_DATAGRAMS]   = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_NCM_TX_NTBS]        = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_NCM_TX_FULL]        = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_MAX_CYCLES]     = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 0U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 1U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 2U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 3U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 4U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 5U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 6U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_ISR_HIST + 7U]      = DCDC_REG_COMPUTED(DCDC_REG_RO),
+};
+
+static const DCDC_RegDefTypeDef DCDC_PipeRegs[DCDC_REG_BLOCK_SIZE] =
+{
+  [DCDC_REG_STATE]              = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_TX_SIZE]            = DCDC_REG_PIPE_FIELD(TxQueue.Size, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_QUEUED]          = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_TX_BYTES]           = DCDC_REG_PIPE_FIELD(TxQueue.Bytes, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_PACKETS]         = DCDC_REG_PIPE_FIELD(TxQueue.Packets, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_SIZE_FLUSHES]    = DCDC_REG_PIPE_FIELD(TxQueue.SizeFlushes, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_TIMER_FLUSHES]   = DCDC_REG_PIPE_FIELD(TxQueue.TimerFlushes, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_DEFERS]          = DCDC_REG_PIPE_FIELD(TxQueue.Defers, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_FLUSH_FRAMES]    = DCDC_REG_PIPE_FIELD(TxQueue.FlushFrames, DCDC_REG_U8, DCDC_REG_RW),
+  [DCDC_REG_TX_WEIGHT]          = DCDC_REG_PIPE_FIELD(TxQueue.Weight, DCDC_REG_U8, DCDC_REG_RW),
+  [DCDC_REG_TX_RATE]            = DCDC_REG_PIPE_FIELD(TxQueue.Rate, DCDC_REG_U32, DCDC_REG_RW),
+  [DCDC_REG_TX_BURST]           = DCDC_REG_PIPE_FIELD(TxQueue.Burst, DCDC_REG_U32, DCDC_REG_RW),
+  [DCDC_REG_TX_LATENCY + 0U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[0], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 1U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[1], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 2U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[2], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 3U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[3], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 4U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[4], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 5U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[5], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 6U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[6], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_TX_LATENCY + 7U]    = DCDC_REG_PIPE_FIELD(TxQueue.Latency[7], DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_RX_PENDING]         = DCDC_REG_COMPUTED(DCDC_REG_RO),
+  [DCDC_REG_RX_DROPPED]         = DCDC_REG_PIPE_FIELD(RxRing.Dropped, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_RX_LOANS]           = DCDC_REG_PIPE_FIELD(RxPool.Loans, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_RX_STARVES]         = DCDC_REG_PIPE_FIELD(RxPool.Starves, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_NOTIFY_SENT]        = DCDC_REG_PIPE_FIELD(Notify.Sent, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_NOTIFY_COALESCED]   = DCDC_REG_PIPE_FIELD(Notify.Coalesced, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_SERIAL_STATE]       = DCDC_REG_PIPE_FIELD(Notify.SerialState, DCDC_REG_U16, DCDC_REG_RO),
+  [DCDC_REG_CUT_FORWARDED]      = DCDC_REG_PIPE_FIELD(Cut.Forwarded, DCDC_REG_U32, DCDC_REG_RO),
+  [DCDC_REG_CUT_WAITS]          = DCDC_REG_PIPE_FIELD(Cut.Waits, DCDC_REG_U32, DCDC_REG_RO),
+};
+
+#if (DCDC_TX_LAT_BUCKETS != 8U)
+#error "DCDC_PipeRegs lists DCDC_TX_LAT_BUCKETS latency registers"
+#endif
+
+#if (DCDC_ISR_HIST_BUCKETS != 8U)
+#error "DCDC_ClassRegs lists DCDC_ISR_HIST_BUCKETS histogram registers"
+#endif
+
+static uint32_t DCDC_RegBuf[DCDC_REG_MAX_BURST];           /* EP0 data stage */
+static uint16_t DCDC_RegFirst;                             /* Write in progress: first register */
+static uint16_t DCDC_RegCount;                             /* Write in progress: registers, 0 if none */
+static uint32_t DCDC_RegWriteErrors;
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_DCDC_RegDef
+  *         Find the definition of a register
+  * @param  reg: register index
+  * @param  pipe: set to the pipe of a pipe register, DCDC_NO_PORT for a
+  *         class register
+  * @retval definition, NULL beyond the map
+  */
+static const DCDC_RegDefTypeDef *USBD_DCDC_RegDef(uint16_t reg, uint8_t *pipe)
+{
+  uint32_t block = (uint32_t)reg / DCDC_REG_BLOCK_SIZE;
+
+  if (block > DCDC_NUM_PIPES)
+  {
+    return NULL;
+  }
+
+  if (block == 0U)
+  {
+    *pipe = DCDC_NO_PORT;
+    return &DCDC_ClassRegs[reg % DCDC_REG_BLOCK_SIZE];
+  }
+
+  *pipe = (uint8_t)(block - 1U);
+  return &DCDC_PipeRegs[reg % DCDC_REG_BLOCK_SIZE];
+}
+
+/**
+  * @brief  USBD_DCDC_RegField
+  *         Read a typed field of a handle
+  * @param  base: class or pipe handle
+  * @param  def: register definition
+  * @retval value, zero extended
+  */
+static uint32_t USBD_DCDC_RegField(const void *base, const DCDC_RegDefTypeDef *def)
+{
+  const uint8_t *p = (const uint8_t *)base + def->Field;
+
+  switch (def->Type)
+  {
+    case DCDC_REG_U8:
+      return *(const __IO uint8_t *)p;
+
+    case DCDC_REG_U16:
+      return *(const __IO uint16_t *)(const void *)p;
+
+    case DCDC_REG_U32:
+      return *(const __IO uint32_t *)(const void *)p;
+
+    default:
+      return 0U;
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_RegCalcClass
+  *         Compute a class register that is not a handle field
+  * @param  reg: register offset in block 0
+  * @retval value
+  */
+static uint32_t USBD_DCDC_RegCalcClass(uint32_t reg)
+{
+  switch (reg)
+  {
+    case DCDC_REG_ID:
+      return DCDC_REG_ID_VALUE;
+
+    case DCDC_REG_PIPES:
+      return DCDC_NUM_PIPES;
+
+    case DCDC_REG_WRITE_ERRORS:
+      return DCDC_RegWriteErrors;
+
+    case DCDC_REG_REENUM_SWITCHES:
+      return USBD_DCDC_ReenumStats.Switches;
+
+    case DCDC_REG_REENUM_LAST_MS:
+      return USBD_DCDC_ReenumStats.LastMs;
+
+    case DCDC_REG_REENUM_MAX_MS:
+      return USBD_DCDC_ReenumStats.MaxMs;
+
+#if (DCDC_NCM_ENABLE != 0U)
+    case DCDC_REG_NCM_TX_DATAGRAMS:
+      return USBD_NCM_Stats.TxDatagrams;
+
+    case DCDC_REG_NCM_TX_NTBS:
+      return USBD_NCM_Stats.TxNtbs;
+
+    case DCDC_REG_NCM_TX_FULL:
+      return USBD_NCM_Stats.TxFull;
+#endif /* DCDC_NCM_ENABLE */
+
+    case DCDC_REG_ISR_MAX_CYCLES:
+      return USBD_DCDC_IsrStats.MaxCycles;
+
+    default:
+      if ((reg >= DCDC_REG_ISR_HIST) && (reg < (DCDC_REG_ISR_HIST + DCDC_ISR_HIST_BUCKETS)))
+      {
+        return USBD_DCDC_IsrStats.Hist[reg - DCDC_REG_ISR_HIST];
+      }
+      return 0U;
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_RegCalcPipe
+  *         Compute a pipe register that is not a handle field
+  * @param  cdc: pipe handle
+  * @param  reg: register offset in the pipe block
+  * @retval value
+  */
+static uint32_t USBD_DCDC_RegCalcPipe(const USBD_CDC_HandleTypeDef *cdc, uint32_t reg)
+{
+  uint32_t state = 0U;
+
+  switch (reg)
+  {
+    case DCDC_REG_STATE:
+      state |= (cdc->TxState != 0U) ? DCDC_REG_STATE_TX_BUSY : 0U;
+      state |= (cdc->RxState != 0U) ? DCDC_REG_STATE_RX_BUSY : 0U;
+      state |= (cdc->MsgMode != 0U) ? DCDC_REG_STATE_MSG_MODE : 0U;
+      state |= (cdc->RxRing.Stalled != 0U) ? DCDC_REG_STATE_RX_STALLED : 0U;
+      state |= (cdc->RxPool.Starved != 0U) ? DCDC_REG_STATE_RX_STARVED : 0U;
+      state |= (cdc->Cut.Held != 0U) ? DCDC_REG_STATE_CUT_HELD : 0U;
+      return state;
+
+    case DCDC_REG_TX_QUEUED:
+      return cdc->TxQueue.Head - cdc->TxQueue.Tail;
+
+    case DCDC_REG_RX_PENDING:
+      return cdc->RxRing.Head - cdc->RxRing.Tail;
+
+    default:
+      return 0U;
+  }
+}
+
+/**
+  * @brief  USBD_DCDC_RegWritable
+  *         Check a run of registers can be written
+  * @param  pdev: device instance
+  * @param  first: first register
+  * @param  count: registers
+  * @retval 1 if all of them are read-write and their pipes exist, else 0
+  */
+static uint8_t USBD_DCDC_RegWritable(USBD_HandleTypeDef *pdev, uint16_t first, uint16_t count)
+{
+  const DCDC_RegDefTypeDef *def;
+  uint32_t reg;
+  uint8_t pipe;
+
+  if (pdev->pClassData == NULL)
+  {
+    return 0U;
+  }
+
+  for (reg = first; reg < ((uint32_t)first + count); reg++)
+  {
+    def = (reg < DCDC_REG_COUNT) ? USBD_DCDC_RegDef((uint16_t)reg, &pipe) : NULL;
+
+    if ((def == NULL) || (def->Access != DCDC_REG_RW))
+    {
+      return 0U;
+    }
+  }
+
+  return 1U;
+}
+
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_DCDC_REGS_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_DCDC_RegSetup
+  *         Handle DCDC_REQ_READ_REGS and DCDC_REQ_WRITE_REGS
+  * @param  pdev: device instance
+  * @param  req: usb request, vendor device recipient
+  * @retval status
+  */
+uint8_t  USBD_DCDC_RegSetup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *req)
+{
+  uint16_t count = req->wLength / 4U;
+  uint16_t i;
+
+  if ((req->wLength == 0U) || ((req->wLength % 4U) != 0U) || (count > DCDC_REG_MAX_BURST))
+  {
+    USBD_CtlError(pdev, req);
+    return USBD_FAIL;
+  }
+
+  if (req->bRequest == DCDC_REQ_READ_REGS)
+  {
+    if ((req->bmRequest & 0x80U) == 0U)
+    {
+      USBD_CtlError(pdev, req);
+      return USBD_FAIL;
+    }
+
+    for (i = 0U; i < count; i++)
+    {
+      DCDC_RegBuf[i] = USBD_DCDC_RegRead(pdev, (uint16_t)(req->wValue + i));
+    }
+
+    (void)USBD_CtlSendData(pdev, (uint8_t *)(void *)DCDC_RegBuf, req->wLength);
+    return USBD_OK;
+  }
+
+  if (((req->bmRequest & 0x80U) != 0U) || (USBD_DCDC_RegWritable(pdev, req->wValue, count) == 0U))
+  {
+    USBD_CtlError(pdev, req);
+    return USBD_FAIL;
+  }
+
+  DCDC_RegFirst = req->wValue;
+  DCDC_RegCount = count;
+  (void)USBD_CtlPrepareRx(pdev, (uint8_t *)(void *)DCDC_RegBuf, req->wLength);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_DCDC_RegRxReady
+  *         Apply the registers of a DCDC_REQ_WRITE_REGS data stage
+  * @param  pdev: device instance
+  * @retval None
+  */
+void  USBD_DCDC_RegRxReady(USBD_HandleTypeDef *pdev)
+{
+  uint16_t i;
+
+  for (i = 0U; i < DCDC_RegCount; i++)
+  {
+    if (USBD_DCDC_RegWrite(pdev, (uint16_t)(DCDC_RegFirst + i), DCDC_RegBuf[i]) != USBD_OK)
+    {
+      DCDC_RegWriteErrors++;
+    }
+  }
+
+  DCDC_RegCount = 0U;
+}
+
+/**
+  * @brief  USBD_DCDC_RegRead
+  *         Read one register. Pipe registers read as 0 while the class is
+  *         not configured.
+  * @param  pdev: device instance
+  * @param  reg: register index
+  * @retval value, 0 for an unmapped register
+  */
+uint32_t  USBD_DCDC_RegRead(USBD_HandleTypeDef *pdev, uint16_t reg)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  const DCDC_RegDefTypeDef *def;
+  uint32_t offset = (uint32_t)reg % DCDC_REG_BLOCK_SIZE;
+  uint8_t pipe = DCDC_NO_PORT;
+
+  def = USBD_DCDC_RegDef(reg, &pipe);
+
+  if ((def == NULL) || (def->Type == DCDC_REG_NONE))
+  {
+    return 0U;
+  }
+
+  if (pipe == DCDC_NO_PORT)
+  {
+    if (def->Type == DCDC_REG_CALC)
+    {
+      return USBD_DCDC_RegCalcClass(offset);
+    }
+    return (hDCDC != NULL) ? USBD_DCDC_RegField(hDCDC, def) : 0U;
+  }
+
+  if (hDCDC == NULL)
+  {
+    return 0U;
+  }
+
+  if (def->Type == DCDC_REG_CALC)
+  {
+    return USBD_DCDC_RegCalcPipe(&hDCDC->CDC[pipe], offset);
+  }
+
+  return USBD_DCDC_RegField(&hDCDC->CDC[pipe], def);
+}
+
+/**
+  * @brief  USBD_DCDC_RegWrite
+  *         Write one read-write register through its setter
+  * @param  pdev: device instance
+  * @param  reg: register index
+  * @param  value: new value
+  * @retval USBD_FAIL if the register is read only or the setter refuses
+  *         the value
+  */
+uint8_t  USBD_DCDC_RegWrite(USBD_HandleTypeDef *pdev, uint16_t reg, uint32_t value)
+{
+  USBD_DCDC_HandleTypeDef *hDCDC = (USBD_DCDC_HandleTypeDef *)pdev->pClassData;
+  const DCDC_RegDefTypeDef *def;
+  USBD_CDC_HandleTypeDef *cdc;
+  uint8_t pipe = DCDC_NO_PORT;
+
+  def = USBD_DCDC_RegDef(reg, &pipe);
+
+  if ((hDCDC == NULL) || (def == NULL) || (def->Access != DCDC_REG_RW) ||
+      ((def->Type == DCDC_REG_U8) && (value > 0xFFU)))
+  {
+    return USBD_FAIL;
+  }
+
+  if (pipe == DCDC_NO_PORT)
+  {
+    /* DCDC_REG_EXPRESS is the only writable class register */
+    if (value == DCDC_NO_PORT)
+    {
+      return USBD_DCDC_SetTxExpress(pdev, NULL);
+    }
+    if (value >= DCDC_NUM_PIPES)
+    {
+      return USBD_FAIL;
+    }
+    return USBD_DCDC_SetTxExpress(pdev, &hDCDC->CDC[value]);
+  }
+
+  cdc = &hDCDC->CDC[pipe];
+
+  switch ((uint32_t)reg % DCDC_REG_BLOCK_SIZE)
+  {
+    case DCDC_REG_TX_FLUSH_FRAMES:
+      return USBD_DCDC_SetTxFlush(pdev, cdc, (uint8_t)value);
+
+    case DCDC_REG_TX_WEIGHT:
+      return USBD_DCDC_SetTxWeight(pdev, cdc, (uint8_t)value);
+
+    case DCDC_REG_TX_RATE:
+      return USBD_DCDC_SetTxRate(pdev, cdc, value, MAX(value, cdc->TxQueue.Burst));
+
+    case DCDC_REG_TX_BURST:
+      return USBD_DCDC_SetTxRate(pdev, cdc, cdc->TxQueue.Rate, value);
+
+    default:
+      return USBD_FAIL;
+  }
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
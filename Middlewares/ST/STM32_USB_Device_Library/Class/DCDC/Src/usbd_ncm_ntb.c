@@ -0,0 +1,310 @@
+/**
+  ******************************************************************************
+  * @file    usbd_ncm_ntb.c
+  * @brief   CDC-NCM NTB16 transfer block builder and parser.
+  *
+  *  @verbatim
+  *
+  *          ===================================================================
+  *                                NTB16 layout
+  *          ===================================================================
+  *           "Universal Serial Bus Communications Class Subclass Specification
+  *           for Network Control Model Devices Revision 1.0", section 3:
+  *             - NTH16 at offset 0: signature, header length, sequence,
+  *               block length and the index of the first NDP16
+  *             - datagrams, each starting on an NCM_NTB_ALIGN boundary
+  *             - NDP16: signature, length, next NDP index, then
+  *               (index, length) pairs ended by a (0, 0) entry
+  *           The builder writes the datagrams first and the single NDP16
+  *           after them once the block is finished. The parser accepts any
+  *           layout a host may send, including chained NDPs.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "../Inc/usbd_ncm_ntb.h"
+#include <string.h>
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup usbd_NCM_NTB
+  * @brief NTB16 transfer block encoding
+  * @{
+  */
+
+/** @defgroup usbd_NCM_NTB_Private_Macros
+  * @{
+  */
+#define NCM_ALIGN_UP(x)            (((x) + (NCM_NTB_ALIGN - 1U)) & ~(NCM_NTB_ALIGN - 1U))
+
+/* NDP16 size for n datagrams plus the terminating entry */
+#define NCM_NDP16_SIZE(n)          (NCM_NDP16_HDR_SIZE + (4U * ((n) + 1U)))
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_NCM_NTB_Private_Functions
+  * @{
+  */
+
+static void  NCM_Put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void  NCM_Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t  NCM_Get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t  NCM_Get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+  * @}
+  */
+
+
+/** @defgroup usbd_NCM_NTB_Exported_Functions
+  * @{
+  */
+
+/**
+  * @brief  NCM_NtbInit
+  *         Start an empty NTB in buf
+  * @param  b: builder
+  * @param  buf: NTB storage
+  * @param  size: NTB size limit (dwNtbInMaxSize), capped to 0xFFFF
+  * @param  seq: wSequence of the NTB
+  * @retval None
+  */
+void  NCM_NtbInit(NCM_NtbBuilderTypeDef *b, uint8_t *buf, uint32_t size, uint16_t seq)
+{
+  b->Buf = buf;
+  b->Size = (size > 0xFFFFU) ? 0xFFFFU : size;
+  b->Len = NCM_NTH16_SIZE;
+  b->Seq = seq;
+  b->Count = 0U;
+}
+
+/**
+  * @brief  NCM_NtbAdd
+  *         Copy one datagram into the NTB, keeping room for the NDP16
+  * @param  b: builder
+  * @param  dg: datagram (Ethernet frame)
+  * @param  len: datagram length, not 0
+  * @retval NCM_NTB_OK, or NCM_NTB_FULL if it does not fit this NTB
+  */
+uint8_t  NCM_NtbAdd(NCM_NtbBuilderTypeDef *b, const uint8_t *dg, uint16_t len)
+{
+  uint32_t index = NCM_ALIGN_UP(b->Len);
+  uint32_t end = index + len;
+
+  if ((len == 0U) || (b->Count >= NCM_NTB_MAX_DATAGRAMS) ||
+      ((NCM_ALIGN_UP(end) + NCM_NDP16_SIZE(b->Count + 1U)) > b->Size))
+  {
+    return NCM_NTB_FULL;
+  }
+
+  /* Zero the alignment gap so no stale bytes go on the wire */
+  (void)memset(&b->Buf[b->Len], 0, index - b->Len);
+  (void)memcpy(&b->Buf[index], dg, len);
+
+  b->Index[b->Count] = (uint16_t)index;
+  b->Length[b->Count] = len;
+  b->Count++;
+  b->Len = end;
+
+  return NCM_NTB_OK;
+}
+
+/**
+  * @brief  NCM_NtbFinish
+  *         Append the NDP16 and fill in the NTH16
+  * @param  b: builder, holding at least one datagram
+  * @retval NTB length in bytes (wBlockLength), 0 if the NTB is empty
+  */
+uint32_t  NCM_NtbFinish(NCM_NtbBuilderTypeDef *b)
+{
+  uint8_t *ndp;
+  uint32_t ndp_index;
+  uint32_t ndp_len;
+  uint32_t total;
+  uint16_t i;
+
+  if (b->Count == 0U)
+  {
+    return 0U;
+  }
+
+  ndp_index = NCM_ALIGN_UP(b->Len);
+  ndp_len = NCM_NDP16_SIZE(b->Count);
+  ndp_len = (ndp_len < NCM_NDP16_MIN_SIZE) ? NCM_NDP16_MIN_SIZE : ndp_len;
+  total = ndp_index + ndp_len;
+
+  (void)memset(&b->Buf[b->Len], 0, ndp_index - b->Len);
+
+  ndp = &b->Buf[ndp_index];
+  NCM_Put32(&ndp[0], NCM_NDP16_SIGNATURE);
+  NCM_Put16(&ndp[4], (uint16_t)ndp_len);
+  NCM_Put16(&ndp[6], 0U);                       /* wNextNdpIndex: single NDP */
+
+  for (i = 0U; i < b->Count; i++)
+  {
+    NCM_Put16(&ndp[8U + (4U * i)], b->Index[i]);
+    NCM_Put16(&ndp[10U + (4U * i)], b->Length[i]);
+  }
+  (void)memset(&ndp[8U + (4U * b->Count)], 0, ndp_len - (8U + (4U * b->Count)));
+
+  NCM_Put32(&b->Buf[0], NCM_NTH16_SIGNATURE);
+  NCM_Put16(&b->Buf[4], NCM_NTH16_SIZE);
+  NCM_Put16(&b->Buf[6], b->Seq);
+  NCM_Put16(&b->Buf[8], (uint16_t)total);
+  NCM_Put16(&b->Buf[10], (uint16_t)ndp_index);
+
+  return total;
+}
+
+/**
+  * @brief  NCM_NtbOpen
+  *         Validate the NTH16 of a received NTB and position on its first NDP
+  * @param  r: reader
+  * @param  ntb: received transfer
+  * @param  len: received length
+  * @retval NCM_NTB_OK or NCM_NTB_ERROR
+  */
+uint8_t  NCM_NtbOpen(NCM_NtbReaderTypeDef *r, const uint8_t *ntb, uint32_t len)
+{
+  uint32_t block;
+  uint32_t ndp;
+
+  r->Ndp = 0U;
+  r->Entry = 0U;
+
+  if ((len < NCM_NTH16_SIZE) || (NCM_Get32(&ntb[0]) != NCM_NTH16_SIGNATURE) ||
+      (NCM_Get16(&ntb[4]) != NCM_NTH16_SIZE))
+  {
+    return NCM_NTB_ERROR;
+  }
+
+  /* A block length of 0 means the NTB ends with the transfer */
+  block = NCM_Get16(&ntb[8]);
+  block = (block == 0U) ? len : block;
+  ndp = NCM_Get16(&ntb[10]);
+
+  if ((block > len) || (ndp < NCM_NTH16_SIZE) || ((ndp % NCM_NTB_ALIGN) != 0U) ||
+      ((ndp + NCM_NDP16_HDR_SIZE) > block))
+  {
+    return NCM_NTB_ERROR;
+  }
+
+  r->Ntb = ntb;
+  r->Len = block;
+  r->Ndp = (uint16_t)ndp;
+
+  return NCM_NTB_OK;
+}
+
+/**
+  * @brief  NCM_NtbNext
+  *         Next datagram of the NTB. Chained NDPs are followed forward only,
+  *         so a malformed chain cannot loop.
+  * @param  r: reader opened by NCM_NtbOpen
+  * @param  dg: datagram start, inside the NTB
+  * @param  len: datagram length
+  * @retval NCM_NTB_OK, NCM_NTB_END after the last datagram, or NCM_NTB_ERROR
+  */
+uint8_t  NCM_NtbNext(NCM_NtbReaderTypeDef *r, const uint8_t **dg, uint16_t *len)
+{
+  const uint8_t *ndp;
+  uint32_t sig;
+  uint32_t ndp_len;
+  uint32_t next;
+  uint32_t entry;
+  uint32_t index;
+  uint32_t length;
+
+  while (r->Ndp != 0U)
+  {
+    ndp = &r->Ntb[r->Ndp];
+    sig = NCM_Get32(&ndp[0]);
+    ndp_len = NCM_Get16(&ndp[4]);
+
+    if (((sig != NCM_NDP16_SIGNATURE) && (sig != NCM_NDP16_CRC_SIGNATURE)) ||
+        (ndp_len < NCM_NDP16_MIN_SIZE) || ((ndp_len % 4U) != 0U) ||
+        ((r->Ndp + ndp_len) > r->Len))
+    {
+      r->Ndp = 0U;
+      return NCM_NTB_ERROR;
+    }
+
+    entry = NCM_NDP16_HDR_SIZE + (4U * r->Entry);
+
+    if ((entry + 4U) <= ndp_len)
+    {
+      index = NCM_Get16(&ndp[entry]);
+      length = NCM_Get16(&ndp[entry + 2U]);
+
+      if ((index != 0U) && (length != 0U))
+      {
+        if ((index < NCM_NTH16_SIZE) || ((index + length) > r->Len))
+        {
+          r->Ndp = 0U;
+          return NCM_NTB_ERROR;
+        }
+
+        r->Entry++;
+        *dg = &r->Ntb[index];
+        *len = (uint16_t)length;
+        return NCM_NTB_OK;
+      }
+    }
+
+    /* End of this NDP: move on to the next one in the chain */
+    next = NCM_Get16(&ndp[6]);
+
+    if ((next != 0U) && ((next <= r->Ndp) || ((next % NCM_NTB_ALIGN) != 0U) ||
+                         ((next + NCM_NDP16_HDR_SIZE) > r->Len)))
+    {
+      r->Ndp = 0U;
+      return NCM_NTB_ERROR;
+    }
+
+    r->Ndp = (uint16_t)next;
+    r->Entry = 0U;
+  }
+
+  return NCM_NTB_END;
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -134,8 +134,22 @@ USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev,
                                            uint8_t  *pbuf,
                                            uint16_t  size);
 
+USBD_StatusTypeDef  USBD_LL_EndReceive(USBD_HandleTypeDef *pdev,
+                                       uint8_t  ep_addr);
+
+USBD_StatusTypeDef  USBD_LL_PMAExchange(USBD_HandleTypeDef *pdev,
+                                        uint8_t  out_ep_addr,
+                                        uint8_t  in_ep_addr);
+
+USBD_StatusTypeDef  USBD_LL_Connect(USBD_HandleTypeDef *pdev, uint8_t connect);
+
+USBD_StatusTypeDef  USBD_LL_TriggerIrq(USBD_HandleTypeDef *pdev);
+
+USBD_StatusTypeDef  USBD_LL_MaskIrq(USBD_HandleTypeDef *pdev, uint8_t mask);
+
 uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t  ep_addr);
 void  USBD_LL_Delay(uint32_t Delay);
+uint32_t USBD_LL_GetTick(void);
 
 /**
   * @}
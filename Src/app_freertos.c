@@ -46,7 +46,15 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
-
+#if (DCDC_DEFERRED != 0U)
+/* Definitions for usbTask: USB data endpoint events, above every other task */
+osThreadId_t usbTaskHandle;
+const osThreadAttr_t usbTask_attributes = {
+  .name = "usbTask",
+  .priority = (osPriority_t) osPriorityRealtime,
+  .stack_size = 256 * 4
+};
+#endif /* DCDC_DEFERRED */
 /* USER CODE END Variables */
 /* Definitions for defaultTask */
 osThreadId_t defaultTaskHandle;
@@ -58,7 +66,9 @@ const osThreadAttr_t defaultTask_attributes = {
 
 /* Private function prototypes -----------------------------------------------*/
 /* USER CODE BEGIN FunctionPrototypes */
-   
+#if (DCDC_DEFERRED != 0U)
+void StartUsbTask(void *argument);
+#endif /* DCDC_DEFERRED */
 /* USER CODE END FunctionPrototypes */
 
 void StartDefaultTask(void *argument);
@@ -97,6 +107,9 @@ void MX_FREERTOS_Init(void) {
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
+#if (DCDC_DEFERRED != 0U)
+  usbTaskHandle = osThreadNew(StartUsbTask, NULL, &usbTask_attributes);
+#endif /* DCDC_DEFERRED */
   /* USER CODE END RTOS_THREADS */
 
 }
@@ -114,19 +127,72 @@ void StartDefaultTask(void *argument)
   osDelay(4000);
   extern USBD_HandleTypeDef hUsbDeviceFS;
   USBD_DCDC_HandleTypeDef *hcdc = (USBD_DCDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  uint32_t wait;
 
   /* Infinite loop */
   for(;;)
   {
-    //CDC_Transmit_FS(&hcdc->CDC1, "fuck\n", 5);
-    osDelay(1000);
+    //CDC_Transmit_FS(&hcdc->CDC[0], "fuck\n", 5);
+    /* Port count switches requested by the host: sleep until the class
+       signals a request (USBD_DCDC_ProcessCallback) or a switch stage is due */
+    wait = USBD_DCDC_Process(&hUsbDeviceFS);
+    (void)ulTaskNotifyTake(pdTRUE, (wait == DCDC_PROCESS_IDLE) ? portMAX_DELAY : (pdMS_TO_TICKS(wait) + 1U));
   }
   /* USER CODE END StartDefaultTask */
 }
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
-     
+/**
+  * @brief  USBD_DCDC_Process has work: give defaultTask a direct
+  *         notification, from the USB interrupt or from a task.
+  * @param  pdev: Device handle
+  * @retval None
+  */
+void USBD_DCDC_ProcessCallback(USBD_HandleTypeDef *pdev)
+{
+  BaseType_t woken = pdFALSE;
+
+  UNUSED(pdev);
+
+  if (defaultTaskHandle == NULL)
+  {
+    return;
+  }
+
+  if (xPortIsInsideInterrupt() != pdFALSE)
+  {
+    vTaskNotifyGiveFromISR((TaskHandle_t)defaultTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+  else
+  {
+    (void)xTaskNotifyGive((TaskHandle_t)defaultTaskHandle);
+  }
+}
+
+#if (DCDC_DEFERRED != 0U)
+/**
+  * @brief  Function implementing the usbTask thread: runs the class and the
+  *         CDC_Receive_FS/CDC_TransmitCplt_FS callbacks of the data endpoint
+  *         events queued by the USB interrupts.
+  * @param  argument: Not used
+  * @retval None
+  */
+void StartUsbTask(void *argument)
+{
+  extern USBD_HandleTypeDef hUsbDeviceFS;
+
+  UNUSED(argument);
+
+  for(;;)
+  {
+    /* Events queued before the scheduler started run on the first pass */
+    USBD_DCDC_EventRun(&hUsbDeviceFS);
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+#endif /* DCDC_DEFERRED */
 /* USER CODE END Application */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -25,6 +25,7 @@
 #include "task.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "usbd_dcdc.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -44,7 +45,11 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-
+#if (DCDC_ISR_PROFILE != 0U)
+/* Cycles of the USB handlers that preempt USB_LP (USB_HP, PMA DMA), so its
+   samples leave them out */
+static volatile uint32_t usbIsrNestedCycles = 0U;
+#endif /* DCDC_ISR_PROFILE */
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -62,7 +67,10 @@ extern PCD_HandleTypeDef hpcd_USB_FS;
 extern TIM_HandleTypeDef htim1;
 
 /* USER CODE BEGIN EV */
-
+extern USBD_HandleTypeDef hUsbDeviceFS;
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+extern DMA_HandleTypeDef hdma_usb_pma;
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -167,11 +175,21 @@ void DebugMon_Handler(void)
 void USB_LP_IRQHandler(void)
 {
   /* USER CODE BEGIN USB_LP_IRQn 0 */
-
+#if (DCDC_ISR_PROFILE != 0U)
+  uint32_t nested_start = usbIsrNestedCycles;
+  uint32_t isr_start = DWT->CYCCNT;
+#endif /* DCDC_ISR_PROFILE */
   /* USER CODE END USB_LP_IRQn 0 */
   HAL_PCD_IRQHandler(&hpcd_USB_FS);
   /* USER CODE BEGIN USB_LP_IRQn 1 */
-
+#if (DCDC_USB_HP_IRQ == 0U)
+  /* TX queue kicks handed over by task and other interrupt writers. With
+     the HP line they pend USB_HP instead, which serves them above this one */
+  USBD_DCDC_TxService(&hUsbDeviceFS);
+#endif /* DCDC_USB_HP_IRQ */
+#if (DCDC_ISR_PROFILE != 0U)
+  USBD_DCDC_IsrProfile((DWT->CYCCNT - isr_start) - (usbIsrNestedCycles - nested_start));
+#endif /* DCDC_ISR_PROFILE */
   /* USER CODE END USB_LP_IRQn 1 */
 }
 
@@ -190,6 +208,45 @@ void TIM1_UP_TIM16_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
+#if (DCDC_USB_HP_IRQ != 0U)
+/**
+  * @brief This function handles USB high priority interrupt remap: correct
+  * transfers of the double buffered data endpoints, and the TX queue kicks.
+  */
+void USB_HP_IRQHandler(void)
+{
+#if (DCDC_ISR_PROFILE != 0U)
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t cycles;
+#endif /* DCDC_ISR_PROFILE */
+  HAL_PCD_HP_IRQHandler(&hpcd_USB_FS);
+  USBD_DCDC_TxService(&hUsbDeviceFS);
+#if (DCDC_ISR_PROFILE != 0U)
+  cycles = DWT->CYCCNT - isr_start;
+  usbIsrNestedCycles += cycles;
+  USBD_DCDC_IsrProfile(cycles);
+#endif /* DCDC_ISR_PROFILE */
+}
+#endif /* DCDC_USB_HP_IRQ */
 
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+/**
+  * @brief This function handles DMA1 channel1 global interrupt, the PMA copies
+  * of the USB device.
+  */
+void DMA1_Channel1_IRQHandler(void)
+{
+#if (DCDC_ISR_PROFILE != 0U)
+  uint32_t isr_start = DWT->CYCCNT;
+  uint32_t cycles;
+#endif /* DCDC_ISR_PROFILE */
+  HAL_DMA_IRQHandler(&hdma_usb_pma);
+#if (DCDC_ISR_PROFILE != 0U)
+  cycles = DWT->CYCCNT - isr_start;
+  usbIsrNestedCycles += cycles;
+  USBD_DCDC_IsrProfile(cycles);
+#endif /* DCDC_ISR_PROFILE */
+}
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
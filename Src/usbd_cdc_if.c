@@ -23,6 +23,7 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include "usbd_dcdc_ncm.h"
 
 /* USER CODE END INCLUDE */
 
@@ -65,8 +66,32 @@
 /* USER CODE BEGIN PRIVATE_DEFINES */
 /* Define size for the receive and transmit buffer over CDC */
 /* It's up to user to redefine and/or remove those define */
-#define APP_RX_DATA_SIZE  2048
+/* One OUT transfer fills one RX ring slot: the Receive callback runs once per
+   APP_RX_XFER_SIZE bytes of a bulk upload, or earlier on a short packet */
+#define APP_RX_XFER_SIZE  512U
+#define APP_RX_DATA_SIZE  (DCDC_RX_SLOTS * APP_RX_XFER_SIZE)
 #define APP_TX_DATA_SIZE  2048
+
+/* Frames a partial IN packet may wait for more data before it is sent */
+#define APP_TX_FLUSH_FRAMES  1U
+
+/* Bridge credits: RX slots of bridged data allowed in the opposite port's TX
+   queue. OUT re-arming is held back beyond that, so the sending host is
+   NAKed instead of data being dropped. */
+#define APP_BRIDGE_DEPTH  2U
+
+#if ((APP_BRIDGE_DEPTH * APP_RX_XFER_SIZE) > APP_TX_DATA_SIZE)
+#error "APP_BRIDGE_DEPTH exceeds the TX queue"
+#endif
+
+/* Bridge the port pairs by cut-through (USBD_DCDC_SetCutThrough): packets
+   go from one port's OUT PMA buffer to the partner's IN endpoint with no
+   SRAM copy and no Receive callback. Needs single buffered ports. */
+#define APP_BRIDGE_CUT_THROUGH  0U
+
+#if (APP_BRIDGE_CUT_THROUGH != 0U) && ((DCDC_DBLBUF_PORTS & ((1U << (DCDC_NUM_PORTS & ~1U)) - 1U)) != 0U)
+#error "APP_BRIDGE_CUT_THROUGH needs the bridged ports single buffered, see DCDC_DBLBUF_PORTS"
+#endif
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -93,12 +118,24 @@
 /* Create buffer for reception and transmission           */
 /* It's up to user to redefine and/or remove those define */
 /** Received data over USB are stored in this buffer      */
-uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
+uint8_t UserRxBufferFS[DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE][APP_RX_DATA_SIZE];
 
 /** Data to send over USB CDC are stored in this buffer   */
-uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
+uint8_t UserTxBufferFS[DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE][APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+/** Bridge statistics per source port: blocks forwarded, and times a block
+    was held back for lack of credit */
+uint32_t CDC_BridgeForwarded[DCDC_NUM_PIPES];
+uint32_t CDC_BridgeHeld[DCDC_NUM_PIPES];
+
+/* Bytes of the oldest RX slot already in the partner TX queue */
+static uint32_t CDC_BridgeOffset[DCDC_NUM_PIPES];
+
+/** NCM statistics: datagrams received from the host, and NTBs rejected as
+    malformed */
+uint32_t CDC_NcmDatagrams;
+uint32_t CDC_NcmErrors;
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -130,8 +167,12 @@ static int8_t CDC_Init_FS(USBD_CDC_HandleTypeDef *cdc);
 static int8_t CDC_DeInit_FS(USBD_CDC_HandleTypeDef *cdc);
 static int8_t CDC_Control_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDC_Receive_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t* pbuf, uint32_t *Len);
+static int8_t CDC_TransmitCplt_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t *pbuf, uint32_t *Len);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static USBD_CDC_HandleTypeDef *CDC_Bridge_Peer(USBD_CDC_HandleTypeDef *cdc);
+static void CDC_Bridge_Pump(USBD_CDC_HandleTypeDef *src);
+static void CDC_Ncm_Drain(USBD_CDC_HandleTypeDef *cdc);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -144,7 +185,8 @@ USBD_DCDC_ItfTypeDef USBD_Interface_fops_FS =
   CDC_Init_FS,
   CDC_DeInit_FS,
   CDC_Control_FS,
-  CDC_Receive_FS
+  CDC_Receive_FS,
+  CDC_TransmitCplt_FS
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -155,9 +197,30 @@ USBD_DCDC_ItfTypeDef USBD_Interface_fops_FS =
 static int8_t CDC_Init_FS(USBD_CDC_HandleTypeDef *cdc)
 {
   /* USER CODE BEGIN 3 */
-  /* Set Application Buffers */
-  USBD_DCDC_SetTxBuffer(&hUsbDeviceFS, cdc, UserTxBufferFS, 0);
-  USBD_DCDC_SetRxBuffer(&hUsbDeviceFS, cdc, UserRxBufferFS);
+  /* The NCM function owns its NTB buffers */
+  if (cdc->Port >= (DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE)){
+    return (USBD_OK);
+  }
+  CDC_BridgeOffset[cdc->Port] = 0U;
+  /* Set Application Buffers, one RX ring and one TX queue per port and for
+     the vendor function. With fewer ports configured, each port also takes
+     the buffers of the ports left out (a power of two of them) */
+  uint32_t span = 1U;
+  uint32_t row = cdc->Port;
+  if (cdc->Port < DCDC_NUM_PORTS){
+    while ((span * 2U * USBD_DCDC_GetPortCount()) <= DCDC_NUM_PORTS){
+      span *= 2U;
+    }
+    row = cdc->Port * span;
+  }
+  USBD_DCDC_SetTxQueue(&hUsbDeviceFS, cdc, &UserTxBufferFS[0][0] + (row * APP_TX_DATA_SIZE), span * APP_TX_DATA_SIZE);
+  USBD_DCDC_SetTxFlush(&hUsbDeviceFS, cdc, APP_TX_FLUSH_FRAMES);
+  USBD_DCDC_SetRxRing(&hUsbDeviceFS, cdc, &UserRxBufferFS[0][0] + (row * APP_RX_DATA_SIZE), span * APP_RX_XFER_SIZE);
+#if (APP_BRIDGE_CUT_THROUGH != 0U)
+  if (CDC_Bridge_Peer(cdc) != cdc){
+    USBD_DCDC_SetCutThrough(&hUsbDeviceFS, cdc, CDC_Bridge_Peer(cdc));
+  }
+#endif /* APP_BRIDGE_CUT_THROUGH */
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -231,7 +294,11 @@ static int8_t CDC_Control_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t*
     break;
 
     case CDC_SET_CONTROL_LINE_STATE:
-
+      /* No data stage: pbuf is the setup request. Report DTR back as
+         carrier and DSR on the notification endpoint */
+      USBD_DCDC_NotifySerialState(&hUsbDeviceFS, cdc,
+                                  ((((USBD_SetupReqTypedef *)(void *)pbuf)->wValue & 0x01U) != 0U) ?
+                                  (CDC_SERIAL_STATE_DCD | CDC_SERIAL_STATE_DSR) : 0U);
     break;
 
     case CDC_SEND_BREAK:
@@ -251,10 +318,11 @@ static int8_t CDC_Control_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t*
   *         through this function.
   *
   *         @note
-  *         This function will block any OUT packet reception on USB endpoint
-  *         untill exiting this function. If you exit this function before transfer
-  *         is complete on CDC interface (ie. using DMA controller) it will result
-  *         in receiving more data while previous ones are still not sent.
+  *         The data has already been committed to the port RX ring and the
+  *         OUT endpoint re-armed into the next free slot before this runs.
+  *         Slots are drained with USBD_DCDC_RxPeek/USBD_DCDC_RxRelease, here or
+  *         later from a task; reception pauses only while the ring is full.
+  *         With DCDC_DEFERRED this runs in usbTask, not in the USB interrupt.
   *
   * @param  Buf: Buffer of data to be received
   * @param  Len: Number of data received (in bytes)
@@ -263,14 +331,16 @@ static int8_t CDC_Control_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t*
 static int8_t CDC_Receive_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  USBD_DCDC_HandleTypeDef *hcdc = (USBD_DCDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-  if(&hcdc->CDC1 == cdc)
-    CDC_Transmit_FS(&hcdc->CDC2, Buf, *Len);
-  if(&hcdc->CDC2 == cdc)
-    CDC_Transmit_FS(&hcdc->CDC1, Buf, *Len);
+  /* The data is already committed to this port's RX ring and the class
+     re-arms the endpoint itself: forward what the partner has credit for */
+  UNUSED(Buf);
+  UNUSED(Len);
+  if (cdc->Port >= (DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE)){
+    CDC_Ncm_Drain(cdc);
+    return (USBD_OK);
+  }
+  CDC_Bridge_Pump(cdc);
 
-  USBD_DCDC_SetRxBuffer(&hUsbDeviceFS, cdc, &Buf[0]);
-  USBD_DCDC_ReceivePacket(&hUsbDeviceFS, cdc);
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -280,7 +350,10 @@ static int8_t CDC_Receive_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t* Buf, uint32_t
   *         Data to send over USB IN endpoint are sent over CDC interface
   *         through this function.
   *         @note
-  *
+  *         The data is copied into the port TX queue and sent in full packets
+  *         as the endpoint frees up; Buf can be reused on return. Callable
+  *         from tasks and interrupts at once, see USBD_DCDC_TxWrite; on a
+  *         message mode port, a call overlapping another one gets USBD_BUSY.
   *
   * @param  Buf: Buffer of data to be sent
   * @param  Len: Number of data to be sent (in bytes)
@@ -290,16 +363,143 @@ uint8_t CDC_Transmit_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t* Buf, uint16_t Len)
 {
   uint8_t result = USBD_OK;
   /* USER CODE BEGIN 7 */
-  if (cdc->TxState != 0){
-    return USBD_BUSY;
-  }
-  USBD_DCDC_SetTxBuffer(&hUsbDeviceFS, cdc, Buf, Len);
-  result = USBD_DCDC_TransmitPacket(&hUsbDeviceFS, cdc);
+  /* All or nothing: USBD_BUSY leaves the queue untouched */
+  result = USBD_DCDC_TxSubmit(&hUsbDeviceFS, cdc, Buf, Len);
   /* USER CODE END 7 */
   return result;
 }
 
+/**
+  * @brief  CDC_Write_FS
+  *         Queue as much of the data as the port TX queue can take.
+  * @param  Buf: Buffer of data to be sent
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Number of bytes queued
+  */
+uint32_t CDC_Write_FS(USBD_CDC_HandleTypeDef *cdc, const uint8_t* Buf, uint32_t Len)
+{
+  /* USER CODE BEGIN 12 */
+  return USBD_DCDC_TxWrite(&hUsbDeviceFS, cdc, Buf, Len);
+  /* USER CODE END 12 */
+}
+
+/**
+  * @brief  CDC_TransmitCplt_FS
+  *         Called when the port IN endpoint goes idle.
+  * @param  Buf: Buffer of the last transfer, NULL after USBD_DCDC_TransmitVec
+  * @param  Len: Length of the last transfer or of the whole chain
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_TransmitCplt_FS(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  uint8_t result = USBD_OK;
+  /* USER CODE BEGIN 13 */
+  UNUSED(Buf);
+  UNUSED(Len);
+
+  /* Queue space freed on this port: resume the partner held back on it */
+  if (cdc->Port < (DCDC_NUM_PORTS + DCDC_VENDOR_ENABLE)){
+    CDC_Bridge_Pump(CDC_Bridge_Peer(cdc));
+  }
+  /* USER CODE END 13 */
+  return result;
+}
+
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  CDC_Bridge_Peer
+  *         Bridge partner: port pairs 0<->1, 2<->3...; an unpaired last port
+  *         and the vendor function echo back to themselves.
+  * @param  cdc: port handle
+  * @retval partner port handle
+  */
+static USBD_CDC_HandleTypeDef *CDC_Bridge_Peer(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_HandleTypeDef *hcdc = (USBD_DCDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  uint8_t peer = cdc->Port ^ 1U;
+
+  if(peer >= hcdc->Ports)
+    peer = cdc->Port;
+
+  return &hcdc->CDC[peer];
+}
+
+/**
+  * @brief  CDC_Bridge_Pump
+  *         Move blocks from the source port RX ring to the partner TX queue
+  *         while credit is left. A block without credit, or only partly
+  *         taken by the queue (other writers share it), stays in the ring;
+  *         once the ring is full the class stops re-arming the OUT endpoint.
+  *         Runs again when the partner frees queue space (TransmitCplt).
+  * @param  src: source port handle
+  * @retval None
+  */
+static void CDC_Bridge_Pump(USBD_CDC_HandleTypeDef *src)
+{
+  USBD_CDC_HandleTypeDef *dst = CDC_Bridge_Peer(src);
+  uint8_t *pkt;
+  uint32_t len;
+  uint32_t queued;
+  uint32_t *offset = &CDC_BridgeOffset[src->Port];
+
+  while((pkt = USBD_DCDC_RxPeek(&hUsbDeviceFS, src, &len)) != NULL)
+  {
+    queued = dst->TxQueue.Size - USBD_DCDC_TxFree(&hUsbDeviceFS, dst);
+    if((queued + len - *offset) > (APP_BRIDGE_DEPTH * src->RxRing.SlotSize))
+    {
+      CDC_BridgeHeld[src->Port]++;
+      break;
+    }
+
+    /* The credit check is a snapshot and other writers share the queue:
+       a short write keeps the slot, the rest goes on the next pump */
+    *offset += USBD_DCDC_TxWrite(&hUsbDeviceFS, dst, &pkt[*offset], len - *offset);
+    if(*offset < len)
+    {
+      CDC_BridgeHeld[src->Port]++;
+      break;
+    }
+
+    *offset = 0U;
+    USBD_DCDC_RxRelease(&hUsbDeviceFS, src);
+    CDC_BridgeForwarded[src->Port]++;
+  }
+}
+
+/**
+  * @brief  CDC_Ncm_Drain
+  *         Walk the datagrams of every NTB received on the NCM function and
+  *         return the slots to its ring. Datagrams are Ethernet frames; this
+  *         is where they would be handed to a network stack.
+  * @param  cdc: NCM pipe handle
+  * @retval None
+  */
+static void CDC_Ncm_Drain(USBD_CDC_HandleTypeDef *cdc)
+{
+  NCM_NtbReaderTypeDef ntb;
+  const uint8_t *dg;
+  uint16_t dglen;
+  uint8_t *pkt;
+  uint32_t len;
+  uint8_t status;
+
+  while((pkt = USBD_DCDC_RxPeek(&hUsbDeviceFS, cdc, &len)) != NULL)
+  {
+    status = NCM_NtbOpen(&ntb, pkt, len);
+
+    while(status == NCM_NTB_OK)
+    {
+      status = NCM_NtbNext(&ntb, &dg, &dglen);
+      if(status == NCM_NTB_OK)
+        CDC_NcmDatagrams++;
+    }
+
+    if(status == NCM_NTB_ERROR)
+      CDC_NcmErrors++;
+
+    USBD_DCDC_RxRelease(&hUsbDeviceFS, cdc);
+  }
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -26,9 +26,14 @@
 #include "usbd_core.h"
 
 #include "usbd_dcdc.h"
+#include "usbd_pma.h"
 
 /* USER CODE BEGIN Includes */
-
+#if (DCDC_DEFERRED != 0U)
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+#endif /* DCDC_DEFERRED */
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -37,14 +42,37 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
-
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+DMA_HandleTypeDef hdma_usb_pma;
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+#if (DCDC_DEFERRED != 0U)
+extern osThreadId_t usbTaskHandle;
+#endif /* DCDC_DEFERRED */
+/* Nesting depth of USBD_LL_MaskIrq */
+static uint32_t usbIrqMaskDepth = 0U;
+#if (DCDC_PMA_BENCH != 0U)
+USBD_PMA_BenchTypeDef USBD_PMA_BenchResult;
+#endif /* DCDC_PMA_BENCH */
 /* USER CODE END PV */
 
 PCD_HandleTypeDef hpcd_USB_FS;
 void Error_Handler(void);
 
 /* USER CODE BEGIN 0 */
-
+#if (DCDC_USB_HP_IRQ != 0U)
+/* USB_HP may preempt USB_LP. The PCD callbacks of USB_LP enter the core and
+   the class, whose state the data endpoints share: they run with USB_HP and
+   the PMA DMA line held off through BASEPRI. Called at USB_HP level, where
+   the callbacks of the data endpoints also run, this is a no-op */
+#define USBD_IRQ_PRIO_HP              5U
+#define USBD_IRQ_PRIO_LP              6U
+#define USBD_LP_LOCK()                uint32_t lp_basepri = __get_BASEPRI(); \
+                                      __set_BASEPRI_MAX(USBD_IRQ_PRIO_HP << (8U - __NVIC_PRIO_BITS))
+#define USBD_LP_UNLOCK()              __set_BASEPRI(lp_basepri)
+#else
+#define USBD_LP_LOCK()
+#define USBD_LP_UNLOCK()
+#endif /* DCDC_USB_HP_IRQ */
 /* USER CODE END 0 */
 
 /* Exported function prototypes ----------------------------------------------*/
@@ -58,6 +86,15 @@ void Error_Handler(void);
 static USBD_StatusTypeDef USBD_Get_USB_Status(HAL_StatusTypeDef hal_status);
 /* USER CODE BEGIN 1 */
 static void SystemClockConfig_Resume(void);
+static void USBD_PMA_Report(void);
+#if (DCDC_DEFERRED != 0U)
+static void USBD_Defer(USBD_HandleTypeDef *pdev, uint8_t ep_addr);
+static void USBD_Wake(void);
+#endif /* DCDC_DEFERRED */
+#if (DCDC_PMA_BENCH != 0U)
+static void USBD_PMA_OldWrite(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+static void USBD_PMA_OldRead(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes);
+#endif /* DCDC_PMA_BENCH */
 
 /* USER CODE END 1 */
 extern void SystemClock_Config(void);
@@ -97,7 +134,50 @@ void HAL_PCD_MspInit(PCD_HandleTypeDef* pcdHandle)
     HAL_NVIC_SetPriority(USB_LP_IRQn, 5, 0);
     HAL_NVIC_EnableIRQ(USB_LP_IRQn);
   /* USER CODE BEGIN USB_MspInit 1 */
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+    /* Memory-to-memory channel for the PMA copies. It completes at the USB
+       data endpoint priority: the completion runs the PCD callbacks, which
+       must not nest with the data endpoint handling of HAL_PCD_IRQHandler */
+    __HAL_RCC_DMAMUX1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_usb_pma.Instance = DMA1_Channel1;
+    hdma_usb_pma.Init.Request = DMA_REQUEST_MEM2MEM;
+    hdma_usb_pma.Init.Direction = DMA_MEMORY_TO_MEMORY;
+    hdma_usb_pma.Init.PeriphInc = DMA_PINC_ENABLE;
+    hdma_usb_pma.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usb_pma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_usb_pma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_usb_pma.Init.Mode = DMA_NORMAL;
+    hdma_usb_pma.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&hdma_usb_pma) != HAL_OK)
+    {
+      Error_Handler();
+    }
 
+    __HAL_LINKDMA(pcdHandle, hdmapma, hdma_usb_pma);
+
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+#if (DCDC_USB_HP_IRQ != 0U)
+    /* Data endpoint line above the control one: double buffered transfers
+       preempt the EP0, SOF and bus event work, which is moved one level
+       down (see USBD_LP_LOCK). Both stay at or below the FreeRTOS max
+       syscall priority, so the callbacks may use the FromISR API */
+    HAL_NVIC_SetPriority(USB_LP_IRQn, USBD_IRQ_PRIO_LP, 0);
+    HAL_NVIC_SetPriority(USB_HP_IRQn, USBD_IRQ_PRIO_HP, 0);
+    HAL_NVIC_EnableIRQ(USB_HP_IRQn);
+#endif /* DCDC_USB_HP_IRQ */
+#if (DCDC_ISR_PROFILE != 0U)
+    /* Cycle counter timing the USB interrupt handlers */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif /* DCDC_ISR_PROFILE */
+#if (DCDC_PMA_BENCH != 0U)
+    /* The PMA is clocked and no endpoint uses it yet */
+    USBD_PMA_Bench();
+#endif /* DCDC_PMA_BENCH */
   /* USER CODE END USB_MspInit 1 */
   }
 }
@@ -126,7 +206,14 @@ void HAL_PCD_MspDeInit(PCD_HandleTypeDef* pcdHandle)
     HAL_NVIC_DisableIRQ(USB_LP_IRQn);
 
   /* USER CODE BEGIN USB_MspDeInit 1 */
-
+#if (DCDC_USB_HP_IRQ != 0U)
+    HAL_NVIC_DisableIRQ(USB_HP_IRQn);
+#endif /* DCDC_USB_HP_IRQ */
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+    HAL_NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+    (void)HAL_DMA_DeInit(pcdHandle->hdmapma);
+    pcdHandle->hdmapma = NULL;
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
   /* USER CODE END USB_MspDeInit 1 */
   }
 }
@@ -143,11 +230,11 @@ void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_SetupStageCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END  HAL_PCD_SetupStageCallback_PreTreatment */
   USBD_LL_SetupStage((USBD_HandleTypeDef*)hpcd->pData, (uint8_t *)hpcd->Setup);  
   /* USER CODE BEGIN HAL_PCD_SetupStageCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END  HAL_PCD_SetupStageCallback_PostTreatment */
 }
 
@@ -164,11 +251,25 @@ void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_DataOutStageCallback_PreTreatment */
-  
+  USBD_HandleTypeDef *pdev = (USBD_HandleTypeDef*)hpcd->pData;
+  USBD_LP_LOCK();
+
+  /* Bulk endpoints of the configured class go straight to it, without
+     the core dispatch and its class table call */
+  if ((epnum != 0U) && (pdev->dev_state == USBD_STATE_CONFIGURED) && (pdev->pClass == USBD_DCDC_CLASS))
+  {
+#if (DCDC_DEFERRED != 0U)
+    USBD_Defer(pdev, epnum);
+#else
+    (void)USBD_DCDC_DataOut(pdev, epnum);
+#endif /* DCDC_DEFERRED */
+    USBD_LP_UNLOCK();
+    return;
+  }
   /* USER CODE END HAL_PCD_DataOutStageCallback_PreTreatment */
   USBD_LL_DataOutStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff);  
   /* USER CODE BEGIN HAL_PCD_DataOutStageCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_DataOutStageCallback_PostTreatment */
 }
 
@@ -185,11 +286,24 @@ void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_DataInStageCallback_PreTreatment */
-  
+  USBD_HandleTypeDef *pdev = (USBD_HandleTypeDef*)hpcd->pData;
+  USBD_LP_LOCK();
+
+  /* Bulk endpoints of the configured class go straight to it */
+  if ((epnum != 0U) && (pdev->dev_state == USBD_STATE_CONFIGURED) && (pdev->pClass == USBD_DCDC_CLASS))
+  {
+#if (DCDC_DEFERRED != 0U)
+    USBD_Defer(pdev, epnum | 0x80U);
+#else
+    (void)USBD_DCDC_DataIn(pdev, epnum);
+#endif /* DCDC_DEFERRED */
+    USBD_LP_UNLOCK();
+    return;
+  }
   /* USER CODE END HAL_PCD_DataInStageCallback_PreTreatment */  
   USBD_LL_DataInStage((USBD_HandleTypeDef*)hpcd->pData, epnum, hpcd->IN_ep[epnum].xfer_buff);  
   /* USER CODE BEGIN HAL_PCD_DataInStageCallback_PostTreatment  */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_DataInStageCallback_PostTreatment */
 }
 
@@ -205,11 +319,18 @@ void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_SOFCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_SOFCallback_PreTreatment */  
   USBD_LL_SOF((USBD_HandleTypeDef*)hpcd->pData);  
   /* USER CODE BEGIN HAL_PCD_SOFCallback_PostTreatment */
-  
+#if (DCDC_DEFERRED != 0U)
+  /* The class may have queued SOF work of its pipes */
+  if (USBD_DCDC_EventPending((USBD_HandleTypeDef*)hpcd->pData) != 0U)
+  {
+    USBD_Wake();
+  }
+#endif /* DCDC_DEFERRED */
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_SOFCallback_PostTreatment */
 }
 
@@ -225,7 +346,7 @@ void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 { 
   /* USER CODE BEGIN HAL_PCD_ResetCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_ResetCallback_PreTreatment */
   USBD_SpeedTypeDef speed = USBD_SPEED_FULL;
 
@@ -239,7 +360,7 @@ void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd)
   /* Reset Device. */
   USBD_LL_Reset((USBD_HandleTypeDef*)hpcd->pData);
   /* USER CODE BEGIN HAL_PCD_ResetCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_ResetCallback_PostTreatment */
 }
 
@@ -256,7 +377,7 @@ void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_SuspendCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_SuspendCallback_PreTreatment */
   /* Inform USB library that core enters in suspend Mode. */
   USBD_LL_Suspend((USBD_HandleTypeDef*)hpcd->pData);
@@ -269,7 +390,7 @@ void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd)
   }
   /* USER CODE END 2 */
   /* USER CODE BEGIN HAL_PCD_SuspendCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_SuspendCallback_PostTreatment */
 }
 
@@ -286,7 +407,7 @@ void HAL_PCD_ResumeCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_ResumeCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_ResumeCallback_PreTreatment */
 
   /* USER CODE BEGIN 3 */
@@ -300,7 +421,7 @@ void HAL_PCD_ResumeCallback(PCD_HandleTypeDef *hpcd)
  
   USBD_LL_Resume((USBD_HandleTypeDef*)hpcd->pData);
   /* USER CODE BEGIN HAL_PCD_ResumeCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_ResumeCallback_PostTreatment */
 }
 
@@ -317,11 +438,11 @@ void HAL_PCD_ISOOUTIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_ISOOUTIncompleteCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_ISOOUTIncompleteCallback_PreTreatment */
   USBD_LL_IsoOUTIncomplete((USBD_HandleTypeDef*)hpcd->pData, epnum);
   /* USER CODE BEGIN HAL_PCD_ISOOUTIncompleteCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_ISOOUTIncompleteCallback_PostTreatment */
 }
 
@@ -338,11 +459,11 @@ void HAL_PCD_ISOINIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_ISOINIncompleteCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_ISOINIncompleteCallback_PreTreatment */
   USBD_LL_IsoINIncomplete((USBD_HandleTypeDef*)hpcd->pData, epnum);
   /* USER CODE BEGIN HAL_PCD_ISOINIncompleteCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_ISOINIncompleteCallback_PostTreatment */
 }
 
@@ -358,11 +479,11 @@ void HAL_PCD_ConnectCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_ConnectCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_ConnectCallback_PreTreatment */
   USBD_LL_DevConnected((USBD_HandleTypeDef*)hpcd->pData);
   /* USER CODE BEGIN HAL_PCD_ConnectCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_ConnectCallback_PostTreatment */
 }
 
@@ -378,11 +499,11 @@ void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
   /* USER CODE BEGIN HAL_PCD_DisconnectCallback_PreTreatment */
-  
+  USBD_LP_LOCK();
   /* USER CODE END HAL_PCD_DisconnectCallback_PreTreatment */
   USBD_LL_DevDisconnected((USBD_HandleTypeDef*)hpcd->pData);
   /* USER CODE BEGIN HAL_PCD_DisconnectCallback_PostTreatment */
-  
+  USBD_LP_UNLOCK();
   /* USER CODE END HAL_PCD_DisconnectCallback_PostTreatment */
 }
 
@@ -410,10 +531,15 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   hpcd_USB_FS.Init.dev_endpoints = 8;
   hpcd_USB_FS.Init.speed = PCD_SPEED_FULL;
   hpcd_USB_FS.Init.phy_itface = PCD_PHY_EMBEDDED;
-  hpcd_USB_FS.Init.Sof_enable = DISABLE;
+  hpcd_USB_FS.Init.Sof_enable = ENABLE;
   hpcd_USB_FS.Init.low_power_enable = DISABLE;
   hpcd_USB_FS.Init.lpm_enable = DISABLE;
   hpcd_USB_FS.Init.battery_charging_enable = DISABLE;
+  /* USER CODE BEGIN USB_Init 0 */
+#if (DCDC_USB_HP_IRQ != 0U)
+  hpcd_USB_FS.Init.hp_irq_enable = ENABLE;
+#endif /* DCDC_USB_HP_IRQ */
+  /* USER CODE END USB_Init 0 */
 
   #if (USE_HAL_PCD_REGISTER_CALLBACKS == 1U)
   /* register Msp Callbacks (before the Init) */
@@ -448,22 +574,58 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   /* USER CODE END RegisterCallBackSecondPart */
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN EndPoint_Configuration */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, 0x18);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, 0x58);
+  /* Buffer offsets come from the compile-time layout in usbd_pma.h */
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, USBD_PMA_EP0_OUT);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, USBD_PMA_EP0_IN);
   /* USER CODE END EndPoint_Configuration */
   /* USER CODE BEGIN EndPoint_Configuration_CDC */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_IN_EP , PCD_SNG_BUF, 0x98);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_OUT_EP , PCD_SNG_BUF, 0xD8);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_CMD_EP , PCD_SNG_BUF, 0x118);
-
-  //HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x83 , PCD_SNG_BUF, 0x150);
-  //HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x02 , PCD_SNG_BUF, 0x1A0);
-  //HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x84 , PCD_SNG_BUF, 0x190);
+  uint8_t port;
 
-
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_IN_EP2 , PCD_SNG_BUF, 0x128);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_OUT_EP2, PCD_SNG_BUF, 0x168);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_CMD_EP2, PCD_SNG_BUF, 0x1A8);
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    if (DCDC_PORT_DBLBUF(port) != 0U)
+    {
+      /* Two packet buffers per direction, given as addr0 | (addr1 << 16) */
+      HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_IN_EP(port) , PCD_DBL_BUF,
+                          USBD_PMA_DCDC_IN(port) | (USBD_PMA_DCDC_IN1(port) << 16));
+      HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_OUT_EP(port), PCD_DBL_BUF,
+                          USBD_PMA_DCDC_OUT(port) | (USBD_PMA_DCDC_OUT1(port) << 16));
+    }
+    else
+    {
+      HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_IN_EP(port) , PCD_SNG_BUF, USBD_PMA_DCDC_IN(port));
+      HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_OUT_EP(port), PCD_SNG_BUF, USBD_PMA_DCDC_OUT(port));
+    }
+    HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_CMD_EP(port), PCD_SNG_BUF, USBD_PMA_DCDC_CMD(port));
+  }
+#if (DCDC_VENDOR_ENABLE != 0U)
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_VENDOR_IN_EP , PCD_SNG_BUF, USBD_PMA_VENDOR_IN);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_VENDOR_OUT_EP, PCD_SNG_BUF, USBD_PMA_VENDOR_OUT);
+#endif /* DCDC_VENDOR_ENABLE */
+#if (DCDC_NCM_ENABLE != 0U)
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_NCM_IN_EP , PCD_SNG_BUF, USBD_PMA_NCM_IN);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_NCM_OUT_EP, PCD_SNG_BUF, USBD_PMA_NCM_OUT);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_NCM_CMD_EP, PCD_SNG_BUF, USBD_PMA_NCM_CMD);
+#endif /* DCDC_NCM_ENABLE */
+
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+  /* Bulk data packets from DCDC_PMA_DMA_MIN_SIZE bytes up are copied by DMA */
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_IN_EP(port) , DCDC_PMA_DMA_MIN_SIZE);
+    HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_OUT_EP(port), DCDC_PMA_DMA_MIN_SIZE);
+  }
+#if (DCDC_VENDOR_ENABLE != 0U)
+  HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_VENDOR_IN_EP , DCDC_PMA_DMA_MIN_SIZE);
+  HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_VENDOR_OUT_EP, DCDC_PMA_DMA_MIN_SIZE);
+#endif /* DCDC_VENDOR_ENABLE */
+#if (DCDC_NCM_ENABLE != 0U)
+  HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_NCM_IN_EP , DCDC_PMA_DMA_MIN_SIZE);
+  HAL_PCDEx_PMADMAConfig((PCD_HandleTypeDef*)pdev->pData , DCDC_NCM_OUT_EP, DCDC_PMA_DMA_MIN_SIZE);
+#endif /* DCDC_NCM_ENABLE */
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+
+  USBD_PMA_Report();
   /* USER CODE END EndPoint_Configuration_CDC */
   return USBD_OK;
 }
@@ -689,6 +851,139 @@ USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_a
   return usb_status; 
 }
 
+/**
+  * @brief  Ends a multi-packet reception early with the data received so far.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval USBD_OK if ended, USBD_BUSY if a packet is pending, USBD_FAIL if
+  *         nothing was received
+  */
+USBD_StatusTypeDef USBD_LL_EndReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  HAL_StatusTypeDef hal_status = HAL_OK;
+  USBD_StatusTypeDef usb_status = USBD_OK;
+
+  hal_status = HAL_PCD_EP_EndReceive(pdev->pData, ep_addr);
+
+  usb_status =  USBD_Get_USB_Status(hal_status);
+
+  return usb_status;
+}
+
+/**
+  * @brief  Hands the packet received on an OUT endpoint to an IN endpoint by
+  *         exchanging their PMA buffers; both must be single buffered.
+  * @param  pdev: Device handle
+  * @param  out_ep_addr: OUT endpoint number, received with a NULL buffer
+  * @param  in_ep_addr: IN endpoint number, idle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_PMAExchange(USBD_HandleTypeDef *pdev, uint8_t out_ep_addr, uint8_t in_ep_addr)
+{
+  HAL_StatusTypeDef hal_status = HAL_OK;
+  USBD_StatusTypeDef usb_status = USBD_OK;
+
+  hal_status = HAL_PCDEx_PMAExchange(pdev->pData, out_ep_addr, in_ep_addr);
+
+  usb_status =  USBD_Get_USB_Status(hal_status);
+
+  return usb_status;
+}
+
+/**
+  * @brief  Connects or disconnects the device from the bus (D+ pull-up).
+  * @param  pdev: Device handle
+  * @param  connect: 1 to connect, 0 to disconnect
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_Connect(USBD_HandleTypeDef *pdev, uint8_t connect)
+{
+  HAL_StatusTypeDef hal_status = HAL_OK;
+  USBD_StatusTypeDef usb_status = USBD_OK;
+
+  if (connect != 0U)
+  {
+    hal_status = HAL_PCD_DevConnect(pdev->pData);
+  }
+  else
+  {
+    hal_status = HAL_PCD_DevDisconnect(pdev->pData);
+  }
+
+  usb_status =  USBD_Get_USB_Status(hal_status);
+
+  return usb_status;
+}
+
+/**
+  * @brief  Sets the USB interrupt pending, so work handed over by another
+  *         context runs in the interrupt (see USBD_DCDC_TxService).
+  * @param  pdev: Device handle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_TriggerIrq(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+#if (DCDC_USB_HP_IRQ != 0U)
+  HAL_NVIC_SetPendingIRQ(USB_HP_IRQn);
+#else
+  HAL_NVIC_SetPendingIRQ(USB_LP_IRQn);
+#endif /* DCDC_USB_HP_IRQ */
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Masks or unmasks the USB interrupts, and the PMA DMA one, so a
+  *         task can run class code without masking every interrupt (see
+  *         USBD_DCDC_EventRun). Calls nest: the interrupts come back with
+  *         the outermost unmask. Callable from tasks and interrupts.
+  * @param  pdev: Device handle
+  * @param  mask: 1 to mask, 0 to unmask
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_MaskIrq(USBD_HandleTypeDef *pdev, uint8_t mask)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  UNUSED(pdev);
+
+  /* The depth and the NVIC lines change together */
+  __disable_irq();
+
+  if (mask != 0U)
+  {
+    if (usbIrqMaskDepth++ != 0U)
+    {
+      __set_PRIMASK(primask);
+      return USBD_OK;
+    }
+
+    HAL_NVIC_DisableIRQ(USB_LP_IRQn);
+#if (DCDC_USB_HP_IRQ != 0U)
+    HAL_NVIC_DisableIRQ(USB_HP_IRQn);
+#endif /* DCDC_USB_HP_IRQ */
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+    HAL_NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+  }
+  else if ((usbIrqMaskDepth != 0U) && (--usbIrqMaskDepth == 0U))
+  {
+#if (DCDC_PMA_DMA_MIN_SIZE != 0U)
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+#endif /* DCDC_PMA_DMA_MIN_SIZE */
+#if (DCDC_USB_HP_IRQ != 0U)
+    HAL_NVIC_EnableIRQ(USB_HP_IRQn);
+#endif /* DCDC_USB_HP_IRQ */
+    HAL_NVIC_EnableIRQ(USB_LP_IRQn);
+  }
+
+  __set_PRIMASK(primask);
+
+  return USBD_OK;
+}
+
 /**
   * @brief  Returns the last transfered packet size.
   * @param  pdev: Device handle
@@ -750,6 +1045,15 @@ void USBD_LL_Delay(uint32_t Delay)
   HAL_Delay(Delay);
 }
 
+/**
+  * @brief  Millisecond tick for the USB Device Library.
+  * @retval Tick in ms
+  */
+uint32_t USBD_LL_GetTick(void)
+{
+  return HAL_GetTick();
+}
+
 /**
   * @brief  Static single allocation.
   * @param  size: Size of allocated memory
@@ -781,6 +1085,227 @@ static void SystemClockConfig_Resume(void)
 {
   SystemClock_Config();
 }
+
+/**
+  * @brief  Report the packet memory layout of usbd_pma.h through USBD_UsrLog.
+  * @retval None
+  */
+static void USBD_PMA_Report(void)
+{
+#if (USBD_DEBUG_LEVEL > 0U)
+  uint8_t port;
+
+  USBD_UsrLog("PMA: BTABLE 0x%03X, %u endpoint registers", USBD_PMA_BTABLE, USBD_PMA_EP_COUNT);
+  USBD_UsrLog("PMA: EP0 OUT 0x%03X, EP0 IN 0x%03X", USBD_PMA_EP0_OUT, USBD_PMA_EP0_IN);
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    USBD_UsrLog("PMA: port %u %s, IN 0x%02X 0x%03X, OUT 0x%02X 0x%03X, CMD 0x%02X 0x%03X",
+                port, (DCDC_PORT_DBLBUF(port) != 0U) ? "dbl" : "sng",
+                DCDC_IN_EP(port), USBD_PMA_DCDC_IN(port),
+                DCDC_OUT_EP(port), USBD_PMA_DCDC_OUT(port),
+                DCDC_CMD_EP(port), USBD_PMA_DCDC_CMD(port));
+  }
+#if (DCDC_VENDOR_ENABLE != 0U)
+  USBD_UsrLog("PMA: vendor, IN 0x%02X 0x%03X, OUT 0x%02X 0x%03X",
+              DCDC_VENDOR_IN_EP, USBD_PMA_VENDOR_IN, DCDC_VENDOR_OUT_EP, USBD_PMA_VENDOR_OUT);
+#endif /* DCDC_VENDOR_ENABLE */
+#if (DCDC_NCM_ENABLE != 0U)
+  USBD_UsrLog("PMA: NCM, IN 0x%02X 0x%03X, OUT 0x%02X 0x%03X, CMD 0x%02X 0x%03X",
+              DCDC_NCM_IN_EP, USBD_PMA_NCM_IN, DCDC_NCM_OUT_EP, USBD_PMA_NCM_OUT,
+              DCDC_NCM_CMD_EP, USBD_PMA_NCM_CMD);
+#endif /* DCDC_NCM_ENABLE */
+
+  USBD_UsrLog("PMA: %u of %u bytes used, %u free", USBD_PMA_END, USBD_PMA_SIZE, USBD_PMA_FREE);
+#endif /* USBD_DEBUG_LEVEL */
+}
+
+#if (DCDC_PMA_BENCH != 0U)
+/* Time one PMA copy in cycles, less the cost of reading the counter, and
+   keep the best of the runs */
+#define USBD_PMA_TIME(best, call)     do                                                   \
+                                      {                                                    \
+                                        start = DWT->CYCCNT;                               \
+                                        call;                                              \
+                                        cycles = (DWT->CYCCNT - start) - overhead;         \
+                                        (best) = (uint16_t)MIN((uint32_t)(best), cycles);  \
+                                      } while (0)
+
+/**
+  * @brief  Time USB_WritePMA and USB_ReadPMA against the halfword loops they
+  *         replaced, for every length from 1 byte to one data packet, on the
+  *         free packet memory past the endpoint buffers. The cycle counts go
+  *         to USBD_PMA_BenchResult, to be read with the debugger, and their
+  *         sums to USBD_UsrLog. Runs with interrupts off, before the device
+  *         starts.
+  * @retval None
+  */
+void USBD_PMA_Bench(void)
+{
+  uint32_t buf[DCDC_DATA_FS_MAX_PACKET_SIZE / 4U];
+  uint8_t *pbuf = (uint8_t *)buf;
+  uint32_t primask;
+  uint32_t overhead;
+  uint32_t start;
+  uint32_t cycles;
+  uint32_t len;
+  uint32_t run;
+  uint32_t sum[4] = {0U};
+  USBD_PMA_BenchTypeDef *res = &USBD_PMA_BenchResult;
+
+  for (len = 0U; len < DCDC_DATA_FS_MAX_PACKET_SIZE; len++)
+  {
+    pbuf[len] = (uint8_t)((len * 7U) + 1U);
+  }
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+
+  overhead = 0xFFFFFFFFU;
+  for (run = 0U; run < DCDC_PMA_BENCH; run++)
+  {
+    start = DWT->CYCCNT;
+    cycles = DWT->CYCCNT - start;
+    overhead = MIN(overhead, cycles);
+  }
+
+  for (len = 1U; len <= DCDC_DATA_FS_MAX_PACKET_SIZE; len++)
+  {
+    res->Write[len - 1U] = 0xFFFFU;
+    res->OldWrite[len - 1U] = 0xFFFFU;
+    res->Read[len - 1U] = 0xFFFFU;
+    res->OldRead[len - 1U] = 0xFFFFU;
+
+    for (run = 0U; run < DCDC_PMA_BENCH; run++)
+    {
+      USBD_PMA_TIME(res->Write[len - 1U], USB_WritePMA(USB, pbuf, USBD_PMA_END, (uint16_t)len));
+      USBD_PMA_TIME(res->OldWrite[len - 1U], USBD_PMA_OldWrite(USB, pbuf, USBD_PMA_END, (uint16_t)len));
+      USBD_PMA_TIME(res->Read[len - 1U], USB_ReadPMA(USB, pbuf, USBD_PMA_END, (uint16_t)len));
+      USBD_PMA_TIME(res->OldRead[len - 1U], USBD_PMA_OldRead(USB, pbuf, USBD_PMA_END, (uint16_t)len));
+    }
+
+    sum[0] += res->Write[len - 1U];
+    sum[1] += res->OldWrite[len - 1U];
+    sum[2] += res->Read[len - 1U];
+    sum[3] += res->OldRead[len - 1U];
+  }
+
+  __set_PRIMASK(primask);
+
+  USBD_UsrLog("PMA bench, cycles over 1..%u bytes: write %lu (was %lu), read %lu (was %lu)",
+              DCDC_DATA_FS_MAX_PACKET_SIZE, sum[0], sum[1], sum[2], sum[3]);
+  UNUSED(sum);
+}
+
+/**
+  * @brief  USB_WritePMA as it was before the word-wide copy, for USBD_PMA_Bench.
+  * @param  USBx: USB peripheral instance register address
+  * @param  pbUsrBuf: pointer to user memory area
+  * @param  wPMABufAddr: address into PMA
+  * @param  wNBytes: no. of bytes to be copied
+  * @retval None
+  */
+static void USBD_PMA_OldWrite(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+  uint32_t n = ((uint32_t)wNBytes + 1U) >> 1;
+  uint32_t BaseAddr = (uint32_t)USBx;
+  uint32_t i, temp1, temp2;
+  __IO uint16_t *pdwVal;
+  uint8_t *pBuf = pbUsrBuf;
+
+  pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
+
+  for (i = n; i != 0U; i--)
+  {
+    temp1 = *pBuf;
+    pBuf++;
+    temp2 = temp1 | ((uint16_t)((uint16_t) *pBuf << 8));
+    *pdwVal = (uint16_t)temp2;
+    pdwVal++;
+
+#if PMA_ACCESS > 1U
+    pdwVal++;
+#endif
+
+    pBuf++;
+  }
+}
+
+/**
+  * @brief  USB_ReadPMA as it was before the word-wide copy, for USBD_PMA_Bench.
+  * @param  USBx: USB peripheral instance register address
+  * @param  pbUsrBuf: pointer to user memory area
+  * @param  wPMABufAddr: address into PMA
+  * @param  wNBytes: no. of bytes to be copied
+  * @retval None
+  */
+static void USBD_PMA_OldRead(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+  uint32_t n = (uint32_t)wNBytes >> 1;
+  uint32_t BaseAddr = (uint32_t)USBx;
+  uint32_t i, temp;
+  __IO uint16_t *pdwVal;
+  uint8_t *pBuf = pbUsrBuf;
+
+  pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
+
+  for (i = n; i != 0U; i--)
+  {
+    temp = *(__IO uint16_t *)pdwVal;
+    pdwVal++;
+    *pBuf = (uint8_t)((temp >> 0) & 0xFFU);
+    pBuf++;
+    *pBuf = (uint8_t)((temp >> 8) & 0xFFU);
+    pBuf++;
+
+#if PMA_ACCESS > 1U
+    pdwVal++;
+#endif
+  }
+
+  if ((wNBytes % 2U) != 0U)
+  {
+    temp = *pdwVal;
+    *pBuf = (uint8_t)((temp >> 0) & 0xFFU);
+  }
+}
+#endif /* DCDC_PMA_BENCH */
+
+#if (DCDC_DEFERRED != 0U)
+/**
+  * @brief  Hand a data endpoint event over to the USB task: queue it for
+  *         USBD_DCDC_EventRun and give the task a direct notification.
+  *         Before the scheduler runs the event waits for the task start.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint address
+  * @retval None
+  */
+static void USBD_Defer(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  if (USBD_DCDC_EventPost(pdev, ep_addr) == USBD_OK)
+  {
+    USBD_Wake();
+  }
+}
+
+/**
+  * @brief  Give the USB task a direct notification from an interrupt.
+  * @retval None
+  */
+static void USBD_Wake(void)
+{
+  BaseType_t woken = pdFALSE;
+
+  if (usbTaskHandle != NULL)
+  {
+    vTaskNotifyGiveFromISR((TaskHandle_t)usbTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+#endif /* DCDC_DEFERRED */
 /* USER CODE END 5 */
 
 /**
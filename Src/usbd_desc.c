@@ -25,7 +25,7 @@
 #include "usbd_conf.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+#include "usbd_dcdc.h"
 /* USER CODE END INCLUDE */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -72,7 +72,15 @@
 #define USBD_INTERFACE_STRING     "CDC Interface"
 
 /* USER CODE BEGIN PRIVATE_DEFINES */
-
+/* Product ID of each port count layout (USBD_DCDC_SetPortCount), first
+   entry for one port. Entries left out or 0 use USBD_PID. Only use IDs
+   assigned to this product: the defaults keep USBD_PID for every layout
+   and tell the layouts apart by bcdDevice (2.00 with all ports, one more
+   per port left out), which hosts key their cached device configuration
+   on as well. Override from usbd_conf.h, e.g. { 0x1235U, 0x1234U } */
+#ifndef USBD_PID_LAYOUTS
+#define USBD_PID_LAYOUTS     { USBD_PID }
+#endif /* USBD_PID_LAYOUTS */
 /* USER CODE END PRIVATE_DEFINES */
 
 /**
@@ -223,7 +231,19 @@ __ALIGN_BEGIN uint8_t USBD_StringSerial[USB_SIZ_STRING_SERIAL] __ALIGN_END = {
   */
 uint8_t * USBD_CDC_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
 {
+  static const uint16_t pid_layouts[DCDC_NUM_PORTS] = USBD_PID_LAYOUTS;
+  uint8_t ports = USBD_DCDC_GetPortCount();
+  uint16_t pid = pid_layouts[ports - 1U];
+
   UNUSED(speed);
+  /* The host must not reuse the driver binding of another layout */
+  if (pid == 0U)
+  {
+    pid = USBD_PID;
+  }
+  USBD_CDC_DeviceDesc[10] = LOBYTE(pid);
+  USBD_CDC_DeviceDesc[11] = HIBYTE(pid);
+  USBD_CDC_DeviceDesc[12] = (uint8_t)(DCDC_NUM_PORTS - ports);
   *length = sizeof(USBD_CDC_DeviceDesc);
   return USBD_CDC_DeviceDesc;
 }
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Sequence-checking stress test of the CDC port bridge, run on the USB host.
+
+The firmware forwards everything written to one port of a pair out of the
+other (CDC_Bridge_Pump). This script saturates both directions at once with
+numbered frames and checks on the far side that every frame arrives once, in
+order and intact. With the credit-based flow control the sending host is
+NAKed instead of data being dropped, so any gap, duplicate or corrupted
+frame is a failure.
+
+    pip install pyserial
+    python3 bridge_stress.py /dev/ttyACM0 /dev/ttyACM1 --seconds 60
+
+Exit status 0 if no error was seen in either direction.
+"""
+
+import argparse
+import random
+import struct
+import sys
+import threading
+import time
+
+import serial
+
+MAGIC = 0xB5
+HEADER = struct.Struct("<BIH")  # magic, sequence number, payload length
+
+
+def payload(seq, length):
+    """Payload of a frame, derived from its sequence number."""
+    return random.Random(seq).randbytes(length)
+
+
+class Direction:
+    """One bridge direction: frames written to src must come out of dst."""
+
+    def __init__(self, name, src, dst, max_len, seconds):
+        self.name = name
+        self.src = src
+        self.dst = dst
+        self.max_len = max_len
+        self.deadline = time.monotonic() + seconds
+        self.sent = 0
+        self.received = 0
+        self.bytes = 0
+        self.errors = []
+        self.done = threading.Event()
+
+    def writer(self):
+        rng = random.Random(self.name)
+        seq = 0
+        while time.monotonic() < self.deadline:
+            length = rng.randint(0, self.max_len)
+            self.src.write(HEADER.pack(MAGIC, seq, length) + payload(seq, length))
+            seq += 1
+        self.src.flush()
+        self.sent = seq
+        self.done.set()
+
+    def read_exact(self, count):
+        data = b""
+        while len(data) < count:
+            chunk = self.dst.read(count - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+    def reader(self):
+        expect = 0
+        while not (self.done.is_set() and expect >= self.sent):
+            header = self.read_exact(HEADER.size)
+            if header is None:
+                if self.done.is_set():
+                    break
+                continue
+            magic, seq, length = HEADER.unpack(header)
+            if magic != MAGIC:
+                self.errors.append("frame %d: lost framing" % expect)
+                return
+            if seq != expect:
+                self.errors.append("frame %d: got sequence %d" % (expect, seq))
+                return
+            data = self.read_exact(length)
+            if data != payload(seq, length):
+                self.errors.append("frame %d: payload mismatch" % seq)
+                return
+            expect += 1
+            self.bytes += HEADER.size + length
+        self.received = expect
+        if self.received != self.sent:
+            self.errors.append("%d of %d frames received" % (self.received, self.sent))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("port_a", help="first port of the bridged pair")
+    parser.add_argument("port_b", help="second port of the bridged pair")
+    parser.add_argument("--seconds", type=float, default=30.0, help="test duration")
+    parser.add_argument("--max-len", type=int, default=1024, help="largest frame payload")
+    args = parser.parse_args()
+
+    a = serial.Serial(args.port_a, timeout=2.0)
+    b = serial.Serial(args.port_b, timeout=2.0)
+    a.reset_input_buffer()
+    b.reset_input_buffer()
+
+    directions = [Direction("a->b", a, b, args.max_len, args.seconds),
+                  Direction("b->a", b, a, args.max_len, args.seconds)]
+    threads = []
+    start = time.monotonic()
+    for d in directions:
+        threads.append(threading.Thread(target=d.writer))
+        threads.append(threading.Thread(target=d.reader))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+
+    failed = False
+    for d in directions:
+        print("%s: %d frames, %.1f kB/s, %s" %
+              (d.name, d.received, d.bytes / elapsed / 1000.0,
+               "; ".join(d.errors) if d.errors else "no errors"))
+        failed = failed or bool(d.errors)
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
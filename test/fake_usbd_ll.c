@@ -0,0 +1,448 @@
+/**
+  ******************************************************************************
+  * @file    fake_usbd_ll.c
+  * @brief   Fake USBD_LL_* layer for host tests of the USB device library.
+  *
+  *          Stands in for Src/usbd_conf.c and the PCD driver: endpoints are
+  *          plain records, transfers complete when the test plays the host
+  *          (Fake_HostOut, Fake_HostIn), and the USB interrupt runs when the
+  *          test calls Fake_Irq. Completions go through the core the way
+  *          the PCD callbacks of usbd_conf.c pass them on.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fake_usbd_ll.h"
+#include "usbd_dcdc.h"
+
+/* Private variables ---------------------------------------------------------*/
+FakeUsbTypeDef Fake;
+
+uint8_t (*Host_PreemptHook)(void);
+volatile uint32_t *Host_ExclAddr;
+uint32_t Host_Primask;
+
+static uint32_t FakeEp0Stalls;
+
+/* Private functions ---------------------------------------------------------*/
+static FakeEpTypeDef *Fake_Ep(uint8_t ep_addr)
+{
+  return ((ep_addr & 0x80U) != 0U) ? &Fake.In[ep_addr & 0x7U] : &Fake.Out[ep_addr & 0x7U];
+}
+
+/**
+  * @brief  Clears the bus, the endpoints and the statistics.
+  * @retval None
+  */
+void Fake_Reset(void)
+{
+  memset(&Fake, 0, sizeof(Fake));
+  Host_PreemptHook = NULL;
+  Host_ExclAddr = NULL;
+  Host_Primask = 0U;
+}
+
+/**
+  * @brief  Runs a control request through the core, with its data stage.
+  * @param  pdev: device instance
+  * @param  bmRequest, bRequest, wValue, wIndex, wLength: setup packet
+  * @param  data: OUT data stage of wLength bytes, NULL if none; the IN data
+  *         stage lands in Fake.Ep0Data
+  * @retval USBD_OK, USBD_FAIL if the device stalled the request
+  */
+uint8_t Fake_Setup(USBD_HandleTypeDef *pdev, uint8_t bmRequest, uint8_t bRequest,
+                   uint16_t wValue, uint16_t wIndex, uint16_t wLength, const uint8_t *data)
+{
+  uint8_t setup[8];
+
+  setup[0] = bmRequest;
+  setup[1] = bRequest;
+  setup[2] = (uint8_t)wValue;
+  setup[3] = (uint8_t)(wValue >> 8);
+  setup[4] = (uint8_t)wIndex;
+  setup[5] = (uint8_t)(wIndex >> 8);
+  setup[6] = (uint8_t)wLength;
+  setup[7] = (uint8_t)(wLength >> 8);
+
+  FakeEp0Stalls = 0U;
+  Fake.Ep0Len = 0U;
+  (void)USBD_LL_SetupStage(pdev, setup);
+
+  if ((FakeEp0Stalls == 0U) && (data != NULL) && (wLength != 0U) &&
+      ((bmRequest & 0x80U) == 0U) && (Fake.Out[0].Buf != NULL))
+  {
+    memcpy(Fake.Out[0].Buf, data, wLength);
+    Fake.Out[0].Count = wLength;
+    (void)USBD_LL_DataOutStage(pdev, 0U, Fake.Out[0].Buf);
+  }
+
+  return (FakeEp0Stalls == 0U) ? USBD_OK : USBD_FAIL;
+}
+
+/**
+  * @brief  Bus reset and SET_ADDRESS, as a host does before configuring.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void Fake_Enumerate(USBD_HandleTypeDef *pdev)
+{
+  (void)USBD_LL_SetSpeed(pdev, USBD_SPEED_FULL);
+  (void)USBD_LL_Reset(pdev);
+  (void)Fake_Setup(pdev, 0x00U, USB_REQ_SET_ADDRESS, 1U, 0U, 0U, NULL);
+}
+
+/**
+  * @brief  Host sends data to an OUT endpoint, a packet at a time, for as
+  *         long as the endpoint is armed. Every completed transfer goes to
+  *         the core.
+  * @param  pdev: device instance
+  * @param  ep_addr: OUT endpoint
+  * @param  data, len: bytes to send
+  * @param  end: end the data with a short packet, a ZLP if len is a
+  *         multiple of the packet size
+  * @retval Bytes the device accepted; the rest was NAKed
+  */
+uint32_t Fake_HostOut(USBD_HandleTypeDef *pdev, uint8_t ep_addr, const uint8_t *data,
+                      uint32_t len, uint8_t end)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr);
+  uint32_t sent = 0U;
+  uint32_t pkt;
+
+  do
+  {
+    if (ep->Armed == 0U)
+    {
+      return sent;
+    }
+    pkt = MIN(len - sent, ep->Mps);
+
+    /* Data all sent: a ZLP only ends data that ended on a full packet */
+    if ((pkt == 0U) && ((end == 0U) || ((len % ep->Mps) != 0U)))
+    {
+      return sent;
+    }
+
+    if (ep->Buf != NULL)
+    {
+      memcpy(ep->Buf + ep->Count, data + sent, pkt);
+    }
+    ep->Count += pkt;
+    sent += pkt;
+
+    if ((pkt < ep->Mps) || (ep->Count >= ep->Len))
+    {
+      ep->Armed = 0U;
+      (void)USBD_LL_DataOutStage(pdev, ep_addr & 0x7U, ep->Buf);
+    }
+  } while (pkt == ep->Mps);
+
+  return sent;
+}
+
+/**
+  * @brief  Host reads from an IN endpoint, a packet at a time, until a short
+  *         packet or ZLP, or until the next packet does not fit. Every
+  *         completed transfer goes to the core.
+  * @param  pdev: device instance
+  * @param  ep_addr: IN endpoint
+  * @param  data, size: buffer for the bytes read
+  * @retval Bytes read
+  */
+uint32_t Fake_HostIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *data, uint32_t size)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr);
+  uint32_t got = 0U;
+  uint32_t pkt;
+
+  while (ep->Armed != 0U)
+  {
+    pkt = MIN(ep->Len - ep->Count, ep->Mps);
+
+    if (pkt > (size - got))
+    {
+      break;
+    }
+    memcpy(data + got, ep->Buf + ep->Count, pkt);
+    ep->Count += pkt;
+    got += pkt;
+
+    if ((pkt < ep->Mps) || (ep->Count >= ep->Len))
+    {
+      ep->Armed = 0U;
+      (void)USBD_LL_DataInStage(pdev, ep_addr & 0x7U, ep->Buf);
+    }
+    if (pkt < ep->Mps)
+    {
+      break;
+    }
+  }
+  return got;
+}
+
+/**
+  * @brief  Runs the USB interrupt if USBD_LL_TriggerIrq set it pending and
+  *         it is not masked: the TX queue kicks handed over by writers.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void Fake_Irq(USBD_HandleTypeDef *pdev)
+{
+  if ((Fake.IrqPending != 0U) && (Fake.IrqMask == 0U) && (Host_Primask == 0U))
+  {
+    Fake.IrqPending = 0U;
+    USBD_DCDC_TxService(pdev);
+  }
+}
+
+/**
+  * @brief  Start of frame, a millisecond of bus time.
+  * @param  pdev: device instance
+  * @retval None
+  */
+void Fake_Sof(USBD_HandleTypeDef *pdev)
+{
+  Fake.Tick++;
+  (void)USBD_LL_SOF(pdev);
+}
+
+/*******************************************************************************
+                       LL Driver Interface (USB Device Library --> PCD)
+*******************************************************************************/
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+  Fake.Pcd.pData = pdev;
+  pdev->pData = &Fake.Pcd;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+  Fake.Connected = 1U;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+  Fake.Connected = 0U;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t ep_type, uint16_t ep_mps)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr);
+
+  UNUSED(pdev);
+
+  ep->Open = 1U;
+  ep->Type = ep_type;
+  ep->Mps = ep_mps;
+  ep->Armed = 0U;
+  ep->Opens++;
+
+  if ((ep_addr & 0x80U) != 0U)
+  {
+    Fake.Pcd.IN_ep[ep_addr & 0x7U].maxpacket = ep_mps;
+  }
+  else
+  {
+    Fake.Pcd.OUT_ep[ep_addr & 0x7U].maxpacket = ep_mps;
+  }
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr);
+
+  UNUSED(pdev);
+
+  ep->Open = 0U;
+  ep->Armed = 0U;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+  Fake_Ep(ep_addr)->Armed = 0U;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  /* EP0 stalls fail the request, see Fake_Setup */
+  if ((ep_addr & 0x7FU) == 0U)
+  {
+    FakeEp0Stalls++;
+  }
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+  UNUSED(ep_addr);
+  return USBD_OK;
+}
+
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+  UNUSED(ep_addr);
+  return 0U;
+}
+
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+  UNUSED(pdev);
+  UNUSED(dev_addr);
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t size)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr | 0x80U);
+
+  UNUSED(pdev);
+
+  if ((ep_addr & 0x7FU) == 0U)
+  {
+    /* Control IN data stage: kept for the test, no completion */
+    Fake.Ep0Len = MIN(size, sizeof(Fake.Ep0Data));
+    if (pbuf != NULL)
+    {
+      memcpy(Fake.Ep0Data, pbuf, Fake.Ep0Len);
+    }
+    return USBD_OK;
+  }
+
+  if (ep->Armed != 0U)
+  {
+    Fake.DoubleSubmits++;
+  }
+  ep->Armed = 1U;
+  ep->Buf = pbuf;
+  ep->Len = size;
+  ep->Count = 0U;
+  ep->Transfers++;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pbuf, uint16_t size)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr & 0x7FU);
+
+  UNUSED(pdev);
+
+  if (((ep_addr & 0x7FU) != 0U) && (ep->Armed != 0U))
+  {
+    Fake.DoubleSubmits++;
+  }
+  ep->Armed = 1U;
+  ep->Buf = pbuf;
+  ep->Len = size;
+  ep->Count = 0U;
+  ep->Transfers++;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_EndReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  FakeEpTypeDef *ep = Fake_Ep(ep_addr & 0x7FU);
+
+  UNUSED(pdev);
+
+  if ((ep->Armed == 0U) || (ep->Count == 0U))
+  {
+    return USBD_FAIL;
+  }
+  ep->Armed = 0U;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_PMAExchange(USBD_HandleTypeDef *pdev, uint8_t out_ep_addr, uint8_t in_ep_addr)
+{
+  UNUSED(pdev);
+  UNUSED(out_ep_addr);
+  UNUSED(in_ep_addr);
+
+  /* No packet memory here: cut-through is not simulated */
+  return USBD_FAIL;
+}
+
+USBD_StatusTypeDef USBD_LL_Connect(USBD_HandleTypeDef *pdev, uint8_t connect)
+{
+  UNUSED(pdev);
+  Fake.Connected = connect;
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_TriggerIrq(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+  Fake.IrqPending = 1U;
+
+  /* A pending interrupt is taken at once if nothing masks it */
+  Host_Preempt();
+  return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_LL_MaskIrq(USBD_HandleTypeDef *pdev, uint8_t mask)
+{
+  UNUSED(pdev);
+
+  if (mask != 0U)
+  {
+    Fake.IrqMask++;
+  }
+  else if ((Fake.IrqMask != 0U) && (--Fake.IrqMask == 0U))
+  {
+    Host_Preempt();
+  }
+  return USBD_OK;
+}
+
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+  return Fake_Ep(ep_addr & 0x7FU)->Count;
+}
+
+void USBD_LL_Delay(uint32_t Delay)
+{
+  Fake.Tick += Delay;
+}
+
+uint32_t USBD_LL_GetTick(void)
+{
+  return Fake.Tick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  Fake.Tick += Delay;
+}
+
+void *USBD_static_malloc(uint32_t size)
+{
+  static uint32_t mem[(sizeof(USBD_DCDC_HandleTypeDef)/4)+1];/* On 32-bit boundary */
+
+  UNUSED(size);
+  return mem;
+}
+
+void USBD_static_free(void *p)
+{
+  UNUSED(p);
+}
@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file    fake_usbd_ll.h
+  * @brief   Fake USBD_LL_* layer for host tests of the USB device library:
+  *          records what the stack asks of the controller and lets a test
+  *          play the host side of the bus.
+  ******************************************************************************
+  */
+
+#ifndef __FAKE_USBD_LL_H
+#define __FAKE_USBD_LL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_core.h"
+
+#define FAKE_EP_COUNT        8U
+
+typedef struct
+{
+  uint8_t  Open;
+  uint8_t  Type;
+  uint16_t Mps;
+  uint8_t  Armed;                                          /* Transfer handed to the controller */
+  uint8_t  *Buf;
+  uint32_t Len;                                            /* Transfer length */
+  uint32_t Count;                                          /* OUT: bytes received so far */
+  uint32_t Opens;
+  uint32_t Transfers;
+} FakeEpTypeDef;
+
+typedef struct
+{
+  FakeEpTypeDef In[FAKE_EP_COUNT];
+  FakeEpTypeDef Out[FAKE_EP_COUNT];
+  PCD_HandleTypeDef Pcd;
+  uint32_t Tick;
+  uint8_t  Connected;
+  uint8_t  IrqPending;                                     /* USBD_LL_TriggerIrq since the last Fake_Irq */
+  uint32_t IrqMask;                                        /* USBD_LL_MaskIrq depth */
+  uint32_t DoubleSubmits;                                  /* Transfers started on a busy endpoint */
+  uint8_t  Ep0Data[256];                                   /* Last EP0 IN data stage */
+  uint32_t Ep0Len;
+} FakeUsbTypeDef;
+
+extern FakeUsbTypeDef Fake;
+
+void     Fake_Reset(void);
+uint8_t  Fake_Setup(USBD_HandleTypeDef *pdev, uint8_t bmRequest, uint8_t bRequest,
+                    uint16_t wValue, uint16_t wIndex, uint16_t wLength, const uint8_t *data);
+void     Fake_Enumerate(USBD_HandleTypeDef *pdev);
+uint32_t Fake_HostOut(USBD_HandleTypeDef *pdev, uint8_t ep_addr, const uint8_t *data,
+                      uint32_t len, uint8_t end);
+uint32_t Fake_HostIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *data, uint32_t size);
+void     Fake_Irq(USBD_HandleTypeDef *pdev);
+void     Fake_Sof(USBD_HandleTypeDef *pdev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FAKE_USBD_LL_H */
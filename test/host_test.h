@@ -0,0 +1,42 @@
+/**
+  ******************************************************************************
+  * @file    host_test.h
+  * @brief   Check macros of the host unit tests. A failed check is printed
+  *          and counted; the test exits with the count, so ctest fails.
+  ******************************************************************************
+  */
+
+#ifndef __HOST_TEST_H
+#define __HOST_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+static uint32_t HostTestFailures;
+
+#define CHECK(cond)                                                              \
+  do {                                                                           \
+    if (!(cond))                                                                 \
+    {                                                                            \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);            \
+      HostTestFailures++;                                                        \
+    }                                                                            \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                           \
+  do {                                                                           \
+    unsigned long check_a = (unsigned long)(a);                                  \
+    unsigned long check_b = (unsigned long)(b);                                  \
+    if (check_a != check_b)                                                      \
+    {                                                                            \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed: %lu != %lu\n", __FILE__, __LINE__, \
+             #a, #b, check_a, check_b);                                          \
+      HostTestFailures++;                                                        \
+    }                                                                            \
+  } while (0)
+
+#define TEST_RESULT()                                                            \
+  ((HostTestFailures == 0U) ? (printf("PASS\n"), 0)                              \
+                            : (printf("FAIL: %lu checks\n", (unsigned long)HostTestFailures), 1))
+
+#endif /* __HOST_TEST_H */
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Loopback throughput benchmark of the DCDC data pipes, run on the USB host.
+
+The firmware forwards everything written to one port of a pair out of the
+other (CDC_Bridge_Pump), so a pair is a loopback through the device: OUT
+endpoint, RX ring, TX queue, IN endpoint. This script streams a known byte
+pattern through it as fast as the host can write, one direction at a time
+and then both at once, checks every byte, and reports the sustained rate in
+kB/s and in full-speed bulk packets per 1 ms frame, next to the ~19 packet
+ceiling.
+
+Measure each firmware build, e.g. DCDC_DBLBUF_PORTS 0x00 (single buffered)
+and 0x03 (double buffered), and compare:
+
+    pip install pyserial
+    python3 loopback_bench.py /dev/ttyACM0 /dev/ttyACM1 --save sngbuf.json
+    python3 loopback_bench.py /dev/ttyACM0 /dev/ttyACM1 --compare sngbuf.json
+
+Exit status 0 if every byte came back intact in every pass.
+"""
+
+import argparse
+import json
+import sys
+import threading
+import time
+
+import serial
+
+FS_PACKET = 64          # full-speed bulk max packet size
+FS_FRAME_S = 0.001      # full-speed frame
+FS_CEILING = 19         # bulk packets per frame a full-speed host controller schedules at best
+PATTERN = bytes(range(256)) * 256
+
+
+class Stream:
+    """One direction of a pass: the pattern written to src must come out of dst."""
+
+    def __init__(self, name, src, dst, block, seconds, warmup):
+        self.name = name
+        self.src = src
+        self.dst = dst
+        self.block = block
+        self.seconds = seconds
+        self.warmup = warmup
+        self.sent = 0
+        self.received = 0
+        self.window = None      # (seconds, bytes) received after the warm-up
+        self.error = None
+        self.done = threading.Event()
+
+    def writer(self, start):
+        deadline = start + self.seconds
+        while time.monotonic() < deadline and self.error is None:
+            offset = self.sent % 256
+            self.sent += self.src.write(PATTERN[offset:offset + self.block])
+        self.src.flush()
+        self.done.set()
+
+    def reader(self, start):
+        begin = None
+        last = time.monotonic()
+        while self.error is None:
+            data = self.dst.read(max(1, min(self.dst.in_waiting, 65536)))
+            now = time.monotonic()
+            if data:
+                offset = self.received % 256
+                if data != PATTERN[offset:offset + len(data)]:
+                    self.error = "byte %d: pattern mismatch" % self.received
+                    break
+                self.received += len(data)
+                last = now
+                if begin is None and now - start >= self.warmup:
+                    begin = (now, self.received)
+                if begin is not None and now - start <= self.seconds:
+                    self.window = (now - begin[0], self.received - begin[1])
+            if self.done.is_set() and self.received >= self.sent:
+                break
+            if now - last > 2.0:
+                self.error = "%d of %d bytes received" % (self.received, self.sent)
+                break
+
+    def rate(self):
+        """Bytes per second over the measured window."""
+        if not self.window or self.window[0] <= 0.0:
+            return 0.0
+        return self.window[1] / self.window[0]
+
+
+def run_pass(name, pairs, args):
+    streams = [Stream(("%s %s" % (name, label)) if label else name, src, dst,
+                      args.block, args.seconds, args.warmup)
+               for label, src, dst in pairs]
+    for s in streams:
+        s.src.reset_output_buffer()
+        s.dst.reset_input_buffer()
+
+    start = time.monotonic()
+    threads = []
+    for s in streams:
+        threads.append(threading.Thread(target=s.writer, args=(start,)))
+        threads.append(threading.Thread(target=s.reader, args=(start,)))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return streams
+
+
+def report(name, streams):
+    result = {}
+    for s in streams:
+        rate = s.rate()
+        result[s.name] = {"kB/s": rate / 1000.0,
+                          "packets/frame": rate * FS_FRAME_S / FS_PACKET,
+                          "error": s.error}
+        print("%-10s %8.1f kB/s  %5.2f packets/frame of %d  %s" %
+              (s.name, rate / 1000.0, rate * FS_FRAME_S / FS_PACKET, FS_CEILING,
+               s.error if s.error else "ok"))
+    return result
+
+
+def compare(results, path):
+    with open(path) as f:
+        before = json.load(f)
+    print("\nagainst %s:" % path)
+    for name, now in results.items():
+        old = before.get(name)
+        if old is None or old["kB/s"] <= 0.0:
+            continue
+        print("%-10s %8.1f -> %8.1f kB/s  %+6.1f %%" %
+              (name, old["kB/s"], now["kB/s"], 100.0 * (now["kB/s"] / old["kB/s"] - 1.0)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("port_a", help="first port of the bridged pair")
+    parser.add_argument("port_b", help="second port of the bridged pair")
+    parser.add_argument("--seconds", type=float, default=10.0, help="duration of each pass")
+    parser.add_argument("--warmup", type=float, default=1.0, help="start of the measured window")
+    parser.add_argument("--block", type=int, default=4096, help="bytes per host write")
+    parser.add_argument("--save", help="write the results to this JSON file")
+    parser.add_argument("--compare", help="JSON file of an earlier run to compare with")
+    args = parser.parse_args()
+
+    a = serial.Serial(args.port_a, timeout=0.1)
+    b = serial.Serial(args.port_b, timeout=0.1)
+
+    results = {}
+    results.update(report("a->b", run_pass("a->b", [("", a, b)], args)))
+    results.update(report("b->a", run_pass("b->a", [("", b, a)], args)))
+    results.update(report("both", run_pass("both", [("a->b", a, b), ("b->a", b, a)], args)))
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(results, f, indent=2)
+    if args.compare:
+        compare(results, args.compare)
+
+    return 1 if any(r["error"] for r in results.values()) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
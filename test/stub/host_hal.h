@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file    host_hal.h
+  * @brief   The parts of the STM32 HAL and CMSIS core the USB device library
+  *          uses, for host builds of the unit tests.
+  *
+  *          The exclusive access intrinsics model the Cortex-M local monitor:
+  *          __STREXW fails if another exclusive access, or an exception,
+  *          came between it and its __LDREXW. Before every LDREX, STREX and
+  *          DMB, and after a successful STREX, the simulation calls
+  *          Host_Preempt, where a test may run a nested context the way an
+  *          interrupt would preempt the code; the hook returns nonzero if it
+  *          did.
+  ******************************************************************************
+  */
+
+#ifndef __HOST_HAL_H
+#define __HOST_HAL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO    volatile
+#define UNUSED(X) (void)X
+
+typedef enum
+{
+  HAL_OK       = 0x00U,
+  HAL_ERROR    = 0x01U,
+  HAL_BUSY     = 0x02U,
+  HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+/* What the class reads from the PCD handle */
+typedef struct
+{
+  uint32_t maxpacket;
+} PCD_EPTypeDef;
+
+typedef struct
+{
+  PCD_EPTypeDef IN_ep[8];
+  PCD_EPTypeDef OUT_ep[8];
+  void          *pData;
+} PCD_HandleTypeDef;
+
+void HAL_Delay(uint32_t Delay);
+
+/* Preemption point of the simulation, see the file header */
+extern uint8_t (*Host_PreemptHook)(void);
+extern volatile uint32_t *Host_ExclAddr;
+extern uint32_t Host_Primask;
+
+static inline void Host_Preempt(void)
+{
+  if ((Host_PreemptHook != NULL) && (Host_Primask == 0U) && (Host_PreemptHook() != 0U))
+  {
+    /* Exception entry and return clear the local monitor */
+    Host_ExclAddr = NULL;
+  }
+}
+
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+  Host_Preempt();
+  Host_ExclAddr = addr;
+  return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+  Host_Preempt();
+  if (Host_ExclAddr != addr)
+  {
+    return 1U;
+  }
+  Host_ExclAddr = NULL;
+  *addr = value;
+
+  /* The next instruction may be preempted as well */
+  Host_Preempt();
+  return 0U;
+}
+
+static inline void __CLREX(void)
+{
+  Host_ExclAddr = NULL;
+}
+
+static inline void __DMB(void)
+{
+  Host_Preempt();
+}
+
+static inline uint32_t __get_PRIMASK(void)
+{
+  return Host_Primask;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+  Host_Primask = primask;
+  Host_Preempt();
+}
+
+static inline void __disable_irq(void)
+{
+  Host_Primask = 1U;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_HAL_H */
@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    usbd_conf.h
+  * @brief   Host build configuration of the USB device library for the unit
+  *          tests. Stands in for Inc/usbd_conf.h; the DCDC options can be set
+  *          per test target with compile definitions.
+  ******************************************************************************
+  */
+
+#ifndef __USBD_CONF__H__
+#define __USBD_CONF__H__
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_hal.h"
+
+/*---------- -----------*/
+#ifndef DCDC_NUM_PORTS
+#define DCDC_NUM_PORTS     2U
+#endif /* DCDC_NUM_PORTS */
+/*---------- -----------*/
+#ifndef DCDC_DBLBUF_PORTS
+#define DCDC_DBLBUF_PORTS     0x00U
+#endif /* DCDC_DBLBUF_PORTS */
+/*---------- -----------*/
+#ifndef DCDC_VENDOR_ENABLE
+#define DCDC_VENDOR_ENABLE     0U
+#endif /* DCDC_VENDOR_ENABLE */
+/*---------- -----------*/
+#define DCDC_NCM_ENABLE     0U
+/*---------- -----------*/
+#define DCDC_PMA_DMA_MIN_SIZE     0U
+/*---------- -----------*/
+#define DCDC_USB_HP_IRQ     0U
+/*---------- -----------*/
+#define DCDC_DEFERRED     0U
+/*---------- -----------*/
+#define DCDC_ISR_PROFILE     0U
+/*---------- -----------*/
+#define USBD_MAX_NUM_INTERFACES     ((2U * DCDC_NUM_PORTS) + DCDC_VENDOR_ENABLE + (2U * DCDC_NCM_ENABLE))
+/*---------- -----------*/
+#define USBD_MAX_NUM_CONFIGURATION     1U
+/*---------- -----------*/
+#define USBD_MAX_STR_DESC_SIZ     512U
+/*---------- -----------*/
+#define USBD_DEBUG_LEVEL     0U
+/*---------- -----------*/
+#define USBD_LPM_ENABLED     1U
+/*---------- -----------*/
+#define USBD_SELF_POWERED     1U
+/*---------- -----------*/
+#define USBD_SUPPORT_USER_STRING_DESC     DCDC_NCM_ENABLE
+
+#define DEVICE_FS 		0
+
+/* Memory management macros */
+#define USBD_malloc         (uint32_t *)USBD_static_malloc
+#define USBD_free           USBD_static_free
+#define USBD_memset         /* Not used */
+#define USBD_memcpy         /* Not used */
+#define USBD_Delay          HAL_Delay
+
+/* DEBUG macros */
+#define USBD_UsrLog(...)
+#define USBD_ErrLog(...)
+#define USBD_DbgLog(...)
+
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF__H__ */
@@ -0,0 +1,367 @@
+/**
+  ******************************************************************************
+  * @file    test_dcdc_ports.c
+  * @brief   Host test of the DCDC class over the fake USBD_LL: for the
+  *          DCDC_NUM_PORTS it is built with, the configuration descriptor,
+  *          the endpoints opened by SET_CONFIGURATION, and that class
+  *          requests and data in both directions reach the right port.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_test.h"
+#include "fake_usbd_ll.h"
+#include "usbd_dcdc.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_XFER_SIZE  256U
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef TestDev;
+static uint8_t TestRx[DCDC_NUM_PIPES][TEST_XFER_SIZE];
+static uint8_t TestTx[DCDC_NUM_PIPES][TEST_XFER_SIZE];
+
+static uint8_t  TestRxPort;
+static uint32_t TestRxLen;
+static uint8_t  TestRxData[TEST_XFER_SIZE];
+static uint8_t  TestCtlPort;
+static uint8_t  TestCtlCmd;
+static uint32_t TestCtlRate;
+static uint32_t TestTxCplt[DCDC_NUM_PIPES];
+static uint32_t TestProcessCalls;
+
+/* Private functions ---------------------------------------------------------*/
+void USBD_DCDC_ProcessCallback(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+  TestProcessCalls++;
+}
+
+static int8_t Test_Init(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_SetRxBuffer(&TestDev, cdc, TestRx[cdc->Port]);
+  USBD_DCDC_SetRxXferSize(&TestDev, cdc, TEST_XFER_SIZE);
+  return USBD_OK;
+}
+
+static int8_t Test_DeInit(USBD_CDC_HandleTypeDef *cdc)
+{
+  UNUSED(cdc);
+  return USBD_OK;
+}
+
+static int8_t Test_Control(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  TestCtlPort = cdc->Port;
+  TestCtlCmd = cmd;
+  if ((cmd == CDC_SET_LINE_CODING) && (length >= 4U))
+  {
+    TestCtlRate = (uint32_t)pbuf[0] | ((uint32_t)pbuf[1] << 8) |
+                  ((uint32_t)pbuf[2] << 16) | ((uint32_t)pbuf[3] << 24);
+  }
+  return USBD_OK;
+}
+
+static int8_t Test_Receive(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  TestRxPort = cdc->Port;
+  TestRxLen = *Len;
+  memcpy(TestRxData, Buf, *Len);
+  USBD_DCDC_ReceivePacket(&TestDev, cdc);
+  return USBD_OK;
+}
+
+static int8_t Test_TransmitCplt(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  UNUSED(Buf);
+  UNUSED(Len);
+  TestTxCplt[cdc->Port]++;
+  return USBD_OK;
+}
+
+static USBD_DCDC_ItfTypeDef TestFops =
+{
+  Test_Init,
+  Test_DeInit,
+  Test_Control,
+  Test_Receive,
+  Test_TransmitCplt
+};
+
+static uint8_t TestDeviceDesc[USB_LEN_DEV_DESC] =
+{
+  USB_LEN_DEV_DESC, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0xEF, 0x02, 0x01, 0x40,
+  0x83, 0x04, 0x40, 0x57, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint8_t *Test_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(TestDeviceDesc);
+  return TestDeviceDesc;
+}
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Test_DeviceDescriptor
+};
+
+static USBD_CDC_HandleTypeDef *Test_Cdc(uint8_t port)
+{
+  return &((USBD_DCDC_HandleTypeDef *)TestDev.pClassData)->CDC[port];
+}
+
+/**
+  * @brief  Configuration descriptor: length, interfaces, one bulk pair and
+  *         one notification endpoint per port, no endpoint used twice.
+  */
+static void Test_ConfigDescriptor(void)
+{
+  uint8_t seen[2][FAKE_EP_COUNT] = {{0U}};
+  uint32_t interfaces = 0U;
+  uint32_t endpoints = 0U;
+  uint32_t total;
+  uint32_t i;
+  uint8_t *d = Fake.Ep0Data;
+  uint8_t port;
+
+  CHECK_EQ(Fake_Setup(&TestDev, 0x80U, USB_REQ_GET_DESCRIPTOR, (uint16_t)(USB_DESC_TYPE_CONFIGURATION << 8),
+                      0U, sizeof(Fake.Ep0Data), NULL), USBD_OK);
+
+  total = (uint32_t)d[2] | ((uint32_t)d[3] << 8);
+  CHECK_EQ(d[1], USB_DESC_TYPE_CONFIGURATION);
+  CHECK_EQ(total, Fake.Ep0Len);
+  CHECK_EQ(d[4], 2U * DCDC_NUM_PORTS);
+
+  /* The descriptors fill wTotalLength exactly */
+  for (i = 0U; (i < total) && (d[i] != 0U); i += d[i])
+  {
+    if (d[i + 1U] == USB_DESC_TYPE_INTERFACE)
+    {
+      interfaces++;
+    }
+    else if (d[i + 1U] == USB_DESC_TYPE_ENDPOINT)
+    {
+      uint8_t ep = d[i + 2U];
+
+      endpoints++;
+      CHECK((ep & 0x7FU) != 0U);
+      CHECK((ep & 0x7FU) < FAKE_EP_COUNT);
+      CHECK_EQ(seen[ep >> 7][ep & 0x7U], 0U);
+      seen[ep >> 7][ep & 0x7U] = 1U;
+    }
+  }
+  CHECK_EQ(i, total);
+  CHECK_EQ(interfaces, 2U * DCDC_NUM_PORTS);
+  CHECK_EQ(endpoints, 3U * DCDC_NUM_PORTS);
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    CHECK(seen[1][DCDC_IN_EP(port) & 0x7U]);
+    CHECK(seen[0][DCDC_OUT_EP(port) & 0x7U]);
+    CHECK(seen[1][DCDC_CMD_EP(port) & 0x7U]);
+  }
+}
+
+/**
+  * @brief  SET_CONFIGURATION opens every port's endpoints and arms OUT.
+  */
+static void Test_Configure(void)
+{
+  uint8_t port;
+
+  CHECK_EQ(Fake_Setup(&TestDev, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL), USBD_OK);
+  CHECK_EQ(TestDev.dev_state, USBD_STATE_CONFIGURED);
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    FakeEpTypeDef *in = &Fake.In[DCDC_IN_EP(port) & 0x7U];
+    FakeEpTypeDef *out = &Fake.Out[DCDC_OUT_EP(port) & 0x7U];
+    FakeEpTypeDef *cmd = &Fake.In[DCDC_CMD_EP(port) & 0x7U];
+
+    CHECK(in->Open && (in->Type == USBD_EP_TYPE_BULK) && (in->Mps == DCDC_DATA_FS_MAX_PACKET_SIZE));
+    CHECK(out->Open && (out->Type == USBD_EP_TYPE_BULK) && (out->Mps == DCDC_DATA_FS_MAX_PACKET_SIZE));
+    CHECK(cmd->Open && (cmd->Type == USBD_EP_TYPE_INTR));
+    CHECK(out->Armed && (out->Buf == TestRx[port]) && (out->Len == TEST_XFER_SIZE));
+    CHECK_EQ(in->Armed, 0U);
+    CHECK_EQ(Test_Cdc(port)->Itf, 2U * port);
+  }
+
+  /* Nothing beyond the ports' endpoints */
+  CHECK_EQ(Fake.In[(DCDC_CMD_EP(DCDC_NUM_PORTS - 1U) & 0x7U) + 1U].Open, 0U);
+  CHECK_EQ(Fake.Out[(DCDC_OUT_EP(DCDC_NUM_PORTS - 1U) & 0x7U) + 1U].Open, 0U);
+}
+
+/**
+  * @brief  SET_LINE_CODING to each communication interface reaches its port.
+  */
+static void Test_Control_Routing(void)
+{
+  uint8_t coding[7] = {0U, 0U, 0U, 0U, 0U, 0U, 8U};
+  uint32_t rate;
+  uint8_t port;
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    rate = 9600U * (port + 1U);
+    coding[0] = (uint8_t)rate;
+    coding[1] = (uint8_t)(rate >> 8);
+    coding[2] = (uint8_t)(rate >> 16);
+    TestCtlPort = 0xFFU;
+
+    CHECK_EQ(Fake_Setup(&TestDev, 0x21U, CDC_SET_LINE_CODING, 0U, (uint16_t)(2U * port),
+                        sizeof(coding), coding), USBD_OK);
+    CHECK_EQ(TestCtlPort, port);
+    CHECK_EQ(TestCtlCmd, CDC_SET_LINE_CODING);
+    CHECK_EQ(TestCtlRate, rate);
+  }
+}
+
+/**
+  * @brief  OUT data of each port reaches the Receive callback of that port,
+  *         ended by a short packet or by a full transfer (no ZLP then).
+  */
+static void Test_Out_Routing(void)
+{
+  uint8_t data[TEST_XFER_SIZE];
+  uint32_t lens[3] = {10U, DCDC_DATA_FS_MAX_PACKET_SIZE + 1U, TEST_XFER_SIZE};
+  uint32_t i;
+  uint32_t n;
+  uint8_t port;
+
+  for (n = 0U; n < 3U; n++)
+  {
+    for (port = 0U; port < DCDC_NUM_PORTS; port++)
+    {
+      for (i = 0U; i < lens[n]; i++)
+      {
+        data[i] = (uint8_t)((port << 6) + i + n);
+      }
+      TestRxPort = 0xFFU;
+      TestRxLen = 0U;
+
+      CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(port), data, lens[n],
+                            (uint8_t)(lens[n] != TEST_XFER_SIZE)), lens[n]);
+      CHECK_EQ(TestRxPort, port);
+      CHECK_EQ(TestRxLen, lens[n]);
+      CHECK(memcmp(TestRxData, data, lens[n]) == 0);
+      CHECK(Fake.Out[DCDC_OUT_EP(port) & 0x7U].Armed);
+    }
+  }
+}
+
+/**
+  * @brief  IN data of each port leaves on that port's endpoint only, with a
+  *         ZLP after a transfer of whole packets.
+  */
+static void Test_In_Routing(void)
+{
+  uint8_t data[TEST_XFER_SIZE];
+  uint32_t lens[2] = {10U, DCDC_DATA_FS_MAX_PACKET_SIZE};
+  uint32_t transfers;
+  uint32_t i;
+  uint32_t n;
+  uint8_t port;
+  uint8_t other;
+
+  for (n = 0U; n < 2U; n++)
+  {
+    for (port = 0U; port < DCDC_NUM_PORTS; port++)
+    {
+      for (i = 0U; i < lens[n]; i++)
+      {
+        TestTx[port][i] = (uint8_t)((port << 5) ^ i ^ n);
+      }
+      TestTxCplt[port] = 0U;
+      transfers = Fake.In[DCDC_IN_EP(port) & 0x7U].Transfers;
+
+      CHECK_EQ(USBD_DCDC_SetTxBuffer(&TestDev, Test_Cdc(port), TestTx[port], (uint16_t)lens[n]), USBD_OK);
+      CHECK_EQ(USBD_DCDC_TransmitPacket(&TestDev, Test_Cdc(port)), USBD_OK);
+
+      for (other = 0U; other < DCDC_NUM_PORTS; other++)
+      {
+        CHECK_EQ(Fake.In[DCDC_IN_EP(other) & 0x7U].Armed, (other == port));
+      }
+
+      CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(port), data, sizeof(data)), lens[n]);
+      CHECK(memcmp(data, TestTx[port], lens[n]) == 0);
+
+      /* The host read ends on the short packet, or on the ZLP */
+      CHECK_EQ(Fake.In[DCDC_IN_EP(port) & 0x7U].Transfers - transfers,
+               ((lens[n] % DCDC_DATA_FS_MAX_PACKET_SIZE) == 0U) ? 2U : 1U);
+      CHECK_EQ(Fake.In[DCDC_IN_EP(port) & 0x7U].Armed, 0U);
+      CHECK_EQ(Test_Cdc(port)->TxState, 0U);
+      CHECK_EQ(TestTxCplt[port], 1U);
+    }
+  }
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+}
+
+/**
+  * @brief  SET_PORT_COUNT: the class signals USBD_DCDC_ProcessCallback,
+  *         and USBD_DCDC_Process names the time of each switch stage, then
+  *         idles until the host configures the new layout.
+  */
+static void Test_PortCount(void)
+{
+  const uint8_t ports = 1U;
+
+  TestProcessCalls = 0U;
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_PROCESS_IDLE);
+
+  CHECK_EQ(Fake_Setup(&TestDev, 0x40U, DCDC_REQ_SET_PORT_COUNT, ports, 0U, 0U, NULL), USBD_OK);
+  CHECK_EQ(TestProcessCalls, 1U);
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_REENUM_ACK_MS);
+  CHECK(Fake.Connected);
+
+  Fake.Tick += DCDC_REENUM_ACK_MS;
+  if (DCDC_NUM_PORTS == ports)
+  {
+    /* Already the layout asked for: nothing to switch */
+    CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_PROCESS_IDLE);
+    CHECK(Fake.Connected);
+    return;
+  }
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_REENUM_OFF_MS);
+  CHECK_EQ(Fake.Connected, 0U);
+
+  Fake.Tick += DCDC_REENUM_OFF_MS - 1U;
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), 1U);
+  CHECK_EQ(Fake.Connected, 0U);
+
+  Fake.Tick++;
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_PROCESS_IDLE);
+  CHECK(Fake.Connected);
+  CHECK_EQ(USBD_DCDC_GetPortCount(), ports);
+
+  /* The host configures the new layout: signalled again, for the log */
+  Fake_Enumerate(&TestDev);
+  CHECK_EQ(Fake_Setup(&TestDev, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL), USBD_OK);
+  CHECK_EQ(TestProcessCalls, 2U);
+  CHECK_EQ(USBD_DCDC_ReenumStats.Switches, 1U);
+  CHECK_EQ(USBD_DCDC_ReenumStats.LastMs, DCDC_REENUM_ACK_MS + DCDC_REENUM_OFF_MS);
+  CHECK_EQ(USBD_DCDC_Process(&TestDev), DCDC_PROCESS_IDLE);
+  CHECK_EQ(TestProcessCalls, 2U);
+}
+
+int main(void)
+{
+  printf("DCDC_NUM_PORTS %u\n", (unsigned)DCDC_NUM_PORTS);
+
+  Fake_Reset();
+  CHECK_EQ(USBD_Init(&TestDev, &TestDesc, DEVICE_FS), USBD_OK);
+  CHECK_EQ(USBD_RegisterClass(&TestDev, &USBD_DCDC), USBD_OK);
+  CHECK_EQ(USBD_DCDC_RegisterInterface(&TestDev, &TestFops), USBD_OK);
+  CHECK_EQ(USBD_Start(&TestDev), USBD_OK);
+  CHECK_EQ(USBD_DCDC_GetPortCount(), DCDC_NUM_PORTS);
+
+  Fake_Enumerate(&TestDev);
+  Test_ConfigDescriptor();
+  Test_Configure();
+  Test_Control_Routing();
+  Test_Out_Routing();
+  Test_In_Routing();
+  Test_PortCount();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,349 @@
+/**
+  ******************************************************************************
+  * @file    test_ncm_ntb.c
+  * @brief   Host test of the NTB16 codec: builder to reader round trips, and
+  *          the reader on malformed NTH16 and NDP16 input. Whatever the
+  *          input, the reader must return datagrams inside the block only,
+  *          and must end.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "host_test.h"
+#include "usbd_ncm_ntb.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_NTB_SIZE   2048U
+#define TEST_MAX_STEPS  (4U * TEST_NTB_SIZE)
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t TestNtb[TEST_NTB_SIZE];
+static uint8_t TestDg[2U * TEST_NTB_SIZE];                 /* Datagrams of a round, up to one past full */
+static uint32_t TestSeed = 1U;
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Test_Rand(void)
+{
+  TestSeed = (TestSeed * 1103515245U) + 12345U;
+  return TestSeed >> 8;
+}
+
+static void Test_Put16(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void Test_Put32(uint8_t *p, uint32_t v)
+{
+  Test_Put16(p, v);
+  Test_Put16(p + 2, v >> 16);
+}
+
+/**
+  * @brief  Reads every datagram of an NTB of len bytes.
+  * @retval Datagrams read, or -1 on NCM_NTB_ERROR; any datagram outside the
+  *         block, or a reader that does not end, fails a check
+  */
+static int Test_ReadAll(const uint8_t *ntb, uint32_t len)
+{
+  NCM_NtbReaderTypeDef r;
+  const uint8_t *dg;
+  uint16_t dg_len;
+  uint32_t steps;
+  uint8_t status;
+  int count = 0;
+
+  if (NCM_NtbOpen(&r, ntb, len) != NCM_NTB_OK)
+  {
+    return -1;
+  }
+  CHECK(r.Len <= len);
+
+  for (steps = 0U; steps < TEST_MAX_STEPS; steps++)
+  {
+    status = NCM_NtbNext(&r, &dg, &dg_len);
+
+    if (status != NCM_NTB_OK)
+    {
+      /* Done or malformed: the reader stays done */
+      CHECK((status == NCM_NTB_END) || (status == NCM_NTB_ERROR));
+      CHECK_EQ(NCM_NtbNext(&r, &dg, &dg_len), NCM_NTB_END);
+      return (status == NCM_NTB_END) ? count : -1;
+    }
+    CHECK(dg_len != 0U);
+    CHECK(dg >= (ntb + NCM_NTH16_SIZE));
+    CHECK((dg + dg_len) <= (ntb + r.Len));
+    count++;
+  }
+
+  CHECK(steps < TEST_MAX_STEPS);
+  return -1;
+}
+
+/**
+  * @brief  Hand-made NTB: NTH16 at 0, NDP16 at ndp with two datagrams at 32
+  *         and 64, block length block.
+  */
+static uint32_t Test_Handmade(uint32_t ndp, uint32_t block)
+{
+  memset(TestNtb, 0, sizeof(TestNtb));
+  Test_Put32(&TestNtb[0], NCM_NTH16_SIGNATURE);
+  Test_Put16(&TestNtb[4], NCM_NTH16_SIZE);
+  Test_Put16(&TestNtb[6], 7U);
+  Test_Put16(&TestNtb[8], block);
+  Test_Put16(&TestNtb[10], ndp);
+
+  memset(&TestNtb[32], 0xA5, 20U);
+  memset(&TestNtb[64], 0x5A, 30U);
+
+  Test_Put32(&TestNtb[ndp], NCM_NDP16_SIGNATURE);
+  Test_Put16(&TestNtb[ndp + 4U], 20U);
+  Test_Put16(&TestNtb[ndp + 6U], 0U);
+  Test_Put16(&TestNtb[ndp + 8U], 32U);
+  Test_Put16(&TestNtb[ndp + 10U], 20U);
+  Test_Put16(&TestNtb[ndp + 12U], 64U);
+  Test_Put16(&TestNtb[ndp + 14U], 30U);
+  Test_Put16(&TestNtb[ndp + 16U], 0U);
+  Test_Put16(&TestNtb[ndp + 18U], 0U);
+
+  return block;
+}
+
+/**
+  * @brief  Datagrams of many lengths survive the builder and the reader.
+  */
+static void Test_RoundTrip(void)
+{
+  NCM_NtbBuilderTypeDef b;
+  NCM_NtbReaderTypeDef r;
+  const uint8_t *dg;
+  uint16_t dg_len;
+  uint16_t lens[NCM_NTB_MAX_DATAGRAMS];
+  uint32_t total;
+  uint32_t off;
+  uint32_t round;
+  uint16_t i;
+  uint16_t n;
+
+  for (round = 0U; round < 200U; round++)
+  {
+    NCM_NtbInit(&b, TestNtb, 64U + (Test_Rand() % (TEST_NTB_SIZE - 64U)), (uint16_t)round);
+    CHECK_EQ(NCM_NtbFinish(&b), 0U);
+
+    for (n = 0U, off = 0U; n < NCM_NTB_MAX_DATAGRAMS; n++)
+    {
+      lens[n] = (uint16_t)(1U + (Test_Rand() % 300U));
+      for (i = 0U; i < lens[n]; i++)
+      {
+        TestDg[off + i] = (uint8_t)Test_Rand();
+      }
+      if (NCM_NtbAdd(&b, &TestDg[off], lens[n]) != NCM_NTB_OK)
+      {
+        break;
+      }
+      off += lens[n];
+    }
+    CHECK_EQ(NCM_NtbAdd(&b, TestDg, 0U), NCM_NTB_FULL);
+
+    total = NCM_NtbFinish(&b);
+    CHECK((n == 0U) ? (total == 0U) : (total <= b.Size));
+    if (n == 0U)
+    {
+      continue;
+    }
+
+    CHECK_EQ(NCM_NtbOpen(&r, TestNtb, total), NCM_NTB_OK);
+    for (i = 0U, off = 0U; i < n; i++)
+    {
+      CHECK_EQ(NCM_NtbNext(&r, &dg, &dg_len), NCM_NTB_OK);
+      CHECK_EQ(dg_len, lens[i]);
+      CHECK(memcmp(dg, &TestDg[off], lens[i]) == 0);
+      CHECK_EQ((uint32_t)(dg - TestNtb) % NCM_NTB_ALIGN, 0U);
+      off += lens[i];
+    }
+    CHECK_EQ(NCM_NtbNext(&r, &dg, &dg_len), NCM_NTB_END);
+  }
+
+  /* NCM_NTB_MAX_DATAGRAMS is the limit, even with room left */
+  NCM_NtbInit(&b, TestNtb, TEST_NTB_SIZE, 0U);
+  for (n = 0U; n < NCM_NTB_MAX_DATAGRAMS; n++)
+  {
+    CHECK_EQ(NCM_NtbAdd(&b, TestDg, 1U), NCM_NTB_OK);
+  }
+  CHECK_EQ(NCM_NtbAdd(&b, TestDg, 1U), NCM_NTB_FULL);
+  CHECK_EQ(Test_ReadAll(TestNtb, NCM_NtbFinish(&b)), NCM_NTB_MAX_DATAGRAMS);
+}
+
+/**
+  * @brief  Malformed NTH16: every case is refused by NCM_NtbOpen.
+  */
+static void Test_BadNth(void)
+{
+  NCM_NtbReaderTypeDef r;
+  uint32_t len;
+
+  CHECK_EQ(Test_ReadAll(TestNtb, Test_Handmade(12U, 100U)), 2);
+
+  /* Shorter than an NTH16 */
+  for (len = 0U; len < NCM_NTH16_SIZE; len++)
+  {
+    CHECK_EQ(NCM_NtbOpen(&r, TestNtb, len), NCM_NTB_ERROR);
+  }
+
+  /* Signature, header length */
+  Test_Handmade(12U, 100U);
+  TestNtb[3] ^= 0x01U;
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+
+  Test_Handmade(12U, 100U);
+  Test_Put16(&TestNtb[4], NCM_NTH16_SIZE + 4U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+
+  /* Block length beyond the transfer; 0 means the whole transfer */
+  CHECK_EQ(Test_ReadAll(TestNtb, Test_Handmade(12U, 101U) - 1U), -1);
+  CHECK_EQ(Test_ReadAll(TestNtb, Test_Handmade(12U, 0U) + 100U), 2);
+
+  /* NDP index inside the NTH16, unaligned, or with no room for its header */
+  CHECK_EQ(Test_ReadAll(TestNtb, Test_Handmade(12U, 100U)), 2);
+  Test_Put16(&TestNtb[10], 8U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+  Test_Put16(&TestNtb[10], 14U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+  Test_Put16(&TestNtb[10], 96U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+  Test_Put16(&TestNtb[10], 0xFFFCU);
+  CHECK_EQ(Test_ReadAll(TestNtb, 100U), -1);
+}
+
+/**
+  * @brief  Malformed NDP16 and datagram pointers: NCM_NtbNext reports
+  *         NCM_NTB_ERROR and stays done.
+  */
+static void Test_BadNdp(void)
+{
+  const uint32_t ndp = 96U;
+
+  /* Signature; the CRC variant is accepted */
+  Test_Handmade(ndp, 128U);
+  TestNtb[ndp] ^= 0x80U;
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Handmade(ndp, 128U);
+  Test_Put32(&TestNtb[ndp], NCM_NDP16_CRC_SIGNATURE);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), 2);
+
+  /* wLength below the minimum, not a multiple of 4, past the block */
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 4U], 12U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Put16(&TestNtb[ndp + 4U], 18U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Put16(&TestNtb[ndp + 4U], 36U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  CHECK_EQ(Test_ReadAll(TestNtb, Test_Handmade(ndp, 112U)), -1);
+
+  /* A datagram inside the NTH16, or running past the block */
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 8U], 4U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 14U], 65U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 14U], 64U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), 2);
+  Test_Put16(&TestNtb[ndp + 12U], 0xFFF0U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+
+  /* A zero index or length ends the table */
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 12U], 0U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), 1);
+  Test_Handmade(ndp, 128U);
+  Test_Put16(&TestNtb[ndp + 10U], 0U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), 0);
+
+  /* Chains: forward is followed, a loop or a bad next index is refused */
+  Test_Handmade(12U, 128U);
+  Test_Put32(&TestNtb[ndp], NCM_NDP16_SIGNATURE);
+  Test_Put16(&TestNtb[ndp + 4U], 16U);
+  Test_Put16(&TestNtb[ndp + 6U], 0U);
+  Test_Put16(&TestNtb[ndp + 8U], 32U);
+  Test_Put16(&TestNtb[ndp + 10U], 4U);
+  Test_Put16(&TestNtb[12U + 6U], ndp);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), 3);
+
+  Test_Put16(&TestNtb[ndp + 6U], 12U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Put16(&TestNtb[ndp + 6U], ndp);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Put16(&TestNtb[ndp + 6U], 0U);
+  Test_Put16(&TestNtb[12U + 6U], ndp + 2U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+  Test_Put16(&TestNtb[12U + 6U], 124U);
+  CHECK_EQ(Test_ReadAll(TestNtb, 128U), -1);
+}
+
+/**
+  * @brief  Truncated transfers and random corruption of a built NTB: the
+  *         reader never hands out bytes past the transfer, and ends.
+  */
+static void Test_Corrupt(void)
+{
+  NCM_NtbBuilderTypeDef b;
+  uint8_t good[512];
+  uint32_t total;
+  uint32_t len;
+  uint32_t round;
+  uint32_t flips;
+  uint16_t i;
+
+  NCM_NtbInit(&b, TestNtb, sizeof(good), 1U);
+  for (i = 0U; i < 6U; i++)
+  {
+    memset(TestDg, (int)i, 50U);
+    CHECK_EQ(NCM_NtbAdd(&b, TestDg, (uint16_t)(10U + (13U * i))), NCM_NTB_OK);
+  }
+  total = NCM_NtbFinish(&b);
+  memcpy(good, TestNtb, total);
+
+  /* Truncated, with the block length as built and with 0 */
+  for (len = 0U; len < total; len++)
+  {
+    CHECK_EQ(Test_ReadAll(good, len), -1);
+  }
+  Test_Put16(&good[8], 0U);
+  for (len = 0U; len <= total; len++)
+  {
+    (void)Test_ReadAll(good, len);
+  }
+  Test_Put16(&good[8], total);
+
+  for (round = 0U; round < 20000U; round++)
+  {
+    memcpy(TestNtb, good, total);
+    for (flips = 1U + (Test_Rand() % 4U); flips != 0U; flips--)
+    {
+      /* Mostly the headers, where the pointers are */
+      i = (uint16_t)(((Test_Rand() & 1U) != 0U) ? (Test_Rand() % NCM_NTH16_SIZE)
+                                                 : (Test_Rand() % total));
+      if ((i >= NCM_NTH16_SIZE) && ((Test_Rand() & 1U) != 0U))
+      {
+        i = (uint16_t)(total - 1U - (Test_Rand() % (total - b.Len)));
+      }
+      TestNtb[i] = (uint8_t)Test_Rand();
+    }
+    (void)Test_ReadAll(TestNtb, total - (Test_Rand() % 4U));
+  }
+}
+
+int main(void)
+{
+  Test_RoundTrip();
+  Test_BadNth();
+  Test_BadNdp();
+  Test_Corrupt();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,209 @@
+/**
+  ******************************************************************************
+  * @file    test_pma_copy.c
+  * @brief   Host test of USB_WritePMA and USB_ReadPMA of the LL USB driver
+  *          against the halfword loops they replaced, byte for byte: user
+  *          buffer alignments 0 to 3, lengths 0 to 70, several PMA offsets.
+  *
+  *          The driver turns the peripheral address into a uint32_t, so the
+  *          fake USB peripheral, PMA included, is mapped below 4 GB.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <string.h>
+#include <sys/mman.h>
+#include "host_test.h"
+#include "stm32g4xx_hal.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_PMA_SIZE    1024U
+#define TEST_MAX_LEN     70U
+#define TEST_GUARD       8U
+#define TEST_SKIP        77
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t *TestUsb;                                   /* Registers, then the PMA at 0x400 */
+static uint32_t TestSeed = 1U;
+
+static const uint16_t TestPmaAddr[] = {0x000U, 0x002U, 0x006U, 0x040U, 0x1BEU, 0x3B8U};
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Test_Rand(void)
+{
+  TestSeed = (TestSeed * 1103515245U) + 12345U;
+  return TestSeed >> 8;
+}
+
+static void Test_Fill(uint8_t *buf, uint32_t len)
+{
+  uint32_t i;
+
+  for (i = 0U; i < len; i++)
+  {
+    buf[i] = (uint8_t)Test_Rand();
+  }
+}
+
+/* The routines as they were before the word-wide copy */
+static void Old_WritePMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+  uint32_t n = ((uint32_t)wNBytes + 1U) >> 1;
+  uint32_t BaseAddr = (uint32_t)USBx;
+  uint32_t i, temp1, temp2;
+  __IO uint16_t *pdwVal;
+  uint8_t *pBuf = pbUsrBuf;
+
+  pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
+
+  for (i = n; i != 0U; i--)
+  {
+    temp1 = *pBuf;
+    pBuf++;
+    temp2 = temp1 | ((uint16_t)((uint16_t) *pBuf << 8));
+    *pdwVal = (uint16_t)temp2;
+    pdwVal++;
+
+#if PMA_ACCESS > 1U
+    pdwVal++;
+#endif
+
+    pBuf++;
+  }
+}
+
+static void Old_ReadPMA(USB_TypeDef *USBx, uint8_t *pbUsrBuf, uint16_t wPMABufAddr, uint16_t wNBytes)
+{
+  uint32_t n = (uint32_t)wNBytes >> 1;
+  uint32_t BaseAddr = (uint32_t)USBx;
+  uint32_t i, temp;
+  __IO uint16_t *pdwVal;
+  uint8_t *pBuf = pbUsrBuf;
+
+  pdwVal = (__IO uint16_t *)(BaseAddr + 0x400U + ((uint32_t)wPMABufAddr * PMA_ACCESS));
+
+  for (i = n; i != 0U; i--)
+  {
+    temp = *(__IO uint16_t *)pdwVal;
+    pdwVal++;
+    *pBuf = (uint8_t)((temp >> 0) & 0xFFU);
+    pBuf++;
+    *pBuf = (uint8_t)((temp >> 8) & 0xFFU);
+    pBuf++;
+
+#if PMA_ACCESS > 1U
+    pdwVal++;
+#endif
+  }
+
+  if ((wNBytes % 2U) != 0U)
+  {
+    temp = *pdwVal;
+    *pBuf = (uint8_t)((temp >> 0) & 0xFFU);
+  }
+}
+
+/**
+  * @brief  USB_WritePMA leaves the PMA as the old loop does, and puts the
+  *         user bytes there (an odd length also stores the byte after).
+  */
+static void Test_Write(uint32_t align, uint32_t len, uint16_t pma)
+{
+  uint32_t src_words[(TEST_MAX_LEN + (2U * TEST_GUARD)) / 4U];
+  uint8_t *src = (uint8_t *)src_words + align;
+  uint8_t before[TEST_PMA_SIZE];
+  uint8_t old[TEST_PMA_SIZE];
+  uint8_t *pmem = TestUsb + 0x400U;
+
+  Test_Fill((uint8_t *)src_words, sizeof(src_words));
+  Test_Fill(before, sizeof(before));
+
+  memcpy(pmem, before, TEST_PMA_SIZE);
+  Old_WritePMA((USB_TypeDef *)(void *)TestUsb, src, pma, (uint16_t)len);
+  memcpy(old, pmem, TEST_PMA_SIZE);
+
+  memcpy(pmem, before, TEST_PMA_SIZE);
+  USB_WritePMA((USB_TypeDef *)(void *)TestUsb, src, pma, (uint16_t)len);
+
+  CHECK(memcmp(pmem, old, TEST_PMA_SIZE) == 0);
+  CHECK(memcmp(&pmem[pma], src, len) == 0);
+  CHECK(memcmp(&pmem[pma + len + (len & 1U)], &before[pma + len + (len & 1U)],
+               TEST_PMA_SIZE - (pma + len + (len & 1U))) == 0);
+
+  if (memcmp(pmem, old, TEST_PMA_SIZE) != 0)
+  {
+    printf("  write: align %lu, length %lu, PMA 0x%03X\n",
+           (unsigned long)align, (unsigned long)len, (unsigned)pma);
+  }
+}
+
+/**
+  * @brief  USB_ReadPMA fills the user buffer as the old loop does: the
+  *         length in bytes, nothing before or after.
+  */
+static void Test_Read(uint32_t align, uint32_t len, uint16_t pma)
+{
+  uint32_t dst_words[(TEST_MAX_LEN + (2U * TEST_GUARD)) / 4U];
+  uint8_t *dst = (uint8_t *)dst_words + TEST_GUARD + align;
+  uint8_t before[sizeof(dst_words)];
+  uint8_t old[sizeof(dst_words)];
+  uint8_t *pmem = TestUsb + 0x400U;
+
+  Test_Fill(pmem, TEST_PMA_SIZE);
+  Test_Fill(before, sizeof(before));
+
+  memcpy(dst_words, before, sizeof(before));
+  Old_ReadPMA((USB_TypeDef *)(void *)TestUsb, dst, pma, (uint16_t)len);
+  memcpy(old, dst_words, sizeof(old));
+
+  memcpy(dst_words, before, sizeof(before));
+  USB_ReadPMA((USB_TypeDef *)(void *)TestUsb, dst, pma, (uint16_t)len);
+
+  CHECK(memcmp(dst_words, old, sizeof(old)) == 0);
+  CHECK(memcmp(dst, &pmem[pma], len) == 0);
+  CHECK(memcmp(dst_words, before, TEST_GUARD + align) == 0);
+  CHECK(memcmp(dst + len, &before[TEST_GUARD + align + len],
+               sizeof(before) - (TEST_GUARD + align + len)) == 0);
+
+  if (memcmp(dst_words, old, sizeof(old)) != 0)
+  {
+    printf("  read: align %lu, length %lu, PMA 0x%03X\n",
+           (unsigned long)align, (unsigned long)len, (unsigned)pma);
+  }
+}
+
+int main(void)
+{
+  uint32_t align;
+  uint32_t len;
+  uint32_t p;
+
+#ifdef MAP_32BIT
+  TestUsb = mmap(NULL, 0x400U + TEST_PMA_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+#endif /* MAP_32BIT */
+
+  if ((TestUsb == NULL) || (TestUsb == MAP_FAILED))
+  {
+    printf("SKIP: no mapping below 4 GB on this host\n");
+    return TEST_SKIP;
+  }
+
+  for (p = 0U; p < (sizeof(TestPmaAddr) / sizeof(TestPmaAddr[0])); p++)
+  {
+    for (align = 0U; align < 4U; align++)
+    {
+      for (len = 0U; len <= TEST_MAX_LEN; len++)
+      {
+        if ((TestPmaAddr[p] + len + 1U) <= TEST_PMA_SIZE)
+        {
+          Test_Write(align, len, TestPmaAddr[p]);
+          Test_Read(align, len, TestPmaAddr[p]);
+        }
+      }
+    }
+  }
+
+  return TEST_RESULT();
+}
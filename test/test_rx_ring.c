@@ -0,0 +1,224 @@
+/**
+  ******************************************************************************
+  * @file    test_rx_ring.c
+  * @brief   Host test of the RX ring of the DCDC ports: slots filled in
+  *          order, the OUT endpoint re-armed before the Receive callback,
+  *          reception paused while the ring is full, and the message size
+  *          limit of message mode.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_test.h"
+#include "fake_usbd_ll.h"
+#include "usbd_dcdc.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_MPS         DCDC_DATA_FS_MAX_PACKET_SIZE
+#define TEST_SLOT_SIZE   (4U * TEST_MPS)
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef TestDev;
+static uint8_t TestRxRing[DCDC_NUM_PIPES][DCDC_RX_SLOTS * TEST_SLOT_SIZE];
+static uint8_t TestData[2U * TEST_SLOT_SIZE];
+
+static uint32_t TestReceives;
+static uint8_t  TestArmedInReceive;                        /* OUT endpoint state seen by the last Receive */
+static uint8_t  *TestRxBuf;
+static uint32_t TestRxLen;
+
+/* Private functions ---------------------------------------------------------*/
+static int8_t Test_Init(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_SetRxRing(&TestDev, cdc, TestRxRing[cdc->Port], TEST_SLOT_SIZE);
+  return USBD_OK;
+}
+
+static int8_t Test_DeInit(USBD_CDC_HandleTypeDef *cdc)
+{
+  UNUSED(cdc);
+  return USBD_OK;
+}
+
+static int8_t Test_Control(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  UNUSED(cdc);
+  UNUSED(cmd);
+  UNUSED(pbuf);
+  UNUSED(length);
+  return USBD_OK;
+}
+
+static int8_t Test_Receive(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  TestReceives++;
+  TestArmedInReceive = Fake.Out[cdc->OutEp & 0x7U].Armed;
+  TestRxBuf = Buf;
+  TestRxLen = *Len;
+  return USBD_OK;
+}
+
+static USBD_DCDC_ItfTypeDef TestFops =
+{
+  Test_Init,
+  Test_DeInit,
+  Test_Control,
+  Test_Receive,
+  NULL
+};
+
+static uint8_t TestDeviceDesc[USB_LEN_DEV_DESC] =
+{
+  USB_LEN_DEV_DESC, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0xEF, 0x02, 0x01, 0x40,
+  0x83, 0x04, 0x40, 0x57, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint8_t *Test_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(TestDeviceDesc);
+  return TestDeviceDesc;
+}
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Test_DeviceDescriptor
+};
+
+static USBD_CDC_HandleTypeDef *Test_Cdc(uint8_t port)
+{
+  return &((USBD_DCDC_HandleTypeDef *)TestDev.pClassData)->CDC[port];
+}
+
+static void Test_Fill(uint32_t len, uint32_t seed)
+{
+  uint32_t i;
+
+  for (i = 0U; i < len; i++)
+  {
+    TestData[i] = (uint8_t)((seed * 13U) + i);
+  }
+}
+
+/**
+  * @brief  Byte mode: every transfer lands in the next slot, and the
+  *         Receive callback finds the endpoint armed already, except when
+  *         its slot was the last free one; RxRelease then resumes.
+  */
+static void Test_Ring(void)
+{
+  USBD_CDC_HandleTypeDef *cdc = Test_Cdc(0U);
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+  FakeEpTypeDef *out = &Fake.Out[DCDC_OUT_EP(0U) & 0x7U];
+  uint8_t *slot;
+  uint32_t len;
+  uint32_t n;
+
+  for (n = 0U; n < DCDC_RX_SLOTS; n++)
+  {
+    len = 1U + ((n * 37U) % TEST_SLOT_SIZE);
+    Test_Fill(len, n);
+    TestReceives = 0U;
+
+    CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, len, 1U), len);
+    CHECK_EQ(TestReceives, 1U);
+    CHECK_EQ(TestRxLen, len);
+    CHECK(TestRxBuf == &TestRxRing[0][n * TEST_SLOT_SIZE]);
+    CHECK(memcmp(TestRxBuf, TestData, len) == 0);
+    CHECK_EQ(TestArmedInReceive, (n + 1U) < DCDC_RX_SLOTS);
+    CHECK_EQ(ring->Stalled, (n + 1U) == DCDC_RX_SLOTS);
+  }
+
+  /* Ring full: the host is NAKed until a slot comes back */
+  CHECK_EQ(out->Armed, 0U);
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, 1U, 1U), 0U);
+
+  for (n = 0U; n < DCDC_RX_SLOTS; n++)
+  {
+    slot = USBD_DCDC_RxPeek(&TestDev, cdc, &len);
+    CHECK(slot == &TestRxRing[0][n * TEST_SLOT_SIZE]);
+    CHECK_EQ(len, 1U + ((n * 37U) % TEST_SLOT_SIZE));
+    CHECK_EQ(USBD_DCDC_RxRelease(&TestDev, cdc), USBD_OK);
+    CHECK(out->Armed);
+  }
+  CHECK(USBD_DCDC_RxPeek(&TestDev, cdc, &len) == NULL);
+  CHECK_EQ(ring->Stalled, 0U);
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+}
+
+/**
+  * @brief  Message mode: a message of the slot size less one byte fits its
+  *         slot; one of exactly the slot size, ended by a ZLP, and longer
+  *         ones are dropped whole, and the next message is received intact.
+  */
+static void Test_MsgMode(void)
+{
+  USBD_CDC_HandleTypeDef *cdc = Test_Cdc(0U);
+  USBD_DCDC_RxRingTypeDef *ring = &cdc->RxRing;
+  FakeEpTypeDef *out = &Fake.Out[DCDC_OUT_EP(0U) & 0x7U];
+  uint8_t *slot;
+  uint32_t len;
+
+  CHECK_EQ(USBD_DCDC_SetMsgMode(&TestDev, cdc, 1U), USBD_OK);
+
+  /* Largest message: ends with a short packet inside the slot */
+  Test_Fill(TEST_SLOT_SIZE - 1U, 1U);
+  TestReceives = 0U;
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, TEST_SLOT_SIZE - 1U, 1U), TEST_SLOT_SIZE - 1U);
+  CHECK_EQ(TestReceives, 1U);
+  CHECK_EQ(TestRxLen, TEST_SLOT_SIZE - 1U);
+  CHECK(memcmp(TestRxBuf, TestData, TEST_SLOT_SIZE - 1U) == 0);
+  CHECK_EQ(ring->Dropped, 0U);
+  slot = USBD_DCDC_RxPeek(&TestDev, cdc, &len);
+  CHECK(slot == TestRxBuf);
+  CHECK_EQ(len, TEST_SLOT_SIZE - 1U);
+  CHECK_EQ(USBD_DCDC_RxRelease(&TestDev, cdc), USBD_OK);
+
+  /* Exactly the slot size: the slot fills before the ZLP, dropped */
+  Test_Fill(TEST_SLOT_SIZE, 2U);
+  TestReceives = 0U;
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, TEST_SLOT_SIZE, 1U), TEST_SLOT_SIZE);
+  CHECK_EQ(TestReceives, 0U);
+  CHECK_EQ(ring->Dropped, 1U);
+  CHECK_EQ(ring->Discard, 0U);
+  CHECK(USBD_DCDC_RxPeek(&TestDev, cdc, &len) == NULL);
+  CHECK(out->Armed);
+
+  /* Longer, over two slots: dropped once */
+  Test_Fill(sizeof(TestData), 3U);
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, sizeof(TestData), 0U), sizeof(TestData));
+  CHECK_EQ(ring->Discard, 1U);
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, 5U, 1U), 5U);
+  CHECK_EQ(TestReceives, 0U);
+  CHECK_EQ(ring->Dropped, 2U);
+  CHECK_EQ(ring->Discard, 0U);
+
+  /* The next message is not taken for the tail of a dropped one */
+  Test_Fill(TEST_MPS, 4U);
+  CHECK_EQ(Fake_HostOut(&TestDev, DCDC_OUT_EP(0U), TestData, TEST_MPS, 1U), TEST_MPS);
+  CHECK_EQ(TestReceives, 1U);
+  CHECK_EQ(TestRxLen, TEST_MPS);
+  CHECK(memcmp(TestRxBuf, TestData, TEST_MPS) == 0);
+  CHECK_EQ(USBD_DCDC_RxRelease(&TestDev, cdc), USBD_OK);
+  CHECK_EQ(ring->Dropped, 2U);
+
+  CHECK_EQ(USBD_DCDC_SetMsgMode(&TestDev, cdc, 0U), USBD_OK);
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+}
+
+int main(void)
+{
+  Fake_Reset();
+  CHECK_EQ(USBD_Init(&TestDev, &TestDesc, DEVICE_FS), USBD_OK);
+  CHECK_EQ(USBD_RegisterClass(&TestDev, &USBD_DCDC), USBD_OK);
+  CHECK_EQ(USBD_DCDC_RegisterInterface(&TestDev, &TestFops), USBD_OK);
+  CHECK_EQ(USBD_Start(&TestDev), USBD_OK);
+
+  Fake_Enumerate(&TestDev);
+  CHECK_EQ(Fake_Setup(&TestDev, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL), USBD_OK);
+
+  Test_Ring();
+  Test_MsgMode();
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,225 @@
+/**
+  ******************************************************************************
+  * @file    test_tx_queue.c
+  * @brief   Host test of the TX queue transfers in byte mode: how the IN
+  *          scheduler shortens a transfer to the port credit, and whole
+  *          packets across the wrap of the queue.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_test.h"
+#include "fake_usbd_ll.h"
+#include "usbd_dcdc.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_QUEUE_SIZE  1024U
+#define TEST_XFER_SIZE   256U
+#define TEST_MPS         DCDC_DATA_FS_MAX_PACKET_SIZE
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef TestDev;
+static uint8_t TestTxQueue[DCDC_NUM_PIPES][TEST_QUEUE_SIZE];
+static uint8_t TestRx[DCDC_NUM_PIPES][TEST_XFER_SIZE];
+static uint8_t TestData[TEST_QUEUE_SIZE];
+static uint8_t TestHost[TEST_QUEUE_SIZE];
+static uint32_t TestSeed = 1U;
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Test_Rand(void)
+{
+  TestSeed = (TestSeed * 1103515245U) + 12345U;
+  return TestSeed >> 8;
+}
+
+static int8_t Test_Init(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_SetRxBuffer(&TestDev, cdc, TestRx[cdc->Port]);
+  USBD_DCDC_SetRxXferSize(&TestDev, cdc, TEST_XFER_SIZE);
+  USBD_DCDC_SetTxQueue(&TestDev, cdc, TestTxQueue[cdc->Port], TEST_QUEUE_SIZE);
+  return USBD_OK;
+}
+
+static int8_t Test_DeInit(USBD_CDC_HandleTypeDef *cdc)
+{
+  UNUSED(cdc);
+  return USBD_OK;
+}
+
+static int8_t Test_Control(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  UNUSED(cdc);
+  UNUSED(cmd);
+  UNUSED(pbuf);
+  UNUSED(length);
+  return USBD_OK;
+}
+
+static int8_t Test_Receive(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  UNUSED(Buf);
+  UNUSED(Len);
+  USBD_DCDC_ReceivePacket(&TestDev, cdc);
+  return USBD_OK;
+}
+
+static USBD_DCDC_ItfTypeDef TestFops =
+{
+  Test_Init,
+  Test_DeInit,
+  Test_Control,
+  Test_Receive,
+  NULL
+};
+
+static uint8_t TestDeviceDesc[USB_LEN_DEV_DESC] =
+{
+  USB_LEN_DEV_DESC, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0xEF, 0x02, 0x01, 0x40,
+  0x83, 0x04, 0x40, 0x57, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint8_t *Test_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(TestDeviceDesc);
+  return TestDeviceDesc;
+}
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Test_DeviceDescriptor
+};
+
+static USBD_CDC_HandleTypeDef *Test_Cdc(uint8_t port)
+{
+  return &((USBD_DCDC_HandleTypeDef *)TestDev.pClassData)->CDC[port];
+}
+
+/**
+  * @brief  Queues len bytes on port 0, from the start of an empty queue
+  *         with a rate cap of burst tokens, and runs the handed over kick.
+  */
+static void Test_Submit(uint32_t len, uint32_t rate, uint32_t burst)
+{
+  uint32_t i;
+
+  CHECK_EQ(USBD_DCDC_SetTxQueue(&TestDev, Test_Cdc(0U), TestTxQueue[0], TEST_QUEUE_SIZE), USBD_OK);
+  CHECK_EQ(USBD_DCDC_SetTxRate(&TestDev, Test_Cdc(0U), rate, burst), USBD_OK);
+
+  for (i = 0U; i < len; i++)
+  {
+    TestData[i] = (uint8_t)Test_Rand();
+  }
+  CHECK_EQ(USBD_DCDC_TxSubmit(&TestDev, Test_Cdc(0U), TestData, len), USBD_OK);
+  Fake_Irq(&TestDev);
+}
+
+/**
+  * @brief  Rate capped port: a transfer shortened to its tokens is rounded
+  *         up to whole packets, but never past the queued data, and the
+  *         tokens pay for the bytes sent only.
+  */
+static void Test_SchedGrant(void)
+{
+  USBD_CDC_HandleTypeDef *cdc = Test_Cdc(0U);
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  FakeEpTypeDef *in = &Fake.In[DCDC_IN_EP(0U) & 0x7U];
+  const uint32_t len = 700U;
+  int32_t credit;
+
+  /* Credit that rounds up past the queued data: the whole queue, not a
+     byte more */
+  for (credit = (int32_t)(len - (len % TEST_MPS)) + 1; credit < (int32_t)len; credit++)
+  {
+    Test_Submit(len, 1U, (uint32_t)credit);
+
+    CHECK(in->Armed);
+    CHECK_EQ(in->Len, len);
+    CHECK_EQ(q->Tokens, credit - (int32_t)len);
+
+    CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(0U), TestHost, sizeof(TestHost)), len);
+    CHECK(memcmp(TestHost, TestData, len) == 0);
+    CHECK_EQ(q->Tail, q->Head);
+    CHECK_EQ(q->Reserve, q->Head);
+    CHECK_EQ(cdc->TxState, 0U);
+  }
+
+  /* Less credit: whole packets first, the rest once the bucket refills */
+  Test_Submit(len, TEST_MPS, 600U);
+
+  CHECK_EQ(in->Len, 640U);
+  CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(0U), TestHost, sizeof(TestHost)), 640U);
+  CHECK_EQ(q->Head - q->Tail, len - 640U);
+  CHECK_EQ(in->Armed, 0U);
+
+  /* 24 tokens after one frame, less than the 60 bytes left */
+  Fake_Sof(&TestDev);
+  CHECK(in->Armed);
+  CHECK_EQ(in->Len, len - 640U);
+  CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(0U), &TestHost[640], sizeof(TestHost) - 640U), len - 640U);
+  CHECK(memcmp(TestHost, TestData, len) == 0);
+  CHECK_EQ(q->Tail, q->Head);
+  CHECK_EQ(q->Tokens, 24 - (int32_t)(len - 640U));
+
+  CHECK_EQ(USBD_DCDC_SetTxRate(&TestDev, cdc, 0U, 0U), USBD_OK);
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+}
+
+/**
+  * @brief  Data across the wrap of the queue goes out as whole packets, the
+  *         short one last: the host reads it all in one bulk read, which a
+  *         short packet would end. Wrap points less than a packet, and more
+  *         than one but not a whole number of packets, ahead of the tail.
+  */
+static void Test_Wrap(void)
+{
+  USBD_CDC_HandleTypeDef *cdc = Test_Cdc(0U);
+  USBD_DCDC_TxQueueTypeDef *q = &cdc->TxQueue;
+  const uint32_t len = 200U;
+  uint32_t ahead;
+  uint32_t i;
+
+  for (ahead = 1U; ahead < (2U * TEST_MPS) + 8U; ahead++)
+  {
+    /* Park the tail ahead bytes before the wrap */
+    Test_Submit(TEST_QUEUE_SIZE - ahead, 0U, 0U);
+    CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(0U), TestHost, sizeof(TestHost)), TEST_QUEUE_SIZE - ahead);
+    CHECK_EQ(q->Tail, TEST_QUEUE_SIZE - ahead);
+
+    for (i = 0U; i < len; i++)
+    {
+      TestData[i] = (uint8_t)Test_Rand();
+    }
+    CHECK_EQ(USBD_DCDC_TxSubmit(&TestDev, cdc, TestData, len), USBD_OK);
+    Fake_Irq(&TestDev);
+
+    CHECK_EQ(Fake_HostIn(&TestDev, DCDC_IN_EP(0U), TestHost, sizeof(TestHost)), len);
+    CHECK(memcmp(TestHost, TestData, len) == 0);
+    CHECK_EQ(q->Tail, q->Head);
+    CHECK_EQ(cdc->TxState, 0U);
+
+    if (q->Tail != q->Head)
+    {
+      printf("  wrap: %lu bytes ahead\n", (unsigned long)ahead);
+    }
+  }
+
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+}
+
+int main(void)
+{
+  Fake_Reset();
+  CHECK_EQ(USBD_Init(&TestDev, &TestDesc, DEVICE_FS), USBD_OK);
+  CHECK_EQ(USBD_RegisterClass(&TestDev, &USBD_DCDC), USBD_OK);
+  CHECK_EQ(USBD_DCDC_RegisterInterface(&TestDev, &TestFops), USBD_OK);
+  CHECK_EQ(USBD_Start(&TestDev), USBD_OK);
+
+  Fake_Enumerate(&TestDev);
+  CHECK_EQ(Fake_Setup(&TestDev, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL), USBD_OK);
+
+  Test_SchedGrant();
+  Test_Wrap();
+
+  return TEST_RESULT();
+}
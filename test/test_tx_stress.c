@@ -0,0 +1,410 @@
+/**
+  ******************************************************************************
+  * @file    test_tx_stress.c
+  * @brief   Preemption stress test of the lock-free TX queue: TxPut,
+  *          TxPublish and TxHandoff, and the message mode writer guard.
+  *
+  *          Three contexts share the ports: a task, an application
+  *          interrupt and the USB interrupt. At every LDREX, STREX and DMB,
+  *          and where the USB interrupt becomes pending or unmasked, a
+  *          context of higher priority may run to completion first, the way
+  *          an interrupt preempts. Task and application interrupt queue
+  *          numbered records with TxSubmit (message mode: TxWrite); the USB
+  *          interrupt runs the handed over kicks, the SOF and the host
+  *          reading IN packets. Every record must reach the host once, in
+  *          order and intact, and the queues must drain to idle.
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_test.h"
+#include "fake_usbd_ll.h"
+#include "usbd_dcdc.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_QUEUE_SIZE  256U
+#define TEST_SLOT_SIZE   (2U * DCDC_DATA_FS_MAX_PACKET_SIZE)
+#define TEST_STEPS       200000U
+#define TEST_REC_MAX     100U
+#define TEST_REC_HDR     5U
+#define TEST_MAGIC       0xA5U
+
+#define CTX_TASK         0U
+#define CTX_APP_IRQ      1U
+#define CTX_USB_IRQ      2U
+#define CTX_COUNT        3U
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  uint16_t Seq;                                            /* Next record to queue */
+  uint16_t Expect;                                         /* Next record the host should see */
+  uint32_t Refused;                                        /* Writes turned away: queue full or busy */
+} TestWriterTypeDef;
+
+typedef struct
+{
+  uint8_t  Stream[4U * TEST_QUEUE_SIZE];                   /* Byte mode: bytes read, not yet parsed */
+  uint32_t StreamLen;
+  TestWriterTypeDef Writer[2];                             /* Task, application interrupt */
+} TestPortTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HandleTypeDef TestDev;
+static uint8_t TestTxQueue[DCDC_NUM_PIPES][TEST_QUEUE_SIZE];
+static uint8_t TestRxRing[DCDC_NUM_PIPES][DCDC_RX_SLOTS * TEST_SLOT_SIZE];
+static TestPortTypeDef TestPort[DCDC_NUM_PORTS];
+
+static uint8_t  TestMsgMode;
+static uint8_t  TestWriting;                               /* Writers still queue records */
+static uint32_t TestPrio[CTX_COUNT];
+static uint32_t TestLevel;                                 /* Priority of the running context */
+static uint32_t TestPreemptions;
+static uint32_t TestSeed = 1U;
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Test_Rand(void)
+{
+  TestSeed = (TestSeed * 1103515245U) + 12345U;
+  return TestSeed >> 8;
+}
+
+static int8_t Test_Init(USBD_CDC_HandleTypeDef *cdc)
+{
+  USBD_DCDC_SetTxQueue(&TestDev, cdc, TestTxQueue[cdc->Port], TEST_QUEUE_SIZE);
+  USBD_DCDC_SetTxFlush(&TestDev, cdc, 1U);
+  USBD_DCDC_SetRxRing(&TestDev, cdc, TestRxRing[cdc->Port], TEST_SLOT_SIZE);
+  USBD_DCDC_SetMsgMode(&TestDev, cdc, TestMsgMode);
+  return USBD_OK;
+}
+
+static int8_t Test_DeInit(USBD_CDC_HandleTypeDef *cdc)
+{
+  UNUSED(cdc);
+  return USBD_OK;
+}
+
+static int8_t Test_Control(USBD_CDC_HandleTypeDef *cdc, uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  UNUSED(cdc);
+  UNUSED(cmd);
+  UNUSED(pbuf);
+  UNUSED(length);
+  return USBD_OK;
+}
+
+static int8_t Test_Receive(USBD_CDC_HandleTypeDef *cdc, uint8_t *Buf, uint32_t *Len)
+{
+  UNUSED(cdc);
+  UNUSED(Buf);
+  UNUSED(Len);
+  return USBD_OK;
+}
+
+static USBD_DCDC_ItfTypeDef TestFops =
+{
+  Test_Init,
+  Test_DeInit,
+  Test_Control,
+  Test_Receive,
+  NULL
+};
+
+static uint8_t TestDeviceDesc[USB_LEN_DEV_DESC] =
+{
+  USB_LEN_DEV_DESC, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0xEF, 0x02, 0x01, 0x40,
+  0x83, 0x04, 0x40, 0x57, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01
+};
+
+static uint8_t *Test_DeviceDescriptor(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(TestDeviceDesc);
+  return TestDeviceDesc;
+}
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Test_DeviceDescriptor
+};
+
+static USBD_CDC_HandleTypeDef *Test_Cdc(uint8_t port)
+{
+  return &((USBD_DCDC_HandleTypeDef *)TestDev.pClassData)->CDC[port];
+}
+
+/**
+  * @brief  Record of a writer: magic, writer, sequence, payload length, then
+  *         a payload derived from all of those.
+  */
+static uint32_t Test_Record(uint8_t *rec, uint8_t writer, uint16_t seq)
+{
+  uint32_t len = (seq * 37U + writer * 11U) % (TEST_REC_MAX - TEST_REC_HDR + 1U);
+  uint32_t i;
+
+  rec[0] = TEST_MAGIC;
+  rec[1] = writer;
+  rec[2] = (uint8_t)seq;
+  rec[3] = (uint8_t)(seq >> 8);
+  rec[4] = (uint8_t)len;
+  for (i = 0U; i < len; i++)
+  {
+    rec[TEST_REC_HDR + i] = (uint8_t)((seq * 7U) + writer + i);
+  }
+  return TEST_REC_HDR + len;
+}
+
+/**
+  * @brief  Checks one record the host read against what its writer queued.
+  */
+static void Test_Check(uint8_t port, const uint8_t *rec, uint32_t len)
+{
+  uint8_t expect[TEST_REC_MAX];
+  TestWriterTypeDef *w;
+
+  if ((len < TEST_REC_HDR) || (rec[0] != TEST_MAGIC) || (rec[1] > 1U))
+  {
+    CHECK(0);
+    return;
+  }
+  w = &TestPort[port].Writer[rec[1]];
+
+  CHECK_EQ((uint32_t)rec[2] | ((uint32_t)rec[3] << 8), w->Expect);
+  CHECK_EQ(len, Test_Record(expect, rec[1], w->Expect));
+  CHECK(memcmp(rec, expect, len) == 0);
+  w->Expect++;
+}
+
+/**
+  * @brief  Byte mode: splits the bytes read into records.
+  */
+static void Test_Parse(uint8_t port)
+{
+  TestPortTypeDef *p = &TestPort[port];
+  uint32_t len;
+
+  while ((p->StreamLen >= TEST_REC_HDR) &&
+         (p->StreamLen >= (len = TEST_REC_HDR + p->Stream[4])))
+  {
+    Test_Check(port, p->Stream, len);
+    p->StreamLen -= len;
+    memmove(p->Stream, &p->Stream[len], p->StreamLen);
+  }
+}
+
+/**
+  * @brief  A writer queues its next record on a random port, if it fits.
+  */
+static void Test_Writer(uint8_t writer)
+{
+  uint8_t rec[TEST_REC_MAX];
+  uint8_t port = (uint8_t)(Test_Rand() % DCDC_NUM_PORTS);
+  TestWriterTypeDef *w = &TestPort[port].Writer[writer];
+  uint32_t len;
+  uint8_t ok;
+
+  if (TestWriting == 0U)
+  {
+    return;
+  }
+  len = Test_Record(rec, writer, w->Seq);
+
+  if (TestMsgMode != 0U)
+  {
+    ok = (USBD_DCDC_TxWrite(&TestDev, Test_Cdc(port), rec, len) == len);
+  }
+  else
+  {
+    ok = (USBD_DCDC_TxSubmit(&TestDev, Test_Cdc(port), rec, len) == USBD_OK);
+  }
+
+  if (ok != 0U)
+  {
+    w->Seq++;
+  }
+  else
+  {
+    w->Refused++;
+  }
+}
+
+/**
+  * @brief  USB interrupt: kicks handed over, then bus events. The host reads
+  *         a packet (message mode: a transfer) or a frame starts.
+  */
+static void Test_UsbIrq(void)
+{
+  uint8_t buf[TEST_REC_MAX + DCDC_DATA_FS_MAX_PACKET_SIZE];
+  TestPortTypeDef *p;
+  uint32_t got;
+  uint8_t port;
+
+  Fake.IrqPending = 0U;
+  USBD_DCDC_TxService(&TestDev);
+
+  port = (uint8_t)(Test_Rand() % (DCDC_NUM_PORTS + 1U));
+  if (port == DCDC_NUM_PORTS)
+  {
+    Fake_Sof(&TestDev);
+    return;
+  }
+
+  p = &TestPort[port];
+  if (TestMsgMode != 0U)
+  {
+    got = Fake_HostIn(&TestDev, DCDC_IN_EP(port), buf, sizeof(buf));
+    if (got != 0U)
+    {
+      Test_Check(port, buf, got);
+    }
+  }
+  else
+  {
+    got = Fake_HostIn(&TestDev, DCDC_IN_EP(port), &p->Stream[p->StreamLen],
+                      DCDC_DATA_FS_MAX_PACKET_SIZE);
+    p->StreamLen += got;
+    Test_Parse(port);
+  }
+}
+
+/**
+  * @brief  Runs context ctx as if its interrupt was taken now.
+  */
+static void Test_Run(uint32_t ctx)
+{
+  uint32_t level = TestLevel;
+
+  TestLevel = TestPrio[ctx];
+  if (ctx == CTX_USB_IRQ)
+  {
+    Test_UsbIrq();
+  }
+  else
+  {
+    Test_Writer((uint8_t)(ctx - CTX_TASK));
+  }
+  TestLevel = level;
+}
+
+/**
+  * @brief  Preemption point: a pending USB interrupt is taken if its
+  *         priority allows, otherwise now and then an interrupt comes in.
+  */
+static uint8_t Test_Preempt(void)
+{
+  uint32_t ctx;
+
+  if ((Fake.IrqPending != 0U) && (Fake.IrqMask == 0U) && (TestPrio[CTX_USB_IRQ] > TestLevel))
+  {
+    ctx = CTX_USB_IRQ;
+  }
+  else
+  {
+    if ((Test_Rand() % 4U) != 0U)
+    {
+      return 0U;
+    }
+    ctx = CTX_APP_IRQ + (Test_Rand() % 2U);
+
+    if ((TestPrio[ctx] <= TestLevel) || ((ctx == CTX_USB_IRQ) && (Fake.IrqMask != 0U)))
+    {
+      return 0U;
+    }
+  }
+
+  TestPreemptions++;
+  Test_Run(ctx);
+  return 1U;
+}
+
+/**
+  * @brief  One run: SET_CONFIGURATION, TEST_STEPS of concurrent writing,
+  *         then drain and check.
+  */
+static void Test_Stress(uint8_t msg_mode, uint8_t usb_above_app, uint32_t seed)
+{
+  USBD_DCDC_TxQueueTypeDef *q;
+  uint32_t step;
+  uint8_t port;
+  uint8_t writer;
+
+  printf("message mode %u, USB interrupt %s the application one\n",
+         (unsigned)msg_mode, (usb_above_app != 0U) ? "above" : "below");
+
+  TestSeed = seed;
+  TestMsgMode = msg_mode;
+  TestPrio[CTX_TASK] = 0U;
+  TestPrio[CTX_APP_IRQ] = (usb_above_app != 0U) ? 1U : 2U;
+  TestPrio[CTX_USB_IRQ] = (usb_above_app != 0U) ? 2U : 1U;
+  TestLevel = TestPrio[CTX_TASK];
+  TestPreemptions = 0U;
+  memset(TestPort, 0, sizeof(TestPort));
+
+  Fake_Reset();
+  CHECK_EQ(USBD_Init(&TestDev, &TestDesc, DEVICE_FS), USBD_OK);
+  CHECK_EQ(USBD_RegisterClass(&TestDev, &USBD_DCDC), USBD_OK);
+  CHECK_EQ(USBD_DCDC_RegisterInterface(&TestDev, &TestFops), USBD_OK);
+  CHECK_EQ(USBD_Start(&TestDev), USBD_OK);
+  Fake_Enumerate(&TestDev);
+  CHECK_EQ(Fake_Setup(&TestDev, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL), USBD_OK);
+  CHECK_EQ(Test_Cdc(0U)->MsgMode, msg_mode);
+
+  Host_PreemptHook = Test_Preempt;
+  TestWriting = 1U;
+
+  for (step = 0U; step < TEST_STEPS; step++)
+  {
+    /* The task writes; between its instructions interrupts come in */
+    if ((Test_Rand() % 3U) == 0U)
+    {
+      Test_Writer(0U);
+    }
+    else
+    {
+      (void)Test_Preempt();
+    }
+  }
+
+  /* Writers stop; the host reads until every queue is idle */
+  TestWriting = 0U;
+  for (step = 0U; step < 100000U; step++)
+  {
+    Test_Run(CTX_USB_IRQ);
+  }
+  Host_PreemptHook = NULL;
+
+  for (port = 0U; port < DCDC_NUM_PORTS; port++)
+  {
+    q = &Test_Cdc(port)->TxQueue;
+
+    CHECK_EQ(q->Head, q->Tail);
+    CHECK_EQ(q->Reserve, q->Head);
+    CHECK_EQ(q->Writers, 0U);
+    CHECK_EQ(q->InFlight, 0U);
+    CHECK_EQ(Test_Cdc(port)->TxState, 0U);
+    CHECK_EQ(TestPort[port].StreamLen, 0U);
+
+    for (writer = 0U; writer < 2U; writer++)
+    {
+      TestWriterTypeDef *w = &TestPort[port].Writer[writer];
+
+      CHECK(w->Seq > 100U);
+      CHECK_EQ(w->Expect, w->Seq);
+      printf("  port %u writer %u: %u records, %lu refused\n", (unsigned)port, (unsigned)writer,
+             (unsigned)w->Seq, (unsigned long)w->Refused);
+    }
+  }
+  CHECK_EQ(((USBD_DCDC_HandleTypeDef *)TestDev.pClassData)->TxKick, 0U);
+  CHECK_EQ(Fake.DoubleSubmits, 0U);
+  CHECK(TestPreemptions > (TEST_STEPS / 4U));
+}
+
+int main(void)
+{
+  Test_Stress(0U, 1U, 1U);
+  Test_Stress(0U, 0U, 2U);
+  Test_Stress(1U, 1U, 3U);
+  Test_Stress(1U, 0U, 4U);
+
+  return TEST_RESULT();
+}